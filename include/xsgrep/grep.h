@@ -6,6 +6,10 @@
 #include <xsearch/xsearch.h>
 
 #include <filesystem>
+#include <functional>
+#include <string_view>
+
+#include "./utils/ErrorLog.h"
 
 // ===== Helper functions ======================================================
 std::vector<std::string> get_files(const std::filesystem::path& in_path,
@@ -15,6 +19,9 @@ std::vector<std::string> get_files(const std::filesystem::path& in_path,
 
 class GrepSearcher;
 class GrepOutput;
+class Cancellation;
+class FileCache;
+class SearcherCache;
 
 class Grep {
   typedef std::unique_ptr<xs::task::base::DataProvider<xs::DataChunk>>
@@ -29,10 +36,139 @@ class Grep {
     std::string match;
   };
 
+  /**
+   * MatchView: Borrowed form of a Match passed to visitors (see visit()). The
+   *  views are only valid during the call of the visitor.
+   */
+  struct MatchView {
+    std::string_view file_name;
+    int64_t byte_position{-1};
+    int64_t line_number{-1};
+    std::string_view match;
+  };
+
+  /**
+   * Called with the matches of one chunk (chunks without matches are not
+   *  visited). Returning false stops the search.
+   */
+  typedef std::function<bool(const std::vector<MatchView>& matches)> visitor;
+
+  /**
+   * MatchRef: Non-owning form of a Match. The matched line (or the match
+   *  itself if only_matching is set) is located by offset and size within the
+   *  buffer of the PartialResult the MatchRef belongs to.
+   */
+  struct MatchRef {
+    int64_t byte_position{-1};
+    int64_t line_number{-1};
+    size_t offset{0};
+    size_t size{0};
+    /// range [highlight_begin, highlight_end) within PartialResult::highlights
+    size_t highlight_begin{0};
+    size_t highlight_end{0};
+    /// 0 for selected lines, a combination of ContextFlags for lines that are
+    ///  only part of the context of selected lines (-A/-B/-C)
+    uint8_t context{0};
+  };
+
+  /**
+   * ContextFlags: Why a line that is not selected is part of a PartialResult.
+   *  Context lines of a selected line may be located in the neighbouring
+   *  chunks: the first and last lines of every chunk are passed along so that
+   *  the ordered output can complete the context without reading them again.
+   */
+  enum ContextFlags : uint8_t {
+    /// context of a selected line of the same chunk (always written)
+    CONTEXT_LINE = 1,
+    /// one of the first after_context lines of the chunk
+    HEAD_LINE = 2,
+    /// one of the last before_context lines of the chunk
+    TAIL_LINE = 4
+  };
+
+  /**
+   * Span: Location of a single pattern occurrence within a matching line,
+   *  relative to the start of that line.
+   */
+  struct Span {
+    size_t offset{0};
+    size_t size{0};
+  };
+
+  /**
+   * FileSegment: The matches of a PartialResult that belong to one file, if
+   *  the DataChunk contained the data of several (small) files or only a part
+   *  of a (large) file.
+   */
+  struct FileSegment {
+    std::string file_name;
+    /// matches [matches_end of the previous segment, matches_end) belong to
+    ///  the file
+    size_t matches_end{0};
+    /// number of new lines of the file contained in the chunk
+    uint64_t num_lines{0};
+  };
+
+  /**
+   * PartialResult: All matches found within a single DataChunk.
+   *  The bytes of all matches are stored back to back in one buffer, so a
+   *  chunk costs one allocation regardless of its number of matches. Owning
+   *  Match objects are only created on demand (e.g. by Grep::search()).
+   *  If requested, the searcher also stores the location of every pattern
+   *  occurrence within the matching lines in highlights (used for coloring).
+   *  If segments is empty, all matches belong to file_name. Otherwise, the
+   *  line numbers are relative to the first line of the segment within the
+   *  chunk and must be shifted by the num_lines of all preceding segments of
+   *  the same file (in chunk order, see LineNumberResolver).
+   */
+  struct PartialResult {
+    std::string file_name;
+    std::string buffer;
+    std::vector<MatchRef> matches;
+    std::vector<Span> highlights;
+    std::vector<FileSegment> segments;
+    bool relative_line_numbers{false};
+    /// number of context lines of the first (last) selected line that are
+    ///  located in the previous (next) chunk
+    size_t before_missing{0};
+    size_t after_missing{0};
+
+    [[nodiscard]] std::string_view str(const MatchRef& match) const;
+    [[nodiscard]] Match to_match(const MatchRef& match) const;
+
+    /**
+     * Call f(file_name, begin, end) for the matches [begin, end) of every
+     *  file of the result (not called for empty results without segments,
+     *  e.g. results of skipped chunks).
+     */
+    template <typename F>
+    void for_each_file(F f) const {
+      if (segments.empty()) {
+        if (!matches.empty()) {
+          f(file_name, size_t{0}, matches.size());
+        }
+        return;
+      }
+      size_t begin = 0;
+      for (const auto& segment : segments) {
+        f(segment.file_name, begin, segment.matches_end);
+        begin = segment.matches_end;
+      }
+    }
+  };
+
   enum class Color { AUTO, ON, OFF };
 
   enum class Locale { AUTO, ASCII, UTF_8 };
 
+  /// how files are read: AUTO maps files that are in the page cache and reads
+  ///  the others (decided per file)
+  enum class IO { AUTO, MMAP, READ };
+
+  /// occurrences of the patterns that are matches: any, whole words only (no
+  ///  letter, digit or '_' next to them) or whole lines only
+  enum class Boundary { NONE, WORD, LINE };
+
   /**
    * Options: A struct holding information about what xsgrep searches and how
    * results will be printed.
@@ -46,13 +182,51 @@ class Grep {
    *  offset is the position of the line containing the match
    * @param color: use colored output, default is AUTO?
    * @param only_matching: only print matches and search for match offsets
+   * @param invert_match: select the lines that do not match (nothing is
+   *  written for them if only_matching is set, they contain no match)
+   * @param word_regexp: only whole words match (see Boundary::WORD)
+   * @param line_regexp: only whole lines match, takes precedence over
+   *  word_regexp
    * @param ignore_case: run case insensitive search
    * @param locale: use the provided encoding
    * @param print_file_path: print the file path before the matching content
    *  (only if the results are written to an ostream)
    * @param pattern: the pattern that is searched
+   * @param patterns: search for several patterns at once (-e/-f), a line is
+   *  selected if any of them matches. Patterns containing new lines are split
+   *  into one pattern per line. pattern is ignored if patterns is not empty
+   * @param use_patterns: search patterns even if it is empty (e.g. an empty
+   *  pattern file): no pattern is searched, so no line matches (and every
+   *  line is selected if invert_match is set)
    * @param file: the file that is searched
-   * @param use_mmap: reader uses memory mapping if possible
+   * @param io: memory map files, read them or decide per file by whether they
+   *  are in the page cache (AUTO)
+   * @param meta_file_suffix: in recursive mode, a file is read using the
+   *  metafile <file path><meta_file_suffix> if it exists (disabled if empty)
+   * @param max_count: stop searching a file after max_count matching lines
+   *  (-1: unlimited)
+   * @param quiet: write nothing, stop searching at the first match
+   * @param files_with_matches: only write the names of files with matches
+   * @param files_without_match: only write the names of files without
+   *  matches
+   * @param before_context: print before_context lines of leading context
+   *  (-1: no context). Groups of lines that are not adjacent are separated by
+   *  "--" if any context is set, even if it is 0
+   * @param after_context: print after_context lines of trailing context
+   *  (-1: no context)
+   * @param max_memory: maximum number of bytes of results that wait to be
+   *  written in order (0: unlimited). Searching threads block (and thus stop
+   *  reading) once it is reached, so the memory used does not grow with the
+   *  size of the input if a chunk is slow to search or the output is slow
+   * @param line_buffered: flush the output whenever the lines of a chunk were
+   *  written instead of once the output buffer is full (for streamed input,
+   *  where chunks are read as soon as data arrive)
+   * @param io_uring_depth: read single files with io_uring, keeping up to
+   *  io_uring_depth chunk reads in flight (0: blocking reads). Falls back to
+   *  the default readers if io_uring is not available
+   * @param display_root: file names are written relative to this directory
+   *  (see GrepOutput::relative_name()), e.g. the working directory of a
+   *  client that file was resolved against (empty: names are written as is)
    */
   struct Options {
     bool count = false;
@@ -61,15 +235,31 @@ class Grep {
     bool byte_offset = false;
     Color color = Color::AUTO;
     bool only_matching = false;
+    bool invert_match = false;
+    bool word_regexp = false;
+    bool line_regexp = false;
     bool ignore_case = true;
     Locale locale = Locale::ASCII;
     bool print_file_path = false;
     std::string pattern;
+    std::vector<std::string> patterns;
+    bool use_patterns = false;
     std::string file;
     std::string meta_file_path;
-    bool no_mmap = true;
+    IO io = IO::AUTO;
     int num_threads = 0;
     int num_reader_threads = 1;
+    std::string meta_file_suffix = ".meta";
+    int64_t max_count = -1;
+    bool quiet = false;
+    bool files_with_matches = false;
+    bool files_without_match = false;
+    int64_t before_context = -1;
+    int64_t after_context = -1;
+    size_t max_memory = 256 << 20;
+    bool line_buffered = false;
+    int io_uring_depth = 0;
+    std::string display_root;
   };
 
   // Constructors
@@ -78,50 +268,140 @@ class Grep {
   explicit Grep(Options options);
 
   std::vector<std::pair<std::string, uint64_t>> count();
+  /// all matches by file (collected by visit())
   std::map<std::string, std::vector<Grep::Match>> search();
-  void write(std::ostream* stream = &std::cout);
+  /**
+   * Pass the matches to f chunk by chunk, in the order of the input and as
+   *  soon as all previous chunks were visited. Nothing is collected: the
+   *  chunks waiting for their turn are limited by max_memory, so the memory
+   *  used does not grow with the number of matches. max_count is applied per
+   *  file. f is called by one thread at a time.
+   * @return number of matches passed to f
+   * @throws exceptions thrown by f (the search is stopped)
+   */
+  size_t visit(const visitor& f);
+  /**
+   * Write the results to stream.
+   * @return true if anything was selected (a line matched or, if
+   *  files_without_match is set, a file was listed)
+   */
+  bool write(std::ostream* stream = &std::cout);
 
   Grep& set_file(std::string file);
   Grep& set_meta_file(std::string meta_file);
   Grep& set_pattern(std::string pattern);
+  Grep& set_patterns(std::vector<std::string> patterns);
   Grep& set_count_only(bool val);
   Grep& set_fixed_string(bool val);
   Grep& set_line_number(bool val);
   Grep& set_byte_offset(bool val);
   Grep& set_colored_output(Color color);
   Grep& set_only_matching(bool val);
+  Grep& set_invert_match(bool val);
+  Grep& set_word_regexp(bool val);
+  Grep& set_line_regexp(bool val);
   Grep& set_ignore_case(bool val);
   Grep& set_locale(Locale locale);
   Grep& set_print_file_path(bool val);
   Grep& set_use_mmap(bool val);
+  Grep& set_io(IO io);
   Grep& set_num_threads(int val);
   Grep& set_num_reader_threads(int val);
+  Grep& set_meta_file_suffix(std::string suffix);
+  Grep& set_max_count(int64_t val);
+  Grep& set_quiet(bool val);
+  Grep& set_files_with_matches(bool val);
+  Grep& set_files_without_match(bool val);
+  Grep& set_before_context(int64_t val);
+  Grep& set_after_context(int64_t val);
+  Grep& set_max_memory(size_t val);
+  Grep& set_line_buffered(bool val);
+  Grep& set_io_uring_depth(int val);
+  Grep& set_display_root(std::string root);
+  /**
+   * Keep state across the searches of a resident process (see xs --serve):
+   *  files are read through file_cache (which keeps them mapped together
+   *  with their parsed metafiles), searchers are taken from searcher_cache
+   *  (which keeps their compiled patterns). Either may be nullptr.
+   */
+  Grep& set_caches(std::shared_ptr<FileCache> file_cache,
+                   std::shared_ptr<SearcherCache> searcher_cache);
+  /// files and directories that cannot be read are reported to stream
+  ///  (std::cerr by default), e.g. the client of a resident process
+  Grep& set_error_stream(std::ostream* stream);
 
   [[nodiscard]] const std::string& file() const;
   [[nodiscard]] const std::string& meta_file() const;
   [[nodiscard]] const std::string& pattern() const;
+  [[nodiscard]] const std::vector<std::string>& patterns() const;
   [[nodiscard]] bool count_only() const;
   [[nodiscard]] bool fixed_string() const;
   [[nodiscard]] bool line_number() const;
   [[nodiscard]] bool byte_offset() const;
   [[nodiscard]] Color colored_output() const;
   [[nodiscard]] bool only_matching() const;
+  [[nodiscard]] bool invert_match() const;
+  [[nodiscard]] bool word_regexp() const;
+  [[nodiscard]] bool line_regexp() const;
   [[nodiscard]] bool ignore_case() const;
   [[nodiscard]] Locale locale() const;
   [[nodiscard]] bool print_file_path() const;
   [[nodiscard]] bool use_mmap() const;
+  [[nodiscard]] IO io() const;
   [[nodiscard]] int num_threads() const;
   [[nodiscard]] int num_reader_threads() const;
+  [[nodiscard]] const std::string& meta_file_suffix() const;
+  [[nodiscard]] int64_t max_count() const;
+  [[nodiscard]] bool quiet() const;
+  [[nodiscard]] bool files_with_matches() const;
+  [[nodiscard]] bool files_without_match() const;
+  [[nodiscard]] int64_t before_context() const;
+  [[nodiscard]] int64_t after_context() const;
+  [[nodiscard]] size_t max_memory() const;
+  [[nodiscard]] bool line_buffered() const;
+  [[nodiscard]] int io_uring_depth() const;
+  [[nodiscard]] const std::string& display_root() const;
+  /// number of files that could not be read by the searches of this Grep
+  ///  (and its copies), the errors are reported (see set_error_stream())
+  [[nodiscard]] size_t errors() const;
 
  private:
-  [[nodiscard]] std::vector<base_processors> get_processors() const;
+  /// processors are skipped once cancellation is signaled (if not nullptr)
+  [[nodiscard]] std::vector<base_processors> get_processors(
+      const base_reader& reader,
+      const std::shared_ptr<Cancellation>& cancellation = nullptr) const;
+
+  /// the reader stops once cancellation is signaled (if not nullptr)
+  [[nodiscard]] base_reader get_reader(
+      const std::string& file,
+      const std::shared_ptr<Cancellation>& cancellation = nullptr);
 
-  [[nodiscard]] base_reader get_reader(const std::string& file);
+  /// the output is limited (max_count, quiet or list files only)
+  [[nodiscard]] bool limited() const;
+
+  [[nodiscard]] std::unique_ptr<GrepSearcher> get_searcher(
+      const base_reader& reader) const;
+
+  /// the patterns that are searched (see Options::patterns)
+  [[nodiscard]] std::vector<std::string> search_patterns() const;
 
   [[nodiscard]] bool use_regex() const;
 
+  /// the boundary of matches set by word_regexp and line_regexp
+  [[nodiscard]] Boundary boundary() const;
+
+  /**
+   * Literals of which every selected line contains at least one (ASCII case
+   *  folded), used to skip chunks by their n-gram filters. Empty if chunks
+   *  must not be skipped.
+   */
+  [[nodiscard]] std::vector<std::string> ngram_literals() const;
+
   /// number of physical cores available assuming CPU is hyper threaded.
   static const int _max_phys_cores;
 
   Options _options{};
+  std::shared_ptr<FileCache> _file_cache;
+  std::shared_ptr<SearcherCache> _searcher_cache;
+  std::shared_ptr<ErrorLog> _errors = std::make_shared<ErrorLog>();
 };
\ No newline at end of file
@@ -0,0 +1,49 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#pragma once
+
+#include <xsearch/xsearch.h>
+
+#include <memory>
+
+#include "../utils/Cancellation.h"
+
+/**
+ * CancellableReader: Wraps a reader that does not know about cancellation
+ *  (the x-search readers): no more chunks are read once the search was
+ *  cancelled.
+ */
+class CancellableReader : public xs::task::base::DataProvider<xs::DataChunk> {
+ public:
+  CancellableReader(
+      std::unique_ptr<xs::task::base::DataProvider<xs::DataChunk>> reader,
+      std::shared_ptr<Cancellation> cancellation);
+
+  std::optional<std::pair<xs::DataChunk, xs::chunk_index>> getNextData()
+      override;
+
+ private:
+  std::unique_ptr<xs::task::base::DataProvider<xs::DataChunk>> _reader;
+  std::shared_ptr<Cancellation> _cancellation;
+};
+
+/**
+ * CancellableProcessor: Wraps an inplace processor (e.g. a decompressor) that
+ *  is skipped once the search was cancelled. The searcher does not search
+ *  chunks of cancelled searches, so skipped chunks are never looked at.
+ */
+class CancellableProcessor
+    : public xs::task::base::InplaceProcessor<xs::DataChunk> {
+ public:
+  CancellableProcessor(
+      std::unique_ptr<xs::task::base::InplaceProcessor<xs::DataChunk>>
+          processor,
+      std::shared_ptr<Cancellation> cancellation);
+
+  void process(xs::DataChunk* data) const override;
+
+ private:
+  std::unique_ptr<xs::task::base::InplaceProcessor<xs::DataChunk>> _processor;
+  std::shared_ptr<Cancellation> _cancellation;
+};
\ No newline at end of file
@@ -0,0 +1,28 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#pragma once
+
+#include <xsearch/xsearch.h>
+
+#include <memory>
+
+#include "./GrepReader.h"
+
+/**
+ * GrepDecompressor: Decompresses the chunks of preprocessed files read by the
+ *  GrepReader. Since the files of a directory may be compressed differently,
+ *  the compression type is looked up per chunk in the ChunkFileTable.
+ */
+class GrepDecompressor
+    : public xs::task::base::InplaceProcessor<xs::DataChunk> {
+ public:
+  explicit GrepDecompressor(std::shared_ptr<ChunkFileTable> chunk_files);
+
+  void process(xs::DataChunk* data) const override;
+
+ private:
+  std::shared_ptr<ChunkFileTable> _chunk_files;
+  xs::task::processor::LZ4Decompressor _lz4;
+  xs::task::processor::ZSTDDecompressor _zstd;
+};
\ No newline at end of file
@@ -3,27 +3,272 @@
 
 #pragma once
 
-#include <xsearch/tasks/base/DataProvider.h>
-#include <xsearch/tasks/defaults/readers.h>
-#include <xsearch/DataChunk.h>
+#include <xsearch/xsearch.h>
 
-#include <queue>
-#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../utils/Cancellation.h"
+#include "../utils/DirectoryWalker.h"
+#include "../utils/ErrorLog.h"
+#include "../utils/NgramFilter.h"
 
 using namespace xs;
 
+class FileCache;
+
+/**
+ * ChunkFile: The data of a file (or a part of it) contained in a DataChunk
+ *  read by the GrepReader.
+ */
+struct ChunkFile {
+  std::string file_name;
+  /// offset of the first byte of the file data within the chunk
+  size_t chunk_offset{0};
+  /// offset of the first byte of the file data within the file
+  uint64_t file_offset{0};
+  /// number of bytes of the file contained in the chunk
+  size_t size{0};
+  /// chunk of a preprocessed file: line numbers are provided by the line
+  ///  mapping data of the chunk
+  bool line_mapping{false};
+  /// compression of the chunk (chunks of preprocessed files only)
+  CompressionType compression_type{CompressionType::NONE};
+};
+
+/**
+ * ChunkFileTable: Boundary table of the chunks read by the GrepReader.
+ *  The reader inserts the files of each chunk (identified by its chunk index),
+ *  the searcher extracts them when the chunk is searched. Thread safe.
+ */
+class ChunkFileTable {
+ public:
+  void insert(uint64_t chunk_index, std::vector<ChunkFile> files);
+  std::optional<std::vector<ChunkFile>> extract(uint64_t chunk_index);
+  /// compression type of the chunk (NONE if the chunk is unknown)
+  CompressionType compression_type(uint64_t chunk_index);
+
+ private:
+  std::mutex _mutex;
+  std::unordered_map<uint64_t, std::vector<ChunkFile>> _files;
+};
 
+/**
+ * GrepReader: Reads all files of a directory tree.
+ *  Small files are packed into one chunk (each file followed by a new line
+ *  separator that belongs to no file), large files are split at new lines
+ *  into chunks of about stripe_size bytes. Which bytes of a chunk belong to
+ *  which file is stored in the ChunkFileTable.
+ *  Files with a metafile (path of the file + meta_file_suffix, as written by
+ *  xspp) are read chunk by chunk as described by the metafile, the chunks are
+ *  decompressed by the GrepDecompressor. The metafiles themselves are not
+ *  searched. If the metafile comes with n-gram filters (<metafile>.ngrams,
+ *  see NgramFilter) and literals required by the search are set, chunks that
+ *  cannot contain any of them are neither read nor decompressed: they are
+ *  returned as empty chunks of their file.
+ *  Large files are memory mapped or read depending on set_use_mmap() or, if
+ *  set_auto_mmap() is set, on whether they are in the page cache. Files that
+ *  are read get read ahead hints: the next stripe is requested while the
+ *  current one is read.
+ *  The assignment of files to chunks is done under a lock, the actual reading
+ *  is done concurrently by up to max_readers threads. Files stay open until
+ *  their chunk is read: a pack holds at most max_pack_files files, so that
+ *  about max_readers * max_pack_files files are open at once.
+ *  Files and directories that cannot be opened are reported to and counted by
+ *  an ErrorLog.
+ *  If a FileCache is set, large and preprocessed files are taken from it
+ *  instead of being opened (and their metafiles parsed) again.
+ */
 class GrepReader : public task::base::DataProvider<DataChunk> {
  public:
-  explicit GrepReader(std::string path, int recursive_depth = -1);
+  /// maximum number of files packed into one chunk
+  static constexpr size_t max_pack_files = 64;
+  static constexpr size_t default_pack_size = 1 << 20;
+  static constexpr size_t default_stripe_size = 16 << 20;
+
+  /**
+   * @param path: root directory
+   * @param recursive_depth: maximum recursion depth (-1: unlimited)
+   * @param max_readers: maximum number of concurrently reading threads
+   * @param pack_size: maximum size of a chunk of packed files. Files of at
+   *  least this size are split
+   * @param stripe_size: size of the chunks of split files
+   * @param errors: files and directories that cannot be opened are reported
+   *  to errors (std::cerr if nullptr)
+   */
+  explicit GrepReader(std::string path, int recursive_depth = -1,
+                      int max_readers = 1,
+                      size_t pack_size = default_pack_size,
+                      size_t stripe_size = default_stripe_size,
+                      std::shared_ptr<ErrorLog> errors = nullptr);
 
   std::optional<std::pair<DataChunk, chunk_index>> getNextData() override;
 
+  /// boundary table of the chunks returned by getNextData()
+  [[nodiscard]] std::shared_ptr<ChunkFileTable> chunk_files() const;
+
+  /// memory map large files (and preprocessed files) instead of reading them
+  GrepReader& set_use_mmap(bool val);
+  /// decide per file whether it is memory mapped (see prefer_mmap()),
+  ///  overrides set_use_mmap()
+  GrepReader& set_auto_mmap(bool val);
+  /// suffix of metafiles (no metafiles are used if empty)
+  GrepReader& set_meta_file_suffix(std::string suffix);
+  /// metafile of path if path is a single file (overrides the suffix)
+  GrepReader& set_meta_file(std::string meta_file);
+  /**
+   * Every line selected by the search contains one of literals (ASCII case
+   *  is ignored). Used to skip chunks by their n-gram filters, no chunks are
+   *  skipped if literals is empty.
+   */
+  GrepReader& set_ngram_literals(std::vector<std::string> literals);
+  /// stop reading once the search is cancelled, skip the remaining chunks of
+  ///  cancelled files
+  GrepReader& set_cancellation(std::shared_ptr<Cancellation> cancellation);
+  /// take large and preprocessed files from cache (kept across searches)
+  GrepReader& set_file_cache(std::shared_ptr<FileCache> cache);
+
  private:
-  bool getNextFiles();
-  std::queue<std::pair<std::filesystem::path, int>> _directory_queue;
-  std::queue<std::filesystem::path> _file_queue;
-  std::unique_ptr<task::reader::FileReader<DataChunk>> _reader;
-  int _recursive_depth;
+  friend class FileCache;
+
+  struct OpenFile {
+    OpenFile(std::string path, int fd, uint64_t size);
+    ~OpenFile();
+    OpenFile(const OpenFile&) = delete;
+    OpenFile& operator=(const OpenFile&) = delete;
+
+    /**
+     * Open path and parse its metafile meta_path (if not empty and the
+     *  metafile exists) and, if read_filters is set, its n-gram filters.
+     * @return nullptr if path cannot be opened (errno tells why)
+     */
+    static std::shared_ptr<OpenFile> open(std::string path,
+                                          const std::string& meta_path,
+                                          bool read_filters);
+
+    /// memory map the file (the file is read if mapping fails)
+    void map();
+    /// read up to size bytes at offset, return number of bytes read
+    size_t read(char* buffer, size_t size, uint64_t offset) const;
+    /// offset of the first line starting at or after offset
+    uint64_t line_start(uint64_t offset) const;
+
+    std::string path;
+    int fd;
+    uint64_t size;
+    const char* mapping{nullptr};
+    /// the file has a metafile: it is read chunk by chunk as described by
+    ///  meta_chunks
+    bool preprocessed{false};
+    std::vector<ChunkMetaData> meta_chunks;
+    CompressionType compression_type{CompressionType::NONE};
+    /// n-gram filters of the chunks by their original offset
+    std::unordered_map<uint64_t, NgramFilter> ngram_filters;
+    /// the file is shared by the searches using a FileCache: it is mapped
+    ///  once by the cache and not modified by the readers
+    bool cached{false};
+  };
+
+  /// a pack of small files, the stripe with index stripe of one large file or
+  ///  a chunk of a preprocessed file
+  struct WorkItem {
+    std::vector<std::shared_ptr<OpenFile>> files;
+    uint64_t stripe{0};
+    bool split{false};
+    std::optional<ChunkMetaData> chunk_meta_data;
+    /// the chunk of the preprocessed file cannot match: it is not read
+    bool skip{false};
+  };
+
+  /// assign the next files to a chunk index (holds _mutex)
+  std::optional<std::pair<WorkItem, chunk_index>> next_work_item();
+  /// open the next file provided by the walker (nullptr if no files are left)
+  std::shared_ptr<OpenFile> next_file();
+  /// file is the metafile (or n-gram filter file) of another file
+  [[nodiscard]] bool is_meta_file(const DirectoryWalker::File& file) const;
+
+  DataChunk read_pack(const WorkItem& item, chunk_index id);
+  DataChunk read_stripe(const WorkItem& item, chunk_index id);
+  DataChunk read_meta_chunk(WorkItem* item, chunk_index id);
+
+  /// shared with the walker (constructed first)
+  std::shared_ptr<ErrorLog> _errors;
+  /// files are searched while the directory tree is still traversed
+  DirectoryWalker _walker;
+  size_t _pack_size;
+  size_t _stripe_size;
+  bool _use_mmap{false};
+  bool _auto_mmap{false};
+  std::string _meta_file_suffix;
+  std::string _meta_file;
+  std::vector<std::string> _ngram_literals;
+  std::shared_ptr<ChunkFileTable> _chunk_files;
+  std::shared_ptr<Cancellation> _cancellation;
+  std::shared_ptr<FileCache> _file_cache;
+
+  std::mutex _mutex;
   uint64_t _chunk_index{0};
+  /// small file that did not fit into the previous pack
+  std::shared_ptr<OpenFile> _pending_file;
+  /// large file that is currently split into stripes (or preprocessed file
+  ///  that is read chunk by chunk: the stripes are its chunks)
+  std::shared_ptr<OpenFile> _split_file;
+  uint64_t _next_stripe{0};
+  uint64_t _num_stripes{0};
+};
+
+/**
+ * FileCache: Files kept open across the searches of a resident process (see
+ *  xs --serve). Cached files are memory mapped once, their metafiles are
+ *  parsed and their n-gram filters read once. A file is opened again once it,
+ *  its metafile or its filters changed (compared by inode, size and
+ *  modification time), e.g. by xspp --append.
+ *  Only files of at least min_size bytes and preprocessed files are cached,
+ *  at most max_files of them: the least recently used are dropped (searches
+ *  still reading them keep them open). Thread safe.
+ */
+class FileCache {
+ public:
+  explicit FileCache(size_t max_files = 256, size_t min_size = 1 << 20);
+
+  /// number of cached files
+  [[nodiscard]] size_t size() const;
+
+ private:
+  friend class GrepReader;
+
+  /// identity of a file for detecting changes (all 0 if it does not exist)
+  struct FileId {
+    uint64_t device{0};
+    uint64_t inode{0};
+    uint64_t size{0};
+    int64_t mtime{0};
+
+    bool operator==(const FileId&) const = default;
+  };
+
+  static FileId file_id(const std::string& path);
+
+  struct Entry {
+    std::shared_ptr<GrepReader::OpenFile> file;
+    /// ids of the file, its metafile and its n-gram filters
+    std::vector<FileId> ids;
+    std::list<std::string>::iterator lru;
+  };
+
+  /// the cached (or newly opened) file path with metafile meta_path
+  std::shared_ptr<GrepReader::OpenFile> get(const std::string& path,
+                                            const std::string& meta_path);
+
+  size_t _max_files;
+  size_t _min_size;
+  mutable std::mutex _mutex;
+  std::unordered_map<std::string, Entry> _entries;
+  /// keys of _entries, most recently used first
+  std::list<std::string> _lru;
 };
\ No newline at end of file
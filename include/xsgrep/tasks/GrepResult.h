@@ -7,9 +7,13 @@
 #include <xsearch/xsearch.h>
 
 #include <cstdio>
+#include <deque>
 #include <memory>
 
 #include "../grep.h"
+#include "../utils/Cancellation.h"
+#include "../utils/OutputSink.h"
+#include "../utils/Sequencer.h"
 
 // ===== Output colors =========================================================
 #define COLOR_RESET "\033[0m"
@@ -31,78 +35,313 @@
 #define BOLDWHITE "\033[1m\033[37m"   /* Bold White */
 // _____________________________________________________________________________
 
+/**
+ * LineNumberResolver: Turns the segment relative line numbers of partial
+ *  results (see Grep::PartialResult) into line numbers of the files. The
+ *  partial results must be passed in chunk order.
+ */
+class LineNumberResolver {
+ public:
+  void resolve(Grep::PartialResult* partial_result);
+  /// count the lines of the segments of a partial result without resolving
+  void skip(const std::vector<Grep::FileSegment>& segments);
+
+ private:
+  void enter_file(const std::string& file_name);
+
+  /// file of the last segment resolved
+  std::string _file_name;
+  /// number of lines of _file_name contained in the previous chunks
+  uint64_t _num_lines{0};
+};
+
 /**
  * GrepOutput: The actual result class that inherits xs::BaseResult.
- *  It collects vectors of GrepPartialResults.
+ *  It writes the Grep::PartialResults of all chunks ordered to an ostream.
+ *  Partial results are formatted by the calling (searching) thread and passed
+ *  to a Sequencer: its writer thread writes the formatted bytes into the
+ *  OutputSink in order, so searching threads do not wait for each other or
+ *  for the output unless max_pending results are waiting to be written.
+ *  Relative line numbers are resolved by an ordered prefix sum over the line
+ *  counts of the chunks: a partial result is resolved (and formatted) right
+ *  away if the counts of all previous chunks are known, otherwise once it is
+ *  its turn.
+ *  If the output is limited (max_count, quiet, files_with_matches or
+ *  files_without_match), partial results are evaluated in order, too: files
+ *  (or the whole search) that need no further searching are cancelled.
+ *  Context lines (before_context, after_context) are found by the searcher.
+ *  Those located in a neighbouring chunk are taken from the first and last
+ *  lines of the chunks (Grep::ContextFlags) by the writer thread, which also
+ *  merges adjacent groups of lines and separates the others by "--".
  */
-class GrepOutput : public xs::result::base::Result<
-                       std::pair<std::string, std::vector<Grep::Match>>> {
+class GrepOutput : public xs::result::base::Result<Grep::PartialResult> {
  public:
-  explicit GrepOutput(Grep::Options options, std::ostream& ostream = std::cout);
+  /**
+   * @param options: output options
+   * @param ostream: results are written to ostream
+   * @param cancellation: signaled once a file (or the search) needs no
+   *  further searching (limited output only)
+   */
+  explicit GrepOutput(Grep::Options options, std::ostream& ostream = std::cout,
+                      std::shared_ptr<Cancellation> cancellation = nullptr);
 
   /**
-   * Collect results and pass them ordered to the private add method.
-   *  Results that are received before they are in turn are buffered in a
-   *  std::map until its their turn.
+   * Collect results and pass them ordered to the OutputSink.
+   *  Results that are received before they are in turn are buffered (already
+   *  formatted) until its their turn.
    *
    * @param partial_result:
    * @param id: used for ordered output. Must be a closed sequence {0..X} of int
    */
-  void add(std::pair<std::string, std::vector<Grep::Match>> partial_result,
-           uint64_t id) override;
+  void add(Grep::PartialResult partial_result, uint64_t id) override;
 
   /**
-   * Return the number of lines written to ostream so far.
+   * Return the number of lines written to ostream so far (number of matching
+   *  lines found if quiet is set).
    *
    * @return:
    */
   size_t size() const override;
 
+  /**
+   * Write the last file without match if files_without_match is set. Must be
+   *  called once all partial results were added.
+   */
+  void finish();
+
+  /// a search task failed: release the tasks waiting to add their results
+  ///  (see Sequencer::abort())
+  void abort();
+
+  /// file_name relative to the directory root if it is located in root (as
+  ///  joined by root / path), file_name otherwise (or if root is empty)
+  static std::string_view relative_name(std::string_view file_name,
+                                        std::string_view root);
+
+  /// the lines of a chunk needed to complete the context of its neighbours
+  struct ChunkContext {
+    struct Line {
+      std::string file_name;
+      Grep::Match line;
+    };
+    /// lines flagged as Grep::HEAD_LINE and Grep::TAIL_LINE
+    std::vector<Line> head;
+    std::vector<Line> tail;
+    /// first and last line written by the chunk itself (position -1: none)
+    std::string first_file;
+    int64_t first_position{-1};
+    std::string last_file;
+    /// byte position of the line following the last written line
+    int64_t last_end{-1};
+    size_t before_missing{0};
+    size_t after_missing{0};
+  };
+
+  /// a partial result waiting for its turn
+  struct Pending {
+    /// only kept if the line numbers must be resolved before formatting
+    Grep::PartialResult partial_result;
+    std::string formatted;
+    size_t num_lines{0};
+    bool resolve_lines{false};
+    ChunkContext context;
+  };
+
+  /// queue statistics of the writer thread
+  [[nodiscard]] Sequencer<Pending>::Stats stats() const;
+
+  /// maximum number of formatted results waiting for the writer thread
+  static constexpr size_t max_pending = 64;
+
  private:
   /**
-   * The actual output of the collected results. Called from public add method.
-   *  Always writes to standard out.
+   * Format and write partial_result without regarding the order.
    * @param partial_result
    */
-  void add(
-      std::pair<std::string, std::vector<Grep::Match>> partial_result) override;
+  void add(Grep::PartialResult partial_result) override;
 
-  /// called by add for colored or uncolored output depending on _options.color
-  void colored(
-      std::pair<std::string, std::vector<Grep::Match>>& partial_result);
-  void uncolored(
-      std::pair<std::string, std::vector<Grep::Match>>& partial_result);
+  /// format partial_result (colored or uncolored depending on _options.color)
+  void format(const Grep::PartialResult& partial_result,
+              std::string* out) const;
+  void colored(const Grep::PartialResult& partial_result,
+               std::string* out) const;
+  void uncolored(const Grep::PartialResult& partial_result,
+                 std::string* out) const;
+  /// format the selected and context lines, groups of lines that are not
+  ///  adjacent are separated by "--" (not before the first line)
+  void format_context(const Grep::PartialResult& partial_result,
+                      std::string* out) const;
+  /// file name, line number and byte offset followed by separator
+  void append_prefix(const std::string& file_name, int64_t line_number,
+                     int64_t byte_position, char separator,
+                     std::string* out) const;
+  void append_group_separator(std::string* out) const;
+  /// collect the lines of partial_result needed by join_context()
+  static void chunk_context(const Grep::PartialResult& partial_result,
+                            ChunkContext* context);
+  /// write the context lines of a chunk located in its neighbours and the
+  ///  separator before its own lines (writer thread)
+  void join_context(const ChunkContext& context, std::string* out);
+  /// write a context line taken from a neighbouring chunk (writer thread)
+  void append_context_line(const ChunkContext::Line& line, std::string* out);
 
   Grep::Options _options;
-  std::ostream& _ostream;
+  OutputSink _sink;
+
+  /// write the pending result id (formatting it first if necessary), called
+  ///  by the writer thread only
+  void write_ordered(uint64_t id, Pending* pending);
+  /// add the line count of partial_result to the prefix sum and resolve its
+  ///  line numbers if all previous chunks were counted (acquires _mutex)
+  void resolve_early(Grep::PartialResult* partial_result, uint64_t id);
+  /// drop the matches exceeding max_count per file (writer thread)
+  void limit_matches(Grep::PartialResult* partial_result);
+  /// limit_matches() for results with context lines: only the trailing
+  ///  context of the last selected line is kept (writer thread)
+  void limit_context(Grep::PartialResult* partial_result);
+  /// write the names of files with (or without) matches (writer thread)
+  void list_files(const Grep::PartialResult& partial_result);
+  /// switch to the file file_name (files are added in order, writer thread)
+  void enter_file(const std::string& file_name);
+  /// write the name of a listed file (writer thread)
+  void write_file_name(const std::string& file_name);
 
-  /// Buffer for results that are received not in order
-  std::unordered_map<uint64_t, std::pair<std::string, std::vector<Grep::Match>>>
-      _buffer{};
-  /// Indicates the index of the result that is written next
-  uint64_t _current_index{0};
+  /// resolves the line numbers in order (limited output)
+  LineNumberResolver _line_numbers;
+  /// prefix sum of the line counts of the chunks [0, _line_index)
+  LineNumberResolver _line_prefix;
+  uint64_t _line_index{0};
+  /// line counts of chunks added before all previous chunks were counted
+  std::unordered_map<uint64_t, std::vector<Grep::FileSegment>> _line_segments;
+  /// line number state before chunks that were counted but not yet resolved
+  std::unordered_map<uint64_t, LineNumberResolver> _line_states;
   uint64_t _lines_written{0};
+
+  /// output is limited: results are evaluated in order
+  bool _limited{false};
+  std::shared_ptr<Cancellation> _cancellation;
+  /// name written for a single searched file (empty for directories)
+  std::string _single_file_name;
+  /// file of the last partial result evaluated
+  std::string _file_name;
+  bool _file_started{false};
+  /// number of matches of _file_name found so far
+  uint64_t _file_matches{0};
+
+  /// context lines are written (before_context or after_context set)
+  bool _context{false};
+  /// a line was written: file name and byte position of the following line
+  bool _written{false};
+  std::string _written_file;
+  int64_t _written_end{-1};
+  /// number of trailing context lines still to be written
+  size_t _after_remaining{0};
+  /// the last (up to before_context) lines of the previous chunks
+  std::deque<ChunkContext::Line> _recent_lines;
+  /// trailing context of the last line selected before max_count was reached
+  size_t _trailing{0};
+  int64_t _trailing_end{-1};
+
+  /// orders the results for the writer thread, constructed last (it starts
+  ///  the thread) and thus destroyed (joined) first
+  Sequencer<Pending> _sequencer;
 };
 
-class GrepContainer : public xs::result::base::Result<
-                          std::pair<std::string, std::vector<Grep::Match>>> {
+/**
+ * GrepVisitor: Passes the matches of the partial results in order to a
+ *  visitor (see Grep::visit()), the matches of a chunk are passed as
+ *  Grep::MatchViews into the partial result. The visitor is called by the
+ *  writer thread of a Sequencer: partial results that are not in turn wait
+ *  for it (up to max_pending of them and max_memory bytes).
+ *  Once the visitor returns false (or throws), the search is cancelled and
+ *  the remaining results are dropped.
+ */
+class GrepVisitor : public xs::result::base::Result<Grep::PartialResult> {
  public:
-  GrepContainer() = default;
+  /**
+   * @param visitor: called with the matches of every chunk that has some
+   * @param max_count: at most max_count matches per file are visited (-1:
+   *  unlimited)
+   * @param max_memory: maximum number of bytes of the results waiting for
+   *  their turn (0: unlimited)
+   * @param cancellation: signaled once the visitor stops the search (or
+   *  files reached max_count)
+   */
+  explicit GrepVisitor(Grep::visitor visitor, int64_t max_count = -1,
+                       size_t max_memory = 0,
+                       std::shared_ptr<Cancellation> cancellation = nullptr);
 
-  void add(std::pair<std::string, std::vector<Grep::Match>> partial_result,
-           uint64_t id) override;
-  void add(
-      std::pair<std::string, std::vector<Grep::Match>> partial_result) override;
+  void add(Grep::PartialResult partial_result, uint64_t id) override;
 
+  /// number of matches visited so far
   [[nodiscard]] size_t size() const override;
 
-  std::map<std::string, std::vector<Grep::Match>> copyResultSafe();
+  /**
+   * Wait until all partial results were visited. Must be called once all
+   *  partial results were added.
+   * @throws the exception thrown by the visitor
+   */
+  void finish();
+
+  /// a search task failed: release the tasks waiting to add their results
+  void abort();
+
+  /// maximum number of results waiting to be visited in order
+  static constexpr size_t max_pending = 64;
+
+ private:
+  void add(Grep::PartialResult partial_result) override;
+
+  Grep::visitor _visitor;
+  int64_t _max_count;
+  std::shared_ptr<Cancellation> _cancellation;
+  LineNumberResolver _line_numbers;
+  /// reused for the matches of every chunk
+  std::vector<Grep::MatchView> _views;
+  size_t _num_matches{0};
+  /// file of the last match visited and its number of matches visited
+  std::string _file_name;
+  uint64_t _file_matches{0};
+  /// the visitor stopped the search
+  bool _stopped{false};
+  /// visits the results in order, constructed last
+  Sequencer<Grep::PartialResult> _sequencer;
+};
+
+/**
+ * GrepCountContainer: Collects the number of matching lines per file from the
+ *  partial results of a GrepSearcher in count only mode. Files are listed in
+ *  the order of the chunks they were read from.
+ */
+class GrepCountContainer
+    : public xs::result::base::Result<Grep::PartialResult> {
+ public:
+  /**
+   * @param max_count: counts are limited to max_count (-1: unlimited)
+   * @param cancellation: files are cancelled once max_count is reached
+   */
+  explicit GrepCountContainer(
+      int64_t max_count = -1,
+      std::shared_ptr<Cancellation> cancellation = nullptr);
+
+  void add(Grep::PartialResult partial_result, uint64_t id) override;
+  void add(Grep::PartialResult partial_result) override;
+
+  /// number of files
+  [[nodiscard]] size_t size() const override;
+
+  std::vector<std::pair<std::string, uint64_t>> copyResultSafe();
+
+  /// a search task failed: release the tasks waiting to add their results
+  void abort();
+
+  /// maximum number of results waiting to be added in order
+  static constexpr size_t max_pending = 64;
 
  private:
-  /// Buffer for results that are received not in order
-  std::unordered_map<uint64_t, std::pair<std::string, std::vector<Grep::Match>>>
-      _buffer{};
-  std::map<std::string, std::vector<Grep::Match>> _data;
-  /// Indicates the index of the result that is written next
-  uint64_t _current_index{0};
+  std::vector<std::pair<std::string, uint64_t>> _counts;
+  int64_t _max_count;
+  std::shared_ptr<Cancellation> _cancellation;
+  /// adds the results in order, constructed last
+  Sequencer<Grep::PartialResult> _sequencer;
 };
\ No newline at end of file
@@ -3,22 +3,47 @@
 
 #pragma once
 
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "../grep.h"
+#include "../utils/MultiLiteral.h"
+#include "./GrepReader.h"
 #include "./GrepResult.h"
 
 /**
  * GrepSearcher: The searcher used by the xs::Executor for searching results.
+ *  Copies share the compiled patterns (which are not modified by searching).
  */
-class GrepSearcher
-    : public xs::task::base::ReturnProcessor<xs::DataChunk,
-                                             std::pair<std::string, std::vector<Grep::Match>>> {
+class GrepSearcher : public xs::task::base::ReturnProcessor<xs::DataChunk,
+                                                          Grep::PartialResult> {
  public:
   /**
    * @param options: search/output options for grep like results
+   * @param boundary: only whole words or lines match. Literal patterns are
+   *  found by the literal searches and their occurrences are checked in
+   *  place, regular expressions are wrapped by boundary expressions
    */
   GrepSearcher(std::string pattern, bool byte_offset, bool line_number,
                bool match_only, bool regex, bool ignore_case,
-               Grep::Locale locale);
+               Grep::Locale locale,
+               Grep::Boundary boundary = Grep::Boundary::NONE);
+
+  /**
+   * Search for several patterns at once: a line matches if any of the
+   *  patterns matches. Literal patterns are searched by a MultiLiteral,
+   *  regular expressions are combined into one alternation. Without any
+   *  pattern (e.g. an empty pattern file), no line matches.
+   */
+  GrepSearcher(std::vector<std::string> patterns, bool byte_offset,
+               bool line_number, bool match_only, bool regex, bool ignore_case,
+               Grep::Locale locale,
+               Grep::Boundary boundary = Grep::Boundary::NONE);
 
   /**
    * Search provided data according to the specified search criteria using a
@@ -27,19 +52,180 @@ class GrepSearcher
    * @param data: data that are searched
    * @return
    */
-  std::pair<std::string, std::vector<Grep::Match>> process(const xs::DataChunk* data) const override;
+  Grep::PartialResult process(const xs::DataChunk* data) const override;
+
+  /**
+   * If set, the location of every pattern occurrence within a matching line is
+   *  stored in Grep::PartialResult::highlights, so that the output does not
+   *  need to search the lines again for coloring.
+   */
+  GrepSearcher& set_highlight(bool val);
+
+  /**
+   * Chunks listed in chunk_files contain the data of several files or parts
+   *  of files (read by the GrepReader). Their results are split into
+   *  Grep::FileSegments with line numbers relative to the segments.
+   */
+  GrepSearcher& set_chunk_files(std::shared_ptr<ChunkFileTable> chunk_files);
+
+  /**
+   * Only count matching lines: no matches are stored, the result consists of
+   *  one Grep::FileSegment per file of the chunk (also for files without
+   *  matches). The number of matching lines of a segment is the difference of
+   *  its matches_end and the matches_end of the previous segment.
+   */
+  GrepSearcher& set_count_only(bool val);
+
+  /**
+   * Select the lines that do not match: the matching lines of a chunk are
+   *  searched as usual and the lines in between are returned (searchers
+   *  constructed with only_matching are not supported). Highlights are not
+   *  computed.
+   * @param join_lines: return consecutive selected lines as one match that
+   *  holds the lines separated by new lines, so that long runs of selected
+   *  lines are copied and written as one slice. Ignored if line numbers, byte
+   *  offsets or context are needed (which are per line).
+   */
+  GrepSearcher& set_invert_match(bool val, bool join_lines = false);
+
+  /// chunks of cancelled searches (or files) are not searched
+  GrepSearcher& set_cancellation(std::shared_ptr<Cancellation> cancellation);
+
+  /**
+   * Add up to before (after) lines of leading (trailing) context of every
+   *  selected line to the result (see Grep::ContextFlags). Context does not
+   *  cross file boundaries. Ignored if only matching is set. Chunks are
+   *  prepared for the context output even if before and after are 0.
+   */
+  GrepSearcher& set_context(size_t before, size_t after);
 
  private:
-  std::pair<std::string, std::vector<Grep::Match>> process_regex(const xs::DataChunk* data) const;
-  std::pair<std::string, std::vector<Grep::Match>> process_plain(const xs::DataChunk* data) const;
+  /// (local offset, size) of the lines (or matches if only matching) found
+  std::vector<std::pair<size_t, size_t>> search_regex(
+      const xs::DataChunk* data) const;
+  std::vector<std::pair<size_t, size_t>> search_plain(
+      const xs::DataChunk* data) const;
+  std::vector<std::pair<size_t, size_t>> search_multi(
+      const xs::DataChunk* data) const;
+  /// regex search of the lines containing a required literal only (or, if
+  ///  none are known, of the lines found by searching the whole chunk)
+  std::vector<std::pair<size_t, size_t>> search_regex_prefiltered(
+      const xs::DataChunk* data) const;
+  /// literal search of whole words or lines (see Grep::Boundary)
+  std::vector<std::pair<size_t, size_t>> search_bounded(
+      const xs::DataChunk* data) const;
+  /// the first occurrence of any of the literal patterns in data
+  std::optional<MultiLiteral::Match> find_literal(const char* data,
+                                                  size_t size) const;
+  /// size of the longest match at data[offset] that is bounded (see
+  ///  Grep::Boundary), given the leftmost-longest match of match_size bytes
+  ///  there (shorter patterns are tried if it is not bounded)
+  std::optional<size_t> bounded_match(const char* data, size_t size,
+                                      size_t offset, size_t match_size) const;
+  /// match of the pattern in [position, end) of text (the part of the match
+  ///  of the wrapped regex that the pattern matched)
+  bool match_regex(re2::StringPiece text, size_t position,
+                   re2::StringPiece* match) const;
+
+  /// set line numbers and byte positions of the matches of a chunk of a file
+  void set_positions(const xs::DataChunk* data,
+                     const std::vector<std::pair<size_t, size_t>>& spans,
+                     uint64_t base_offset, bool byte_position,
+                     Grep::PartialResult* result) const;
+  /// set the line numbers relative to the start of the chunk and the number
+  ///  of lines of the chunk (see LineNumberResolver) and the byte positions
+  void set_relative_positions(
+      const xs::DataChunk* data,
+      const std::vector<std::pair<size_t, size_t>>& spans,
+      uint64_t base_offset, bool byte_position,
+      Grep::PartialResult* result) const;
+  /// count the matches of a chunk per file (see set_count_only())
+  void count_file_matches(const xs::DataChunk* data,
+                          const std::vector<ChunkFile>& files,
+                          const std::vector<std::pair<size_t, size_t>>& spans,
+                          Grep::PartialResult* result) const;
+  /// split the matches of a chunk read by the GrepReader into file segments
+  void set_file_segments(const xs::DataChunk* data,
+                         const std::vector<ChunkFile>& files,
+                         std::vector<std::pair<size_t, size_t>>* spans,
+                         bool byte_position, Grep::PartialResult* result) const;
+
+  /// compute Grep::PartialResult::highlights for all matches of result
+  void add_highlights(Grep::PartialResult* result) const;
+
+  /**
+   * Add the context lines of the selected lines in spans and the lines at the
+   *  borders of the chunk to spans (merged and sorted by offset).
+   *
+   * @param regions: [begin, end) of the data of every file in the chunk
+   * @param flags: set to the Grep::ContextFlags of every span
+   */
+  void add_context(const xs::DataChunk* data,
+                   const std::vector<std::pair<size_t, size_t>>& regions,
+                   std::vector<std::pair<size_t, size_t>>* spans,
+                   std::vector<uint8_t>* flags,
+                   Grep::PartialResult* result) const;
 
   /// search for line numbers
   std::string _pattern;
+  /// lower case pattern used for case-insensitive searches
+  std::string _pattern_lower;
   bool _line_number;
   bool _byte_offset;
   bool _only_matching;
   bool _regex;
   bool _ignore_case;
   Grep::Locale _locale;
-  std::unique_ptr<re2::RE2> _re_pattern;
+  Grep::Boundary _boundary;
+  bool _highlight{false};
+  bool _count_only{false};
+  bool _invert{false};
+  bool _join_lines{false};
+  bool _context{false};
+  /// no pattern is searched: no line matches
+  bool _no_patterns{false};
+  size_t _before_context{0};
+  size_t _after_context{0};
+  std::shared_ptr<Cancellation> _cancellation;
+  std::shared_ptr<ChunkFileTable> _chunk_files;
+  std::shared_ptr<const re2::RE2> _re_pattern;
+  /// literal patterns if several are searched
+  std::shared_ptr<const MultiLiteral> _multi;
+  /// literals required by the regex pattern (nullptr if none are known)
+  std::shared_ptr<const MultiLiteral> _required_literals;
+  /// the regex pattern matches exactly the required literals
+  bool _literals_exact{false};
+};
+
+/**
+ * SearcherCache: The searchers of recent searches, so that a resident process
+ *  (see xs --serve) compiles the patterns of repeated queries only once. At
+ *  most max_size searchers are kept (the least recently used are dropped).
+ *  Thread safe.
+ */
+class SearcherCache {
+ public:
+  explicit SearcherCache(size_t max_size = 64);
+
+  /**
+   * A copy of the cached searcher constructed with the same arguments (see
+   *  GrepSearcher), it is constructed and cached if there is none.
+   */
+  std::unique_ptr<GrepSearcher> get(
+      const std::vector<std::string>& patterns, bool byte_offset,
+      bool line_number, bool only_matching, bool regex, bool ignore_case,
+      Grep::Locale locale, Grep::Boundary boundary = Grep::Boundary::NONE);
+
+  /// number of cached searchers
+  [[nodiscard]] size_t size() const;
+
+ private:
+  size_t _max_size;
+  mutable std::mutex _mutex;
+  /// searchers by the arguments they were constructed with, most recently
+  ///  used first
+  std::list<std::pair<std::string, GrepSearcher>> _searchers;
+  std::unordered_map<std::string,
+                     std::list<std::pair<std::string, GrepSearcher>>::iterator>
+      _index;
 };
@@ -0,0 +1,143 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#pragma once
+
+#include <xsearch/xsearch.h>
+
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "../utils/WorkerPool.h"
+
+/**
+ * PoolExecutor: Equivalent of xs::Executor that runs its worker loops as tasks
+ *  of a (persistent) WorkerPool instead of starting its own threads.
+ *  Each of the num_threads tasks reads a chunk (at most max_readers tasks of
+ *  the reader read at the same time), runs the inplace processors and the
+ *  return processor on it and adds the result to the result object until the
+ *  reader is exhausted. Exceptions thrown by a task are rethrown by join().
+ *  Once a task failed, the result is aborted (if ResT provides abort()): the
+ *  chunk ids taken by the failed task are never added, so tasks waiting to
+ *  add their results in order must not wait for them.
+ */
+template <typename DataT, typename ResT, typename PartResT>
+class PoolExecutor {
+ public:
+  PoolExecutor(
+      int num_threads,
+      std::unique_ptr<xs::task::base::DataProvider<DataT>> reader,
+      std::vector<std::unique_ptr<xs::task::base::InplaceProcessor<DataT>>>
+          processors,
+      std::unique_ptr<xs::task::base::ReturnProcessor<DataT, PartResT>>
+          return_processor,
+      std::unique_ptr<ResT> result, WorkerPool& pool = WorkerPool::global())
+      : _reader(std::move(reader)),
+        _processors(std::move(processors)),
+        _return_processor(std::move(return_processor)),
+        _result(std::move(result)),
+        _running(num_threads < 1 ? 1 : num_threads) {
+    for (int i = _running; i > 0; --i) {
+      pool.submit([this] { main(); });
+    }
+  }
+
+  PoolExecutor(const PoolExecutor&) = delete;
+  PoolExecutor& operator=(const PoolExecutor&) = delete;
+
+  ~PoolExecutor() {
+    // the tasks reference this object: wait for them in any case
+    std::unique_lock lock(_mutex);
+    _cv.wait(lock, [this] { return _running == 0; });
+  }
+
+  /// wait until all data were processed
+  void join() {
+    std::unique_lock lock(_mutex);
+    _cv.wait(lock, [this] { return _running == 0; });
+    if (_error != nullptr) {
+      std::rethrow_exception(std::exchange(_error, nullptr));
+    }
+  }
+
+  ResT* getResult() { return _result.get(); }
+
+ private:
+  void main() {
+    try {
+      while (true) {
+        {
+          std::unique_lock lock(_mutex);
+          _cv.wait(lock, [this] {
+            return _failed || _reading < _reader->get_max_readers();
+          });
+          if (_failed) {
+            break;
+          }
+          _reading++;
+        }
+        std::optional<std::pair<DataT, xs::chunk_index>> data;
+        try {
+          data = _reader->getNextData();
+        } catch (...) {
+          finish_reading();
+          throw;
+        }
+        finish_reading();
+        if (!data.has_value()) {
+          break;
+        }
+        for (const auto& processor : _processors) {
+          processor->process(&data->first);
+        }
+        auto result = _return_processor->process(&data->first);
+        xs::chunk_index id = data->second;
+        // release the chunk before add() possibly blocks until the result is
+        //  in turn: waiting tasks only hold their (small) results
+        data.reset();
+        _result->add(std::move(result), id);
+      }
+    } catch (...) {
+      {
+        std::unique_lock lock(_mutex);
+        if (_error == nullptr) {
+          _error = std::current_exception();
+        }
+        _failed = true;
+      }
+      if constexpr (requires(ResT* result) { result->abort(); }) {
+        _result->abort();
+      }
+    }
+    std::unique_lock lock(_mutex);
+    _running--;
+    _cv.notify_all();
+  }
+
+  void finish_reading() {
+    std::unique_lock lock(_mutex);
+    _reading--;
+    _cv.notify_all();
+  }
+
+  std::unique_ptr<xs::task::base::DataProvider<DataT>> _reader;
+  std::vector<std::unique_ptr<xs::task::base::InplaceProcessor<DataT>>>
+      _processors;
+  std::unique_ptr<xs::task::base::ReturnProcessor<DataT, PartResT>>
+      _return_processor;
+  std::unique_ptr<ResT> _result;
+
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  /// number of tasks that did not finish yet
+  int _running;
+  /// number of tasks currently reading
+  int _reading{0};
+  bool _failed{false};
+  std::exception_ptr _error;
+};
\ No newline at end of file
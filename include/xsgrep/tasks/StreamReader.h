@@ -0,0 +1,59 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#pragma once
+
+#include <xsearch/xsearch.h>
+
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "../utils/Cancellation.h"
+
+/**
+ * StreamReader: Reads a stream (e.g. a pipe on stdin) with low latency.
+ *  Instead of waiting until a block of fixed size is filled, a chunk is
+ *  returned as soon as no more data are available right away. It contains all
+ *  complete lines read so far, an incomplete last line is kept for the next
+ *  chunk (unless the stream ended).
+ *  The block size adapts to the stream: it doubles while the reads fill the
+ *  block (up to max_size) and halves while they do not (down to min_size), so
+ *  fast streams are still searched in large chunks.
+ *  Waiting for data ends once the search is cancelled.
+ */
+class StreamReader : public xs::task::base::DataProvider<xs::DataChunk> {
+ public:
+  /**
+   * @param fd: file descriptor of the stream (not closed by the reader)
+   * @param min_size: minimum block size
+   * @param max_size: maximum block size (exceeded by longer lines only)
+   */
+  explicit StreamReader(int fd, size_t min_size = 64 << 10,
+                        size_t max_size = 16 << 20);
+
+  std::optional<std::pair<xs::DataChunk, xs::chunk_index>> getNextData()
+      override;
+
+  /// stop waiting for data once the search was cancelled
+  StreamReader& set_cancellation(std::shared_ptr<Cancellation> cancellation);
+
+  /// current block size
+  [[nodiscard]] size_t block_size() const;
+
+ private:
+  /// wait up to timeout_ms milliseconds until the stream is readable
+  [[nodiscard]] bool wait_readable(int timeout_ms) const;
+
+  int _fd;
+  size_t _min_size;
+  size_t _max_size;
+  size_t _block_size;
+  /// incomplete last line of the previous chunk
+  std::string _carry;
+  /// offset of the first byte of _carry within the stream
+  uint64_t _offset{0};
+  xs::chunk_index _chunk_index{0};
+  bool _eof{false};
+  std::shared_ptr<Cancellation> _cancellation;
+};
\ No newline at end of file
@@ -0,0 +1,108 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#pragma once
+
+#include <sys/uio.h>
+#include <xsearch/xsearch.h>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "../utils/Cancellation.h"
+
+/**
+ * UringReader: Reads a file using io_uring. Up to queue_depth reads of chunks
+ *  are kept outstanding, so a single reader thread can saturate devices that
+ *  need many requests in flight (e.g. NVMe arrays with cold caches), which
+ *  blocking read/mmap can only reach with many reader threads.
+ *  Every read goes directly into the DataChunk that is returned, no data are
+ *  copied. To this end, reads end with a new line: a block is extended to the
+ *  end of its last line, which is found by a small read before the block is
+ *  submitted. The chunks are returned in file order.
+ *  If a metafile is set, the chunks described by it are read instead of
+ *  blocks of block_size (and returned like the x-search metafile readers do,
+ *  i.e. still compressed).
+ *  io_uring is used through the raw system calls (no liburing needed). The
+ *  constructor throws a std::system_error if io_uring is not available (e.g.
+ *  old kernels or seccomp filters of containers), see available().
+ */
+class UringReader : public xs::task::base::DataProvider<xs::DataChunk> {
+ public:
+  /**
+   * @param path: file that is read
+   * @param meta_file: metafile of the file (blocks of block_size are read if
+   *  empty)
+   * @param queue_depth: maximum number of reads in flight (at least 1)
+   * @param block_size: size of the reads if no metafile is set
+   * @throws std::system_error if the file cannot be opened or io_uring is not
+   *  available
+   */
+  explicit UringReader(std::string path, std::string meta_file = "",
+                       size_t queue_depth = 16, size_t block_size = 4 << 20);
+  ~UringReader() override;
+
+  UringReader(const UringReader&) = delete;
+  UringReader& operator=(const UringReader&) = delete;
+
+  std::optional<std::pair<xs::DataChunk, xs::chunk_index>> getNextData()
+      override;
+
+  /// stop reading once the search is cancelled
+  UringReader& set_cancellation(std::shared_ptr<Cancellation> cancellation);
+
+  /// io_uring can be used by this process (checked once)
+  static bool available();
+
+ private:
+  class Ring;
+
+  /// a read into the chunk that is returned once the read is complete
+  struct Request {
+    xs::DataChunk chunk;
+    uint64_t offset{0};
+    size_t size{0};
+    /// number of bytes read so far (reads may complete partially)
+    size_t done{0};
+    bool complete{false};
+    /// chunk of the metafile that is read
+    std::optional<xs::ChunkMetaData> meta_data;
+    iovec iov{};
+  };
+
+  /// queue reads until all buffers are in use (holds _mutex)
+  void submit_reads();
+  /// queue the (remaining) read of _requests[slot]
+  void submit_read(size_t slot);
+  /// wait until the read of _requests[slot] is complete
+  void wait_for(size_t slot);
+  /// process all completed reads
+  void reap();
+  /// end of the block starting at offset: the end of the line containing
+  ///  its last byte (or the end of the file)
+  uint64_t block_end(uint64_t offset) const;
+
+  std::string _path;
+  int _fd{-1};
+  uint64_t _size{0};
+  size_t _block_size;
+  std::unique_ptr<xs::MetaFile> _meta_file;
+  std::unique_ptr<Ring> _ring;
+  std::shared_ptr<Cancellation> _cancellation;
+
+  std::mutex _mutex;
+  std::vector<Request> _requests;
+  /// slots of the requests that are not in use
+  std::vector<size_t> _free_slots;
+  /// slots of the queued reads in file order
+  std::deque<size_t> _queue;
+  /// number of reads submitted to the kernel but not completed yet
+  size_t _in_flight{0};
+  /// offset of the next block (no metafile), always the start of a line
+  uint64_t _next_offset{0};
+  xs::chunk_index _chunk_index{0};
+};
\ No newline at end of file
@@ -0,0 +1,74 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+/**
+ * BoundedQueue: Thread safe FIFO queue with a maximum number of elements.
+ *  push() blocks while the queue is full, pop() blocks while the queue is
+ *  empty. Once close() was called, push() drops new elements and pop()
+ *  returns std::nullopt as soon as the queue is empty.
+ */
+template <typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(size_t capacity) : _capacity(capacity) {}
+
+  /**
+   * Add value to the queue. Blocks while the queue is full.
+   * @return false if the queue was closed (value was not added)
+   */
+  bool push(T value) {
+    std::unique_lock lock(_mutex);
+    _not_full.wait(lock,
+                   [this] { return _closed || _queue.size() < _capacity; });
+    if (_closed) {
+      return false;
+    }
+    _queue.push_back(std::move(value));
+    _not_empty.notify_one();
+    return true;
+  }
+
+  /**
+   * Remove the first value from the queue. Blocks while the queue is empty
+   *  and not closed.
+   */
+  std::optional<T> pop() {
+    std::unique_lock lock(_mutex);
+    _not_empty.wait(lock, [this] { return _closed || !_queue.empty(); });
+    if (_queue.empty()) {
+      return {};
+    }
+    T value = std::move(_queue.front());
+    _queue.pop_front();
+    _not_full.notify_one();
+    return value;
+  }
+
+  /// no more values will be added: wake up all waiting threads
+  void close() {
+    std::unique_lock lock(_mutex);
+    _closed = true;
+    _not_empty.notify_all();
+    _not_full.notify_all();
+  }
+
+  [[nodiscard]] size_t size() const {
+    std::unique_lock lock(_mutex);
+    return _queue.size();
+  }
+
+ private:
+  size_t _capacity;
+  bool _closed{false};
+  std::deque<T> _queue;
+  mutable std::mutex _mutex;
+  std::condition_variable _not_empty;
+  std::condition_variable _not_full;
+};
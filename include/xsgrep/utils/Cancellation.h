@@ -0,0 +1,40 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+/**
+ * Cancellation: Signal to stop a search early (e.g. once --max-count lines
+ *  were found). It is set by the (ordered) result and observed by the reader,
+ *  the processors and the searcher, which skip their work once the search or
+ *  the file they are working on was cancelled.
+ */
+class Cancellation {
+ public:
+  /**
+   * @param single_file: the search covers a single file: cancelling the file
+   *  cancels the whole search
+   */
+  explicit Cancellation(bool single_file = false);
+
+  /// stop the whole search
+  void cancel();
+  [[nodiscard]] bool cancelled() const;
+
+  /// stop searching file_name: its remaining chunks are skipped
+  void cancel_file(const std::string& file_name);
+  [[nodiscard]] bool file_cancelled(const std::string& file_name) const;
+
+ private:
+  bool _single_file;
+  std::atomic<bool> _cancelled{false};
+  /// set once a file was cancelled: checks are lock free until then
+  std::atomic<bool> _files_cancelled{false};
+  mutable std::mutex _mutex;
+  std::unordered_set<std::string> _cancelled_files;
+};
\ No newline at end of file
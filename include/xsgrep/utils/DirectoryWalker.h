@@ -0,0 +1,113 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "./BoundedQueue.h"
+#include "./ErrorLog.h"
+
+/**
+ * DirectoryWalker: Multi-threaded recursive directory traversal.
+ *  Every thread owns a deque of directories it still has to read. Threads
+ *  process their own deque from the back and steal directories from the front
+ *  of the other threads' deques once their own deque is empty.
+ *  The type of a directory entry is taken from d_type (getdents) where the
+ *  file system provides it, so that stat is only called for symbolic links and
+ *  entries of unknown type.
+ *  The files of a directory are handed out through a bounded queue as soon as
+ *  the directory was read: the traversal pauses while the queue is full, so
+ *  the memory used by found files does not depend on the size of the tree.
+ *  The deques are not bounded: they hold the paths of the directories that
+ *  were found but not read yet (at most the number of directories).
+ *  Every file carries the listing of its directory, so that callers can check
+ *  for companion files (e.g. metafiles) without calling stat.
+ *
+ *  The order in which files are returned is not deterministic.
+ */
+class DirectoryWalker {
+ public:
+  struct File {
+    std::string path;
+    /// sorted names of the regular files in the directory of the file
+    ///  (nullptr if the file is the root)
+    std::shared_ptr<const std::vector<std::string>> siblings;
+
+    /**
+     * Check if the directory of the file contains a regular file called name.
+     * @return std::nullopt if the listing of the directory is not known.
+     */
+    [[nodiscard]] std::optional<bool> has_sibling(std::string_view name) const;
+  };
+
+  /**
+   * @param root: file or directory. If root is a regular file, it is the only
+   *  file returned.
+   * @param max_depth: maximum recursion depth (-1: unlimited). Directories
+   *  with a depth >= max_depth are not read (root has depth 0).
+   * @param num_threads: number of traversal threads (<= 0: automatic)
+   * @param max_queued_files: capacity of the queue of found files
+   * @param errors: directories that cannot be read are reported to errors
+   *  (std::cerr if nullptr), the traversal goes on
+   */
+  explicit DirectoryWalker(std::string root, int max_depth = -1,
+                           int num_threads = 0,
+                           size_t max_queued_files = 4096,
+                           std::shared_ptr<ErrorLog> errors = nullptr);
+
+  DirectoryWalker(const DirectoryWalker&) = delete;
+  DirectoryWalker& operator=(const DirectoryWalker&) = delete;
+
+  ~DirectoryWalker();
+
+  /**
+   * Get the next file. Blocks until a file was found.
+   * @return std::nullopt if all files were returned.
+   */
+  std::optional<std::string> next();
+
+  /**
+   * Get the next file together with the listing of its directory. Blocks
+   *  until a file was found.
+   * @return std::nullopt if all files were returned.
+   */
+  std::optional<File> next_file();
+
+ private:
+  struct Directory {
+    std::string path;
+    int depth;
+  };
+
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<Directory> directories;
+  };
+
+  void run(size_t id);
+  void read_directory(size_t id, const Directory& directory);
+  void push_directory(size_t id, Directory directory);
+  std::optional<Directory> pop_directory(size_t id);
+
+  int _max_depth;
+  std::vector<std::unique_ptr<WorkQueue>> _work_queues;
+  BoundedQueue<File> _files;
+  std::shared_ptr<ErrorLog> _errors;
+
+  /// number of directories that are queued or currently read
+  std::atomic<size_t> _pending{0};
+  std::atomic<bool> _stop{false};
+  std::mutex _idle_mutex;
+  std::condition_variable _idle_cv;
+  std::vector<std::thread> _threads;
+};
@@ -0,0 +1,30 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+/**
+ * ErrorLog: Reports the errors of single files (e.g. files or directories that
+ *  cannot be opened) and counts them. The search goes on, the count decides
+ *  the exit status. Messages of concurrent threads are written one at a time.
+ */
+class ErrorLog {
+ public:
+  /// @param stream: the messages are written to (e.g. the client of a server)
+  explicit ErrorLog(std::ostream* stream = &std::cerr);
+
+  /// write "<path>: <message>" and count the error
+  void report(const std::string& path, const std::string& message);
+  /// number of errors reported
+  [[nodiscard]] size_t count() const;
+
+ private:
+  std::mutex _mutex;
+  std::ostream* _stream;
+  std::atomic<size_t> _count{0};
+};
\ No newline at end of file
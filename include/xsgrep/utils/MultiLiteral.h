@@ -0,0 +1,104 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * MultiLiteral: Searches for a set of literal patterns at once (-e/-f).
+ *  Matches are reported leftmost-longest like grep does: the match that starts
+ *  first and, among the patterns starting there, the longest one.
+ *  The patterns are compiled into an Aho-Corasick automaton with a dense
+ *  transition table over the byte classes used by the patterns (all other
+ *  bytes share one class), so that the cost per byte does not depend on the
+ *  number of patterns.
+ *  Small sets (few distinct leading byte pairs) are not run through the
+ *  automaton: blocks of the haystack are compared against the leading byte
+ *  pairs (SIMD) and only candidates are verified by walking the trie.
+ */
+class MultiLiteral {
+ public:
+  struct Match {
+    /// offset of the match relative to the searched data
+    size_t offset{0};
+    size_t size{0};
+    /// index of the matching pattern (first one if patterns are duplicated)
+    size_t pattern{0};
+  };
+
+  /**
+   * @param patterns: literal patterns (at least one)
+   * @param ignore_case: ASCII case-insensitive search
+   */
+  explicit MultiLiteral(const std::vector<std::string>& patterns,
+                        bool ignore_case = false);
+
+  /**
+   * Search for the leftmost-longest match within [data, data + size).
+   * @return the match or std::nullopt if no pattern occurs
+   */
+  [[nodiscard]] std::optional<Match> find(const char* data, size_t size) const;
+
+  /**
+   * All matches starting at data[position], longest first (e.g. shorter
+   *  patterns at the position of a leftmost-longest match that is rejected).
+   */
+  [[nodiscard]] std::vector<Match> matches_at(const char* data, size_t size,
+                                              size_t position) const;
+
+  [[nodiscard]] size_t num_patterns() const;
+  /// the automaton is used (the set is too large for the prefilter)
+  [[nodiscard]] bool uses_automaton() const;
+
+ private:
+  /// longest pattern starting at data[position] (walks the trie)
+  std::optional<Match> match_at(const char* data, size_t size,
+                                size_t position) const;
+  std::optional<Match> find_prefilter(const char* data, size_t size) const;
+  std::optional<Match> find_automaton(const char* data, size_t size) const;
+
+  /// add a state with the given depth, return its (premultiplied) id
+  uint32_t add_state(uint32_t depth);
+  void build_automaton();
+  void build_prefilter(const std::vector<std::string>& patterns);
+
+  /// a transition to an accepting state has this bit set
+  static constexpr uint32_t accept_flag = 1u << 31;
+  /// maximum number of leading byte pairs compared per block
+  static constexpr size_t max_prefixes = 8;
+
+  size_t _num_patterns;
+  bool _ignore_case;
+  /// byte class of every byte (0: byte does not occur in any pattern)
+  std::array<uint16_t, 256> _classes{};
+  uint32_t _num_classes{1};
+  /// transitions: _delta[state + class], state ids are premultiplied by
+  ///  _num_classes, the root is 0
+  std::vector<uint32_t> _delta;
+  /// per state (indexed by id / _num_classes): depth within the trie
+  std::vector<uint32_t> _depth;
+  /// per state: pattern spelled by the state (-1: none)
+  std::vector<int32_t> _pattern;
+  /// per state: length of the longest pattern that is a suffix of the state
+  std::vector<uint32_t> _output;
+  size_t _max_length{0};
+  /// index of the empty pattern (-1: none), it matches everywhere
+  int64_t _empty_pattern{-1};
+
+  /// leading byte pairs of the patterns (single: one byte pattern)
+  struct Prefix {
+    char first;
+    char second;
+    bool single;
+  };
+  std::vector<Prefix> _prefixes;
+  /// leading bytes of the patterns (prefilter without SIMD)
+  std::array<bool, 256> _first_bytes{};
+  bool _use_automaton{true};
+};
\ No newline at end of file
@@ -0,0 +1,64 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * NgramFilter: Bloom filter of the trigrams (three consecutive bytes, ASCII
+ *  case folded) of a chunk. A literal of at least three bytes can only occur
+ *  in the chunk if all of its trigrams were added, so a chunk whose filter
+ *  rejects every literal required by a search does not need to be read.
+ *  Literals shorter than three bytes are always accepted.
+ *
+ *  xspp writes the filters of all chunks of a file to <metafile>.ngrams:
+ *  a header (magic, size of a filter) followed by the original offset and
+ *  the bits of every chunk.
+ */
+class NgramFilter {
+ public:
+  /// @param num_bytes: size of the filter (rounded up to a power of two)
+  explicit NgramFilter(size_t num_bytes);
+
+  /// add all trigrams of data
+  void add(const char* data, size_t size);
+
+  /// all trigrams of literal were added (maybe)
+  [[nodiscard]] bool may_contain(std::string_view literal) const;
+  /// may_contain() is true for any of literals
+  [[nodiscard]] bool may_contain_any(
+      const std::vector<std::string>& literals) const;
+
+  [[nodiscard]] size_t num_bytes() const;
+
+  /// write the filter of the chunk at original_offset
+  void write(std::ostream& out, uint64_t original_offset) const;
+  /// write the header of a filter file for filters of num_bytes
+  static void write_header(std::ostream& out, size_t num_bytes);
+  /**
+   * Read all filters of a filter file.
+   * @return filters by the original offset of their chunk
+   * @throws std::runtime_error if path is not a valid filter file
+   */
+  static std::unordered_map<uint64_t, NgramFilter> read_file(
+      const std::string& path);
+  /**
+   * Size of the filters of a filter file (read from its header).
+   * @throws std::runtime_error if path is not a valid filter file
+   */
+  static size_t read_filter_size(const std::string& path);
+
+  /// suffix of filter files appended to the path of the metafile
+  static constexpr const char* file_suffix = ".ngrams";
+
+ private:
+  std::vector<uint64_t> _bits;
+  uint64_t _mask;
+};
\ No newline at end of file
@@ -0,0 +1,61 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/**
+ * Append the decimal representation of val to out without going through
+ *  std::ostream formatting (no locale, no temporary strings).
+ */
+void append_uint(std::string* out, uint64_t val);
+void append_int(std::string* out, int64_t val);
+
+/**
+ * OutputSink: Buffered byte sink used for writing results.
+ *  Data are collected in one large buffer that is reused for the whole
+ *  lifetime of the sink and written with a single write(2) once it is full.
+ *  Blocks that are larger than the free buffer space are not copied but
+ *  written together with the buffered data using writev(2).
+ *
+ *  If the sink is constructed from an std::ostream that is not std::cout, the
+ *  buffer is flushed to the ostream instead (e.g. for std::stringstreams).
+ */
+class OutputSink {
+ public:
+  static constexpr size_t default_capacity = 1 << 20;
+
+  explicit OutputSink(int fd, size_t capacity = default_capacity);
+  explicit OutputSink(std::ostream& stream,
+                      size_t capacity = default_capacity);
+
+  OutputSink(const OutputSink&) = delete;
+  OutputSink& operator=(const OutputSink&) = delete;
+
+  ~OutputSink();
+
+  void write(std::string_view data);
+  void write(char c);
+  void write_uint(uint64_t val);
+  void write_int(int64_t val);
+
+  /// write all buffered data to the underlying file descriptor/ostream
+  void flush();
+
+  /// total number of bytes passed to the sink so far
+  [[nodiscard]] uint64_t bytes_written() const;
+
+ private:
+  /// write buffered data followed by data (may be empty) to the target
+  void write_through(std::string_view data);
+
+  int _fd{-1};
+  std::ostream* _ostream{nullptr};
+  std::string _buffer;
+  size_t _capacity;
+  uint64_t _bytes_written{0};
+};
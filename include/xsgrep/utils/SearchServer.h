@@ -0,0 +1,83 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * SearchServer: Answers queries sent by clients over a Unix domain socket
+ *  (see xs --serve and xs --connect). Every connection is served by a thread
+ *  of its own that calls the handler with the query. What the handler writes
+ *  to its output streams is sent to the client while the query is answered,
+ *  so results arrive as soon as they are found.
+ *  Messages in both directions consist of a type byte, the size of the
+ *  payload (uint32, native byte order) and the payload. A query is sent as
+ *  one 'c' message (working directory of the client), one 't' message ("1"
+ *  if the output of the client is a terminal) and one 'a' message per
+ *  argument, terminated by a 'q' message. The answer consists of 'o'
+ *  (output) and 'e' (error output) messages, terminated by an 'x' message
+ *  holding the exit status.
+ */
+class SearchServer {
+ public:
+  struct Query {
+    std::vector<std::string> args;
+    std::string cwd;
+    bool tty{false};
+  };
+
+  /// answer a query by writing to out and err, return the exit status
+  typedef std::function<int(const Query& query, std::ostream& out,
+                            std::ostream& err)>
+      handler;
+
+  /**
+   * Listen on socket_path, which only the owner of the process may connect
+   *  to. A stale socket file (no server accepting connections) is replaced.
+   * @throws std::system_error if the socket cannot be created or another
+   *  server listens on socket_path
+   */
+  SearchServer(std::string socket_path, handler handler);
+  /// closes and removes the socket
+  ~SearchServer();
+
+  SearchServer(const SearchServer&) = delete;
+  SearchServer& operator=(const SearchServer&) = delete;
+
+  /// accept connections until stop() is called, then wait for the queries
+  ///  being answered
+  void run();
+  /// stop accepting connections (run() returns)
+  void stop();
+
+  /**
+   * Send query to the server listening on socket_path and write its answer to
+   *  out and err.
+   * @return exit status sent by the server
+   * @throws std::system_error if the server cannot be reached or the
+   *  connection is lost
+   */
+  static int query(const std::string& socket_path, const Query& query,
+                   std::ostream& out, std::ostream& err);
+
+ private:
+  /// read the query of the client connected to fd and answer it
+  void answer(int fd);
+
+  std::string _socket_path;
+  handler _handler;
+  int _fd{-1};
+
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  /// number of queries being answered
+  size_t _active{0};
+  bool _stopped{false};
+};
\ No newline at end of file
@@ -0,0 +1,255 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Sequencer: Passes values that are published by several threads in any order
+ *  to a consumer in the order of their ids (0, 1, 2, ...). The consumer runs on
+ *  a dedicated writer thread: publishing threads neither wait for each other
+ *  nor for slow output. A value is moved into a ring of capacity slots indexed
+ *  by its id without locking. Only a thread whose id is capacity or more ahead
+ *  of the next id to be consumed waits for the writer, which bounds the memory
+ *  used by results that are not written yet. If max_bytes is set, a thread
+ *  also waits while the values pending exceed max_bytes in total (except for
+ *  the value the writer waits for, so the sequence always proceeds).
+ *  stats() reports the queue depth and how often the producers and the writer
+ *  had to wait: many producer waits mean that the output is the bottleneck.
+ */
+template <typename T>
+class Sequencer {
+ public:
+  struct Stats {
+    /// values published but not consumed yet
+    uint64_t depth{0};
+    /// maximum depth seen by publish()
+    uint64_t max_depth{0};
+    /// bytes of the values published but not consumed yet
+    uint64_t bytes{0};
+    /// maximum number of bytes pending seen by publish()
+    uint64_t max_bytes{0};
+    /// number of publish() calls that waited for a free slot (or memory)
+    uint64_t producer_waits{0};
+    /// number of times the writer waited for the next value
+    uint64_t writer_waits{0};
+  };
+
+  /**
+   * @param capacity: number of slots of the ring (at least 1)
+   * @param consume: called as consume(id, value) by the writer thread for all
+   *  ids in order
+   * @param max_bytes: maximum number of bytes pending (0: unlimited), see
+   *  publish()
+   */
+  Sequencer(size_t capacity, std::function<void(uint64_t, T)> consume,
+            size_t max_bytes = 0)
+      : _slots(capacity < 1 ? 1 : capacity),
+        _consume(std::move(consume)),
+        _max_bytes(max_bytes),
+        _writer([this] { run(); }) {}
+
+  Sequencer(const Sequencer&) = delete;
+  Sequencer& operator=(const Sequencer&) = delete;
+
+  ~Sequencer() {
+    try {
+      close();
+    } catch (...) {
+      // errors of the consumer are only reported by an explicit close()
+    }
+  }
+
+  /**
+   * Publish the value with the given id. Blocks only while the ring has no
+   *  free slot for id or while adding bytes would exceed max_bytes. Values
+   *  published after close() or abort() are dropped.
+   *
+   * @param bytes: memory held by value (accounted until it was consumed)
+   */
+  void publish(uint64_t id, T value, size_t bytes = 0) {
+    if (stopped()) {
+      return;
+    }
+    if (!reserve(id, bytes)) {
+      _producer_waits.fetch_add(1, std::memory_order_relaxed);
+      while (true) {
+        uint64_t space = _space.load(std::memory_order_acquire);
+        if (stopped()) {
+          return;
+        }
+        if (reserve(id, bytes)) {
+          break;
+        }
+        _space.wait(space, std::memory_order_acquire);
+      }
+    }
+    Slot& slot = _slots[id % _slots.size()];
+    slot.value = std::move(value);
+    slot.bytes = bytes;
+    slot.ready.store(id + 1, std::memory_order_release);
+    uint64_t count = _count.fetch_add(1, std::memory_order_acq_rel) + 1;
+    update_max(&_max_depth, count - _next.load(std::memory_order_relaxed));
+    update_max(&_max_pending_bytes, _bytes.load(std::memory_order_relaxed));
+    _published.fetch_add(1, std::memory_order_release);
+    _published.notify_one();
+  }
+
+  /// wait until all values published so far were consumed
+  void flush() const {
+    uint64_t count = _count.load(std::memory_order_acquire);
+    while (true) {
+      uint64_t space = _space.load(std::memory_order_acquire);
+      if (_next.load(std::memory_order_acquire) >= count || stopped()) {
+        return;
+      }
+      _space.wait(space, std::memory_order_acquire);
+    }
+  }
+
+  /**
+   * Stop accepting values because some ids will never be published (e.g. a
+   *  producer failed): later values are dropped and producers waiting for a
+   *  free slot (or memory) as well as flush() return. The values published
+   *  so far are consumed up to the first missing id.
+   */
+  void abort() {
+    _aborted.store(true, std::memory_order_release);
+    _space.fetch_add(1, std::memory_order_release);
+    _space.notify_all();
+  }
+
+  /**
+   * Consume the remaining values and stop the writer thread. Values missing
+   *  in the sequence (e.g. ids of failed producers) end the consumption.
+   *  Rethrows the first exception thrown by the consumer.
+   */
+  void close() {
+    if (!_closed.exchange(true, std::memory_order_acq_rel)) {
+      _published.fetch_add(1, std::memory_order_release);
+      _published.notify_one();
+      _writer.join();
+      // wake producers still waiting for a free slot
+      _space.fetch_add(1, std::memory_order_release);
+      _space.notify_all();
+    }
+    if (_error != nullptr) {
+      std::rethrow_exception(std::exchange(_error, nullptr));
+    }
+  }
+
+  [[nodiscard]] Stats stats() const {
+    uint64_t next = _next.load(std::memory_order_acquire);
+    return {_count.load(std::memory_order_acquire) - next,
+            _max_depth.load(std::memory_order_relaxed),
+            _bytes.load(std::memory_order_acquire),
+            _max_pending_bytes.load(std::memory_order_relaxed),
+            _producer_waits.load(std::memory_order_relaxed),
+            _writer_waits.load(std::memory_order_relaxed)};
+  }
+
+ private:
+  [[nodiscard]] bool stopped() const {
+    return _closed.load(std::memory_order_acquire) ||
+           _aborted.load(std::memory_order_acquire);
+  }
+
+  /// reserve bytes for id if its slot is free and the memory limit is kept
+  ///  (the limit is ignored for the id the writer waits for)
+  bool reserve(uint64_t id, size_t bytes) {
+    uint64_t next = _next.load(std::memory_order_acquire);
+    if (id >= next + _slots.size()) {
+      return false;
+    }
+    if (_max_bytes == 0 || id == next) {
+      _bytes.fetch_add(bytes, std::memory_order_acq_rel);
+      return true;
+    }
+    uint64_t pending = _bytes.load(std::memory_order_acquire);
+    while (pending + bytes <= _max_bytes) {
+      if (_bytes.compare_exchange_weak(pending, pending + bytes,
+                                       std::memory_order_acq_rel)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static void update_max(std::atomic<uint64_t>* max, uint64_t value) {
+    uint64_t current = max->load(std::memory_order_relaxed);
+    while (value > current &&
+           !max->compare_exchange_weak(current, value,
+                                       std::memory_order_relaxed)) {
+    }
+  }
+
+  void run() {
+    uint64_t next = 0;
+    while (true) {
+      uint64_t published = _published.load(std::memory_order_acquire);
+      Slot& slot = _slots[next % _slots.size()];
+      if (slot.ready.load(std::memory_order_acquire) != next + 1) {
+        if (_closed.load(std::memory_order_acquire)) {
+          break;
+        }
+        _writer_waits.fetch_add(1, std::memory_order_relaxed);
+        _published.wait(published, std::memory_order_acquire);
+        continue;
+      }
+      T value = std::move(*slot.value);
+      slot.value.reset();
+      size_t bytes = slot.bytes;
+      if (_error == nullptr) {
+        try {
+          _consume(next, std::move(value));
+        } catch (...) {
+          // later values are dropped, producers are not blocked
+          _error = std::current_exception();
+        }
+      }
+      next++;
+      _bytes.fetch_sub(bytes, std::memory_order_acq_rel);
+      _next.store(next, std::memory_order_release);
+      _space.fetch_add(1, std::memory_order_release);
+      _space.notify_all();
+    }
+  }
+
+  struct alignas(64) Slot {
+    /// id + 1 of the value stored in the slot (0: empty)
+    std::atomic<uint64_t> ready{0};
+    std::optional<T> value;
+    size_t bytes{0};
+  };
+
+  std::vector<Slot> _slots;
+  std::function<void(uint64_t, T)> _consume;
+  size_t _max_bytes;
+  /// id of the next value to be consumed
+  std::atomic<uint64_t> _next{0};
+  /// number of values published
+  std::atomic<uint64_t> _count{0};
+  /// changed whenever a value was published (wakes the writer)
+  std::atomic<uint64_t> _published{0};
+  /// changed whenever a value was consumed (wakes waiting producers)
+  mutable std::atomic<uint64_t> _space{0};
+  std::atomic<bool> _closed{false};
+  std::atomic<bool> _aborted{false};
+  /// bytes of the values published but not consumed yet
+  std::atomic<uint64_t> _bytes{0};
+  std::atomic<uint64_t> _max_depth{0};
+  std::atomic<uint64_t> _max_pending_bytes{0};
+  std::atomic<uint64_t> _producer_waits{0};
+  std::atomic<uint64_t> _writer_waits{0};
+  /// written by the writer thread, read once it was joined
+  std::exception_ptr _error;
+  std::thread _writer;
+};
\ No newline at end of file
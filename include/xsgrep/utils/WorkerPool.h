@@ -0,0 +1,45 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * WorkerPool: A fixed number of long-lived threads that run submitted tasks in
+ *  FIFO order. Threads are started once (on construction) and joined on
+ *  destruction, so repeated searches do not pay thread startup.
+ *  Tasks must not wait for other tasks of the same pool.
+ */
+class WorkerPool {
+ public:
+  /// @param num_threads: number of threads (<= 0: hardware concurrency)
+  explicit WorkerPool(int num_threads = 0);
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  ~WorkerPool();
+
+  /// the pool shared by all searches of the process (created on first use)
+  static WorkerPool& global();
+
+  /// run task on one of the threads of the pool
+  void submit(std::function<void()> task);
+
+  [[nodiscard]] size_t size() const;
+
+ private:
+  void main();
+
+  std::vector<std::thread> _threads;
+  std::deque<std::function<void()>> _tasks;
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  bool _stop{false};
+};
\ No newline at end of file
@@ -0,0 +1,35 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Fraction of the pages of the first size bytes of fd that are in the page
+ *  cache (mincore() on a mapping of the file, no page is faulted in). Large
+ *  files are sampled: only max_samples windows spread evenly over the file
+ *  are probed.
+ *
+ * @return residency in [0, 1] (0 if it cannot be determined)
+ */
+double page_cache_residency(int fd, uint64_t size, size_t max_samples = 64);
+
+/**
+ * Decide how fd is read: memory mapping wins if the data are in the page
+ *  cache (no copies, no system calls per block), read() with read ahead wins
+ *  if they have to come from disk (page faults are served one by one) and for
+ *  small files (mapping costs more than copying).
+ *
+ * @return the file should be memory mapped rather than read
+ */
+bool prefer_mmap(int fd, uint64_t size);
+/// prefer_mmap() for the file at path (false if it cannot be opened)
+bool prefer_mmap(const std::string& path);
+
+/// hint that fd is read sequentially (larger read ahead)
+void advise_sequential(int fd);
+/// hint that [offset, offset + size) of fd is read soon (starts read ahead)
+void advise_will_need(int fd, uint64_t offset, uint64_t size);
\ No newline at end of file
@@ -0,0 +1,26 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * Extract literals required by a regular expression (RE2 syntax): every match
+ *  of pattern contains at least one of the returned literals. Lines without
+ *  any of them cannot match, so they do not need to be passed to RE2.
+ *  The analysis is conservative: an empty vector is returned if the pattern
+ *  uses constructs that are not understood (flags, \x escapes, ...) or if no
+ *  literal set of at least two bytes per literal is found.
+ *
+ * @param pattern: regular expression
+ * @param ignore_case: the search is case-insensitive (ASCII): the literals
+ *  are returned in lower case
+ * @param exact: set to true if the pattern matches exactly the returned
+ *  literals (every occurrence of a literal is a match), false otherwise
+ * @return required literals (at most 64)
+ */
+std::vector<std::string> required_literals(const std::string& pattern,
+                                           bool ignore_case,
+                                           bool* exact = nullptr);
\ No newline at end of file
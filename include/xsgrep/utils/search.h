@@ -0,0 +1,37 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Case-insensitive (ASCII) search for needle within haystack.
+ *  The haystack is neither copied nor modified: candidates are found by
+ *  comparing blocks of the haystack against both cases of the first and the
+ *  last byte of needle (SIMD) and are verified afterwards.
+ *
+ * @param haystack: data that are searched
+ * @param haystack_size: number of bytes of haystack
+ * @param needle: lower case pattern
+ * @param needle_size: number of bytes of needle
+ * @return pointer to the first occurrence of needle in haystack or nullptr
+ */
+const char* find_icase(const char* haystack, size_t haystack_size,
+                       const char* needle, size_t needle_size);
+
+/**
+ * Count the new line characters of data (SIMD). Used for line numbers: only
+ *  the bytes between the matches and the total of a chunk need to be counted.
+ *
+ * @param data: data that are searched
+ * @param size: number of bytes of data
+ * @return number of '\n' within [data, data + size)
+ */
+uint64_t count_new_lines(const char* data, size_t size);
+
+/// ASCII lower case of c
+inline char to_lower_ascii(char c) {
+  return (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : c;
+}
@@ -5,8 +5,74 @@
 
 #include <xsearch/xsearch.h>
 
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../utils/NgramFilter.h"
+#include "../utils/Sequencer.h"
+
 typedef std::pair<xs::ChunkMetaData, xs::DataChunk> preprocess_result;
 
+/**
+ * ProcessedPrefix: The part of a file that was preprocessed already, as
+ *  described by its metafile (xspp --append).
+ */
+struct ProcessedPrefix {
+  /**
+   * Read the metafile of the file at source_path. If the last chunk does not
+   *  end with a new line (the file was processed while a line was written),
+   *  it is dropped: it is processed again together with the new data.
+   * @throws std::runtime_error if source_path is shorter than the data
+   *  described by the metafile (e.g. the file was truncated or rotated)
+   */
+  static ProcessedPrefix read(const std::string& meta_file_path,
+                              const std::string& source_path);
+
+  xs::CompressionType compression_type{xs::CompressionType::NONE};
+  /// metadata of the chunks that are kept (in order)
+  std::vector<xs::ChunkMetaData> chunks;
+  /// number of bytes of the file that were processed
+  uint64_t original_size{0};
+  /// end of the data of all chunks within the output file
+  uint64_t actual_size{0};
+  /// chunk index of the first new chunk
+  uint64_t next_chunk_index{0};
+};
+
+/**
+ * TailReader: Reads a file from offset on in chunks of min_size bytes that
+ *  are extended to the end of their last line. The incomplete last line of
+ *  the file (that is still written to) is not read. The chunk indices of the
+ *  metadata start at first_chunk_index.
+ */
+class TailReader : public xs::task::base::DataProvider<xs::DataChunk> {
+ public:
+  /// @throws std::system_error if the file cannot be read
+  TailReader(const std::string& path, uint64_t offset,
+             uint64_t first_chunk_index, size_t min_size);
+  ~TailReader() override;
+
+  TailReader(const TailReader&) = delete;
+  TailReader& operator=(const TailReader&) = delete;
+
+  std::optional<std::pair<xs::DataChunk, xs::chunk_index>> getNextData()
+      override;
+
+ private:
+  std::mutex _mutex;
+  int _fd;
+  uint64_t _offset;
+  /// end of the last complete line of the file
+  uint64_t _end{0};
+  uint64_t _chunk_index;
+  size_t _min_size;
+  xs::chunk_index _id{0};
+};
+
 class MetaDataCreator
     : public xs::task::base::ReturnProcessor<xs::DataChunk, preprocess_result> {
  public:
@@ -14,22 +80,99 @@ class MetaDataCreator
   preprocess_result process(const xs::DataChunk* data) const override;
 };
 
+/**
+ * NgramFilterTable: NgramFilters of the chunks by chunk index. Filled by the
+ *  NgramIndexer, emptied by the DataWriter. Thread safe.
+ */
+class NgramFilterTable {
+ public:
+  void insert(uint64_t chunk_index, NgramFilter filter);
+  std::optional<NgramFilter> extract(uint64_t chunk_index);
+
+ private:
+  std::mutex _mutex;
+  std::unordered_map<uint64_t, NgramFilter> _filters;
+};
+
+/**
+ * NgramIndexer: Computes the NgramFilter of every chunk. Must run before the
+ *  chunks are compressed.
+ */
+class NgramIndexer : public xs::task::base::InplaceProcessor<xs::DataChunk> {
+ public:
+  NgramIndexer(size_t num_bytes, std::shared_ptr<NgramFilterTable> filters);
+  void process(xs::DataChunk* data) const override;
+
+ private:
+  size_t _num_bytes;
+  std::shared_ptr<NgramFilterTable> _filters;
+};
+
+/**
+ * DataWriter: Writes the preprocessed chunks and their metafile.
+ *  The data of a chunk are written by the thread that compressed it (pwrite)
+ *  at an offset of the output file that is reserved as soon as the compressed
+ *  size is known: compressing threads neither wait for each other nor hold
+ *  finished chunks in memory. Compressed chunks are stored in the order they
+ *  were compressed, uncompressed ones at their original position (the output
+ *  is a copy of the input). The metafile records where (actual_offset) and is
+ *  written in chunk order by a writer thread. N-gram filters are written as
+ *  they come (the filter file is indexed by original offset). In append
+ *  mode, the chunks of the processed prefix are kept and the new ones are
+ *  written after them.
+ */
 class DataWriter : public xs::result::base::Result<preprocess_result> {
  public:
-  explicit DataWriter(const std::string& meta_file_path,
-                      xs::CompressionType compression_type,
-                      std::unique_ptr<std::ostream> output_stream);
+  /**
+   * @param output_file_path: file the chunks are written to (if empty, no
+   *  data are written and the metafile refers to the input file)
+   * @param ngram_filters: filters computed by an NgramIndexer, written to
+   *  ngram_stream after its header (none if nullptr)
+   * @param prefix: chunks processed before (append mode), written to the
+   *  metafile first. The output file is extended instead of overwritten
+   * @throws std::system_error if the output file cannot be opened
+   */
+  explicit DataWriter(
+      const std::string& meta_file_path, xs::CompressionType compression_type,
+      const std::string& output_file_path,
+      std::shared_ptr<NgramFilterTable> ngram_filters = nullptr,
+      std::unique_ptr<std::ostream> ngram_stream = nullptr,
+      const ProcessedPrefix& prefix = {});
+  ~DataWriter() override;
 
+  DataWriter(const DataWriter&) = delete;
+  DataWriter& operator=(const DataWriter&) = delete;
+
+  /**
+   * Write the data of the chunk and pass its metadata to the writer thread.
+   *  Blocks only if the metadata of max_pending chunks wait for a chunk with
+   *  a lower id that is not finished yet.
+   */
   void add(preprocess_result data, uint64_t id) override;
 
   /// Must be implemented since it is pure virtual inherited...
   constexpr size_t size() const override { return 0; }
 
+  /// Write the metadata of all chunks added and stop the writer thread.
+  void finish();
+
+  /// maximum number of chunks whose metadata wait to be written
+  static constexpr size_t max_pending = 4096;
+
  private:
   void add(preprocess_result data) override;
 
-  std::unordered_map<uint64_t, preprocess_result> _buffer;
-  uint64_t _current_index = 0;
   xs::MetaFile _meta_file;
-  std::unique_ptr<std::ostream> _output_stream;
+  xs::CompressionType _compression_type;
+  /// where the data of the processed prefix end (input and output file)
+  uint64_t _prefix_original_size;
+  uint64_t _prefix_actual_size;
+  int _output_fd{-1};
+  /// end of the data reserved in the output file
+  std::atomic<uint64_t> _output_size{0};
+  std::shared_ptr<NgramFilterTable> _ngram_filters;
+  std::mutex _ngram_mutex;
+  std::unique_ptr<std::ostream> _ngram_stream;
+  /// writes the metadata in chunk order, constructed last
+  Sequencer<xs::ChunkMetaData> _sequencer;
 };
\ No newline at end of file
@@ -0,0 +1,116 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+// Compare the throughput (bytes/s) of writing grep results field by field
+//  through std::ostream (the former GrepOutput implementation) with the
+//  OutputSink used by GrepOutput now. The results are generated synthetically
+//  and resemble a high-hit-rate search with line numbers and byte offsets.
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <xsgrep/grep.h>
+#include <xsgrep/utils/OutputSink.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+// _____________________________________________________________________________
+std::vector<Grep::PartialResult> create_results(size_t num_chunks,
+                                                size_t matches_per_chunk) {
+  std::vector<Grep::PartialResult> results(num_chunks);
+  std::string line =
+      "2023-06-01 12:00:00 INFO [worker-3] Sherlock Holmes took his bottle "
+      "from the corner of the mantel-piece";
+  int64_t line_number = 1;
+  int64_t byte_offset = 0;
+  for (auto& res : results) {
+    res.file_name = "data.txt";
+    res.buffer.reserve(matches_per_chunk * line.size());
+    for (size_t i = 0; i < matches_per_chunk; ++i) {
+      res.matches.push_back(
+          {byte_offset, line_number, res.buffer.size(), line.size(), 0, 0});
+      res.buffer.append(line);
+      byte_offset += static_cast<int64_t>(line.size() + 1);
+      line_number += 2;
+    }
+  }
+  return results;
+}
+
+// _____________________________________________________________________________
+void write_ostream(const std::vector<Grep::PartialResult>& results,
+                   std::ostream& out) {
+  for (const auto& res : results) {
+    for (const auto& r : res.matches) {
+      // formerly, each match was an owning std::string
+      std::string match(res.str(r));
+      out << res.file_name << ':' << r.line_number << ':' << r.byte_position
+          << ':' << match << '\n';
+    }
+  }
+  out.flush();
+}
+
+// _____________________________________________________________________________
+uint64_t write_sink(const std::vector<Grep::PartialResult>& results, int fd) {
+  OutputSink sink(fd);
+  std::string formatted;
+  for (const auto& res : results) {
+    formatted.clear();
+    for (const auto& r : res.matches) {
+      formatted.append(res.file_name).push_back(':');
+      append_int(&formatted, r.line_number);
+      formatted.push_back(':');
+      append_int(&formatted, r.byte_position);
+      formatted.push_back(':');
+      formatted.append(res.str(r)).push_back('\n');
+    }
+    sink.write(formatted);
+  }
+  sink.flush();
+  return sink.bytes_written();
+}
+
+// _____________________________________________________________________________
+int main(int argc, char** argv) {
+  if (argc > 3) {
+    std::cerr << "Usage: ./output_bench [<output_file> [<num_chunks>]]\n";
+    return 1;
+  }
+  std::string file = argc > 1 ? std::string(argv[1]) : "/dev/null";
+  size_t num_chunks = argc > 2 ? std::stoul(argv[2]) : 200;
+  auto results = create_results(num_chunks, 10000);
+
+  auto report = [](const std::string& name, uint64_t num_bytes,
+                   std::chrono::duration<double> time) {
+    std::cout << name << ": " << num_bytes << " bytes in " << time.count()
+              << " s (" << static_cast<double>(num_bytes) / time.count() / 1e6
+              << " MB/s)" << std::endl;
+  };
+
+  // both variants produce the exact same output
+  uint64_t num_bytes;
+  {
+    int fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      std::cerr << "Could not open '" << file << "'.\n";
+      return 2;
+    }
+    auto start = std::chrono::steady_clock::now();
+    num_bytes = write_sink(results, fd);
+    std::chrono::duration<double> time =
+        std::chrono::steady_clock::now() - start;
+    ::close(fd);
+    report("OutputSink     ", num_bytes, time);
+  }
+  {
+    std::ofstream out(file);
+    auto start = std::chrono::steady_clock::now();
+    write_ostream(results, out);
+    std::chrono::duration<double> time =
+        std::chrono::steady_clock::now() - start;
+    report("std::ostream <<", num_bytes, time);
+  }
+  return 0;
+}
@@ -1,35 +1,28 @@
 // Copyright 2023, Leon Freist
 // Author: Leon Freist <freist@informatik.uni-freiburg.de>
 
+#include <sys/stat.h>
+#include <unistd.h>
 #include <xsearch/utils/string_utils.h>
 #include <xsgrep/grep.h>
+#include <xsgrep/tasks/Cancellable.h>
+#include <xsgrep/tasks/GrepDecompressor.h>
 #include <xsgrep/tasks/GrepReader.h>
 #include <xsgrep/tasks/GrepResult.h>
 #include <xsgrep/tasks/GrepSearcher.h>
+#include <xsgrep/tasks/PoolExecutor.h>
+#include <xsgrep/tasks/StreamReader.h>
+#include <xsgrep/tasks/UringReader.h>
+#include <xsgrep/utils/DirectoryWalker.h>
+#include <xsgrep/utils/NgramFilter.h>
+#include <xsgrep/utils/page_cache.h>
+#include <xsgrep/utils/regex_literals.h>
+
+#include <algorithm>
+#include <iostream>
+#include <system_error>
 
 // ===== Helper functions ======================================================
-/**
- * Helper function that recursively traverses directories and returns a list of
- *  all files.
- * @param in_path
- * @param files
- * @param depth
- */
-void get_files_recursive(const std::filesystem::path& in_path,
-                         std::vector<std::string>* files, int depth) {
-  if (std::filesystem::is_regular_file(in_path)) {
-    files->push_back(std::filesystem::path(in_path));
-  }
-  if (depth == 0) {
-    return;
-  }
-  if (std::filesystem::is_directory(in_path)) {
-    for (auto& obj : std::filesystem::directory_iterator(in_path)) {
-      get_files_recursive(obj, files, depth - 1);
-    }
-  }
-}
-
 /**
  * Get a vector of all files within a directory
  * @param in_path start directory
@@ -41,8 +34,18 @@ std::vector<std::string> get_files(const std::filesystem::path& in_path,
   if (in_path.empty() || in_path == "-") {
     return {"-"};
   }
+  if (!std::filesystem::exists(in_path)) {
+    return {};
+  }
   std::vector<std::string> files;
-  get_files_recursive(in_path, &files, max_depth);
+  DirectoryWalker walker(in_path, max_depth);
+  while (true) {
+    auto file = walker.next();
+    if (!file.has_value()) {
+      break;
+    }
+    files.push_back(std::move(*file));
+  }
   return files;
 }
 // =============================================================================
@@ -63,66 +66,173 @@ Grep::Grep(Options options) : _options(std::move(options)) {
 }
 
 std::vector<std::pair<std::string, uint64_t>> Grep::count() {
-  std::vector<std::pair<std::string, uint64_t>> result;
-  for (const auto& file : get_files(_options.file)) {
-    auto executor =
-        xs::Executor<xs::DataChunk, xs::result::base::CountResult, uint64_t>(
-            _options.num_threads, get_reader(file), get_processors(),
-            std::make_unique<xs::task::searcher::LineCounter>(
-                _options.pattern, use_regex(), _options.ignore_case,
-                _options.locale == Grep::Locale::UTF_8),
-            std::make_unique<xs::result::base::CountResult>());
+  if (!(_options.file.empty() || _options.file == "-" ||
+        std::filesystem::exists(_options.file))) {
+    return {};
+  }
+  bool directory = std::filesystem::is_directory(_options.file);
+  auto patterns = search_patterns();
+  if (directory || _options.max_count >= 0 || patterns.size() != 1 ||
+      _options.invert_match || boundary() != Grep::Boundary::NONE) {
+    // all files of the directory are counted within one pass: files are
+    //  packed/split into chunks by the GrepReader
+    std::shared_ptr<Cancellation> cancellation;
+    if (_options.max_count >= 0) {
+      cancellation = std::make_shared<Cancellation>(!directory);
+    }
+    auto reader = get_reader(_options.file, cancellation);
+    auto processors = get_processors(reader, cancellation);
+    auto searcher = get_searcher(reader);
+    searcher->set_count_only(true);
+    searcher->set_cancellation(cancellation);
+    PoolExecutor<xs::DataChunk, GrepCountContainer, Grep::PartialResult>
+        executor(_options.num_threads, std::move(reader),
+                 std::move(processors), std::move(searcher),
+                 std::make_unique<GrepCountContainer>(_options.max_count,
+                                                      cancellation));
     executor.join();
-    result.emplace_back(file, executor.getResult()->size());
+    auto counts = executor.getResult()->copyResultSafe();
+    if (directory) {
+      return counts;
+    }
+    return {{_options.file.empty() ? "-" : _options.file,
+             counts.empty() ? 0 : counts.front().second}};
   }
-  return result;
+  auto reader = get_reader(_options.file);
+  auto processors = get_processors(reader);
+  PoolExecutor<xs::DataChunk, xs::result::base::CountResult, uint64_t>
+      executor(_options.num_threads, std::move(reader), std::move(processors),
+               std::make_unique<xs::task::searcher::LineCounter>(
+                   patterns.front(), use_regex(), _options.ignore_case,
+                   _options.locale == Grep::Locale::UTF_8),
+               std::make_unique<xs::result::base::CountResult>());
+  executor.join();
+  return {{_options.file.empty() ? "-" : _options.file,
+           executor.getResult()->size()}};
 }
 
 std::map<std::string, std::vector<Grep::Match>> Grep::search() {
-  auto executor =
-      xs::Executor<xs::DataChunk, GrepContainer,
-                   std::pair<std::string, std::vector<Grep::Match>>>(
-          _options.num_threads, get_reader(_options.file), get_processors(),
-          std::make_unique<GrepSearcher>(_options.pattern, _options.byte_offset,
-                                         _options.line_number,
-                                         _options.only_matching, use_regex(),
-                                         _options.ignore_case, _options.locale),
-          std::make_unique<GrepContainer>());
+  std::map<std::string, std::vector<Grep::Match>> results;
+  std::vector<Grep::Match>* file_matches = nullptr;
+  std::string_view file_name;
+  visit([&](const std::vector<MatchView>& matches) {
+    for (const auto& match : matches) {
+      if (file_matches == nullptr || match.file_name != file_name) {
+        auto entry = results.try_emplace(std::string(match.file_name)).first;
+        file_matches = &entry->second;
+        // the view is only valid during the call: refer to the key instead
+        file_name = entry->first;
+      }
+      file_matches->push_back({match.byte_position, match.line_number,
+                               std::string(match.match)});
+    }
+    return true;
+  });
+  return results;
+}
+
+size_t Grep::visit(const visitor& f) {
+  if (_options.max_count == 0) {
+    return 0;
+  }
+  auto cancellation = std::make_shared<Cancellation>(
+      !std::filesystem::is_directory(_options.file));
+  auto reader = get_reader(_options.file, cancellation);
+  auto processors = get_processors(reader, cancellation);
+  auto searcher = get_searcher(reader);
+  searcher->set_highlight(false);
+  searcher->set_cancellation(cancellation);
+  PoolExecutor<xs::DataChunk, GrepVisitor, Grep::PartialResult> executor(
+      _options.num_threads, std::move(reader), std::move(processors),
+      std::move(searcher),
+      std::make_unique<GrepVisitor>(f, _options.max_count,
+                                    _options.max_memory, cancellation));
   executor.join();
-  return executor.getResult()->copyResultSafe();
+  executor.getResult()->finish();
+  return executor.getResult()->size();
 }
 
-void Grep::write(std::ostream* stream) {
-  if (_options.count) {
+bool Grep::write(std::ostream* stream) {
+  bool list_files = _options.quiet || _options.files_with_matches ||
+                    _options.files_without_match;
+  if (_options.max_count == 0 && !list_files) {
+    // nothing is selected
+    return false;
+  }
+  if (_options.invert_match && _options.only_matching && !list_files &&
+      !_options.quiet) {
+    // the selected lines contain no match: nothing is written, only the exit
+    //  status is decided (like grep -v -o)
+    Grep grep(*this);
+    grep.set_quiet(true);
+    return grep.write(stream);
+  }
+  if (_options.count && !list_files) {
+    bool selected = false;
     for (const auto& res : count()) {
+      selected = selected || res.second > 0;
       if (_options.print_file_path) {
+        auto name =
+            GrepOutput::relative_name(res.first, _options.display_root);
         if (_options.color == Grep::Color::ON) {
-          *stream << MAGENTA << res.first << CYAN << ':';
+          *stream << MAGENTA << name << CYAN << ':';
         } else {
-          *stream << res.first << ':';
+          *stream << name << ':';
         }
       }
       *stream << res.second << '\n';
     }
-  } else {
-    if (!(_options.file.empty() || _options.file == "-" ||
-          std::filesystem::is_regular_file(_options.file) ||
-          std::filesystem::is_directory(_options.file))) {
-      std::cerr << _options.file << ": No such file or directory\n";
-      return;
-    }
-    auto executor =
-        xs::Executor<xs::DataChunk, GrepOutput,
-                     std::pair<std::string, std::vector<Grep::Match>>,
-                     Grep::Options, std::ostream&>(
-            _options.num_threads, get_reader(_options.file), get_processors(),
-            std::make_unique<GrepSearcher>(
-                _options.pattern, _options.byte_offset, _options.line_number,
-                _options.only_matching, use_regex(), _options.ignore_case,
-                _options.locale),
-            std::make_unique<GrepOutput>(_options, *stream));
-    executor.join();
+    return selected;
+  }
+  if (!(_options.file.empty() || _options.file == "-" ||
+        std::filesystem::is_regular_file(_options.file) ||
+        std::filesystem::is_directory(_options.file))) {
+    _errors->report(_options.file, "No such file or directory");
+    return false;
   }
+  // a limited search is cancelled by the output once it is decided
+  std::shared_ptr<Cancellation> cancellation;
+  if (limited()) {
+    cancellation = std::make_shared<Cancellation>(
+        !std::filesystem::is_directory(_options.file));
+  }
+  auto reader = get_reader(_options.file, cancellation);
+  auto processors = get_processors(reader, cancellation);
+  auto searcher = get_searcher(reader);
+  searcher->set_cancellation(cancellation);
+  // only the number of matches per file is of interest
+  searcher->set_count_only(list_files);
+  if (_options.invert_match && !limited() && !_options.print_file_path) {
+    // no prefixes and no limits: runs of selected lines are written as one
+    //  slice each
+    searcher->set_invert_match(true, true);
+  }
+  if (!list_files && !_options.only_matching &&
+      (_options.before_context >= 0 || _options.after_context >= 0)) {
+    searcher->set_context(std::max<int64_t>(_options.before_context, 0),
+                          std::max<int64_t>(_options.after_context, 0));
+  }
+  auto options = _options;
+  if (dynamic_cast<StreamReader*>(reader.get()) != nullptr &&
+      isatty(STDOUT_FILENO)) {
+    // streamed input watched on a terminal (e.g. tail -f): no delays
+    options.line_buffered = true;
+  }
+  PoolExecutor<xs::DataChunk, GrepOutput, Grep::PartialResult> executor(
+      _options.num_threads, std::move(reader), std::move(processors),
+      std::move(searcher),
+      std::make_unique<GrepOutput>(options, *stream, cancellation));
+  executor.join();
+  executor.getResult()->finish();
+#ifdef BENCHMARK
+  // many producer waits: the output is the bottleneck of the search
+  auto stats = executor.getResult()->stats();
+  std::cerr << "output queue: max depth " << stats.max_depth
+            << ", max bytes " << stats.max_bytes
+            << ", producer waits " << stats.producer_waits
+            << ", writer waits " << stats.writer_waits << std::endl;
+#endif
+  return executor.getResult()->size() > 0;
 }
 
 Grep& Grep::set_file(std::string file) {
@@ -143,6 +253,12 @@ Grep& Grep::set_pattern(std::string pattern) {
   return *this;
 }
 
+Grep& Grep::set_patterns(std::vector<std::string> patterns) {
+  _options.patterns = std::move(patterns);
+  _options.use_patterns = true;
+  return *this;
+}
+
 Grep& Grep::set_count_only(bool val) {
   _options.count = val;
   if (_options.count) {
@@ -185,6 +301,21 @@ Grep& Grep::set_only_matching(bool val) {
   return *this;
 }
 
+Grep& Grep::set_invert_match(bool val) {
+  _options.invert_match = val;
+  return *this;
+}
+
+Grep& Grep::set_word_regexp(bool val) {
+  _options.word_regexp = val;
+  return *this;
+}
+
+Grep& Grep::set_line_regexp(bool val) {
+  _options.line_regexp = val;
+  return *this;
+}
+
 Grep& Grep::set_ignore_case(bool val) {
   _options.ignore_case = val;
   return *this;
@@ -192,7 +323,11 @@ Grep& Grep::set_ignore_case(bool val) {
 
 Grep& Grep::set_locale(Locale locale) {
   if (locale == Grep::Locale::AUTO) {
-    _options.locale = xs::utils::str::is_ascii(_options.pattern)
+    auto patterns = search_patterns();
+    _options.locale = std::all_of(patterns.begin(), patterns.end(),
+                                  [](const std::string& pattern) {
+                                    return xs::utils::str::is_ascii(pattern);
+                                  })
                           ? Grep::Locale::ASCII
                           : Grep::Locale::UTF_8;
   } else {
@@ -207,7 +342,12 @@ Grep& Grep::set_print_file_path(bool val) {
 }
 
 Grep& Grep::set_use_mmap(bool val) {
-  _options.no_mmap = val;
+  _options.io = val ? Grep::IO::MMAP : Grep::IO::READ;
+  return *this;
+}
+
+Grep& Grep::set_io(IO io) {
+  _options.io = io;
   return *this;
 }
 
@@ -232,12 +372,83 @@ Grep& Grep::set_num_reader_threads(int val) {
   return *this;
 }
 
+Grep& Grep::set_meta_file_suffix(std::string suffix) {
+  _options.meta_file_suffix = std::move(suffix);
+  return *this;
+}
+
+Grep& Grep::set_max_count(int64_t val) {
+  _options.max_count = val < 0 ? -1 : val;
+  return *this;
+}
+
+Grep& Grep::set_quiet(bool val) {
+  _options.quiet = val;
+  return *this;
+}
+
+Grep& Grep::set_files_with_matches(bool val) {
+  _options.files_with_matches = val;
+  return *this;
+}
+
+Grep& Grep::set_files_without_match(bool val) {
+  _options.files_without_match = val;
+  return *this;
+}
+
+Grep& Grep::set_before_context(int64_t val) {
+  _options.before_context = val < 0 ? -1 : val;
+  return *this;
+}
+
+Grep& Grep::set_after_context(int64_t val) {
+  _options.after_context = val < 0 ? -1 : val;
+  return *this;
+}
+
+Grep& Grep::set_max_memory(size_t val) {
+  _options.max_memory = val;
+  return *this;
+}
+
+Grep& Grep::set_line_buffered(bool val) {
+  _options.line_buffered = val;
+  return *this;
+}
+
+Grep& Grep::set_io_uring_depth(int val) {
+  _options.io_uring_depth = val < 0 ? 0 : val;
+  return *this;
+}
+
+Grep& Grep::set_display_root(std::string root) {
+  _options.display_root = std::move(root);
+  return *this;
+}
+
+Grep& Grep::set_caches(std::shared_ptr<FileCache> file_cache,
+                       std::shared_ptr<SearcherCache> searcher_cache) {
+  _file_cache = std::move(file_cache);
+  _searcher_cache = std::move(searcher_cache);
+  return *this;
+}
+
+Grep& Grep::set_error_stream(std::ostream* stream) {
+  _errors = std::make_shared<ErrorLog>(stream);
+  return *this;
+}
+
 const std::string& Grep::file() const { return _options.file; }
 
 const std::string& Grep::meta_file() const { return _options.meta_file_path; }
 
 const std::string& Grep::pattern() const { return _options.pattern; }
 
+const std::vector<std::string>& Grep::patterns() const {
+  return _options.patterns;
+}
+
 bool Grep::count_only() const { return _options.count; }
 
 bool Grep::fixed_string() const { return _options.fixed_string; }
@@ -250,27 +461,65 @@ Grep::Color Grep::colored_output() const { return _options.color; }
 
 bool Grep::only_matching() const { return _options.only_matching; }
 
+bool Grep::invert_match() const { return _options.invert_match; }
+
+bool Grep::word_regexp() const { return _options.word_regexp; }
+
+bool Grep::line_regexp() const { return _options.line_regexp; }
+
 bool Grep::ignore_case() const { return _options.ignore_case; }
 
 Grep::Locale Grep::locale() const { return _options.locale; }
 
 bool Grep::print_file_path() const { return _options.print_file_path; }
 
-bool Grep::use_mmap() const { return _options.no_mmap; }
+bool Grep::use_mmap() const { return _options.io == Grep::IO::MMAP; }
+
+Grep::IO Grep::io() const { return _options.io; }
 
 int Grep::num_threads() const { return _options.num_threads; }
 
 int Grep::num_reader_threads() const { return _options.num_reader_threads; }
 
+const std::string& Grep::meta_file_suffix() const {
+  return _options.meta_file_suffix;
+}
+
+int64_t Grep::max_count() const { return _options.max_count; }
+
+bool Grep::quiet() const { return _options.quiet; }
+
+bool Grep::files_with_matches() const { return _options.files_with_matches; }
+
+bool Grep::files_without_match() const {
+  return _options.files_without_match;
+}
+
+int64_t Grep::before_context() const { return _options.before_context; }
+
+int64_t Grep::after_context() const { return _options.after_context; }
+
+size_t Grep::max_memory() const { return _options.max_memory; }
+
+bool Grep::line_buffered() const { return _options.line_buffered; }
+
+int Grep::io_uring_depth() const { return _options.io_uring_depth; }
+
+const std::string& Grep::display_root() const { return _options.display_root; }
+
+size_t Grep::errors() const { return _errors->count(); }
+
 // ----- private ---------------------------------------------------------------
-std::vector<Grep::base_processors> Grep::get_processors() const {
+std::vector<Grep::base_processors> Grep::get_processors(
+    const base_reader& reader,
+    const std::shared_ptr<Cancellation>& cancellation) const {
   std::vector<std::unique_ptr<xs::task::base::InplaceProcessor<xs::DataChunk>>>
       ret;
-  if (_options.meta_file_path.empty()) {
-    if (_options.line_number) {
-      ret.push_back(std::make_unique<xs::task::processor::NewLineSearcher>());
-    }
-  } else {
+  if (auto* grep_reader = dynamic_cast<GrepReader*>(reader.get())) {
+    // recursive search: preprocessed files are decompressed per chunk
+    ret.push_back(
+        std::make_unique<GrepDecompressor>(grep_reader->chunk_files()));
+  } else if (!_options.meta_file_path.empty()) {
     xs::MetaFile metaFile(_options.meta_file_path, std::ios::in);
     switch (metaFile.get_compression_type()) {
       case xs::CompressionType::LZ4:
@@ -284,39 +533,199 @@ std::vector<Grep::base_processors> Grep::get_processors() const {
         break;
     }
   }
+  if (cancellation != nullptr) {
+    for (auto& processor : ret) {
+      processor = std::make_unique<CancellableProcessor>(std::move(processor),
+                                                         cancellation);
+    }
+  }
   return ret;
 }
 
-Grep::base_reader Grep::get_reader(const std::string& file) {
-  if (std::filesystem::is_directory(_options.file)) {
-    return std::make_unique<GrepReader>(_options.file);
+Grep::base_reader Grep::get_reader(
+    const std::string& file,
+    const std::shared_ptr<Cancellation>& cancellation) {
+  auto grep_reader = [&] {
+    return std::make_unique<GrepReader>(
+        file, -1, _options.num_reader_threads, GrepReader::default_pack_size,
+        GrepReader::default_stripe_size, _errors);
+  };
+  if (std::filesystem::is_directory(file)) {
+    auto reader = grep_reader();
+    reader->set_use_mmap(_options.io == Grep::IO::MMAP);
+    reader->set_auto_mmap(_options.io == Grep::IO::AUTO);
+    reader->set_meta_file_suffix(_options.meta_file_suffix);
+    reader->set_ngram_literals(ngram_literals());
+    reader->set_cancellation(cancellation);
+    reader->set_file_cache(_file_cache);
+    return reader;
+  }
+  if (_file_cache != nullptr && !(file.empty() || file == "-")) {
+    // resident process: the file (and its metafile) are kept in the cache
+    auto reader = grep_reader();
+    reader->set_meta_file(_options.meta_file_path);
+    reader->set_ngram_literals(ngram_literals());
+    reader->set_cancellation(cancellation);
+    reader->set_file_cache(_file_cache);
+    return reader;
+  }
+  if (!_options.meta_file_path.empty() &&
+      std::filesystem::is_regular_file(_options.meta_file_path +
+                                       NgramFilter::file_suffix)) {
+    auto literals = ngram_literals();
+    if (!literals.empty()) {
+      // the x-search readers cannot skip chunks by their n-gram filters
+      auto reader = grep_reader();
+      reader->set_use_mmap(_options.io == Grep::IO::MMAP);
+      reader->set_auto_mmap(_options.io == Grep::IO::AUTO);
+      reader->set_meta_file(_options.meta_file_path);
+      reader->set_ngram_literals(std::move(literals));
+      reader->set_cancellation(cancellation);
+      return reader;
+    }
   }
   if (file.empty() || file == "-") {
-    return std::make_unique<xs::task::reader::FileBlockReader>("/dev/stdin");
+    struct stat st {};
+    if (::fstat(STDIN_FILENO, &st) == 0 && S_ISREG(st.st_mode)) {
+      // input redirected from a regular file: read it like any other file
+      return get_reader("/dev/stdin", cancellation);
+    }
+    // pipes and terminals: lines are searched as soon as they arrive
+    auto reader = std::make_unique<StreamReader>(STDIN_FILENO);
+    reader->set_cancellation(cancellation);
+    return reader;
+  }
+  if (_options.io_uring_depth > 0 && UringReader::available()) {
+    try {
+      auto reader = std::make_unique<UringReader>(
+          file, _options.meta_file_path, _options.io_uring_depth);
+      reader->set_cancellation(cancellation);
+      return reader;
+    } catch (const std::system_error&) {
+      // fall back to the blocking readers (which report errors themselves)
+    }
+  }
+  bool use_mmap = _options.io == Grep::IO::MMAP ||
+                  (_options.io == Grep::IO::AUTO && prefer_mmap(file));
+  if (_options.io == Grep::IO::AUTO && !use_mmap &&
+      _options.meta_file_path.empty()) {
+    // not in the page cache: read with read ahead hints
+    auto reader = grep_reader();
+    reader->set_cancellation(cancellation);
+    return reader;
   }
+  base_reader reader;
   if (_options.meta_file_path.empty()) {
-    if (_options.no_mmap) {
-      return std::make_unique<xs::task::reader::FileBlockReader>(file);
+    if (use_mmap) {
+      reader = std::make_unique<xs::task::reader::FileBlockReaderMMAP>(file);
+    } else {
+      reader = std::make_unique<xs::task::reader::FileBlockReader>(file);
     }
-    return std::make_unique<xs::task::reader::FileBlockReaderMMAP>(file);
+  } else if (_options.num_reader_threads == 1) {
+    reader = std::make_unique<xs::task::reader::FileBlockMetaReaderSingle>(
+        file, _options.meta_file_path);
+  } else if (use_mmap) {
+    reader = std::make_unique<xs::task::reader::FileBlockMetaReaderMMAP>(
+        file, _options.meta_file_path, _options.num_reader_threads);
   } else {
-    if (_options.num_reader_threads == 1) {
-      return std::make_unique<xs::task::reader::FileBlockMetaReaderSingle>(
-          file, _options.meta_file_path);
-    }
-    if (_options.no_mmap) {
-      return std::make_unique<xs::task::reader::FileBlockMetaReader>(
-          file, _options.meta_file_path, _options.num_reader_threads);
-    } else {
-      return std::make_unique<xs::task::reader::FileBlockMetaReaderMMAP>(
-          file, _options.meta_file_path, _options.num_reader_threads);
+    reader = std::make_unique<xs::task::reader::FileBlockMetaReader>(
+        file, _options.meta_file_path, _options.num_reader_threads);
+  }
+  if (cancellation != nullptr) {
+    // the x-search readers do not know about cancellation
+    return std::make_unique<CancellableReader>(std::move(reader),
+                                               cancellation);
+  }
+  return reader;
+}
+
+std::unique_ptr<GrepSearcher> Grep::get_searcher(
+    const base_reader& reader) const {
+  // inverted searches select whole lines
+  bool only_matching = _options.only_matching && !_options.invert_match;
+  auto searcher =
+      _searcher_cache != nullptr
+          ? _searcher_cache->get(search_patterns(), _options.byte_offset,
+                                 _options.line_number, only_matching,
+                                 use_regex(), _options.ignore_case,
+                                 _options.locale, boundary())
+          : std::make_unique<GrepSearcher>(
+                search_patterns(), _options.byte_offset, _options.line_number,
+                only_matching, use_regex(), _options.ignore_case,
+                _options.locale, boundary());
+  searcher->set_highlight(_options.color == Grep::Color::ON);
+  searcher->set_invert_match(_options.invert_match);
+  if (auto* grep_reader = dynamic_cast<GrepReader*>(reader.get())) {
+    searcher->set_chunk_files(grep_reader->chunk_files());
+  }
+  return searcher;
+}
+
+bool Grep::limited() const {
+  return _options.max_count >= 0 || _options.quiet ||
+         _options.files_with_matches || _options.files_without_match;
+}
+
+std::vector<std::string> Grep::search_patterns() const {
+  if (_options.patterns.empty() && !_options.use_patterns) {
+    return {_options.pattern};
+  }
+  // grep semantics: every line of a pattern is a pattern of its own
+  std::vector<std::string> patterns;
+  for (const auto& pattern : _options.patterns) {
+    size_t begin = 0;
+    while (true) {
+      size_t end = pattern.find('\n', begin);
+      patterns.push_back(pattern.substr(begin, end - begin));
+      if (end == std::string::npos) {
+        break;
+      }
+      begin = end + 1;
     }
   }
+  return patterns;
 }
 
 bool Grep::use_regex() const {
-  return xs::utils::use_str_as_regex(_options.pattern) &&
-         !_options.fixed_string;
+  if (_options.fixed_string) {
+    return false;
+  }
+  auto patterns = search_patterns();
+  return std::any_of(patterns.begin(), patterns.end(),
+                     [](const std::string& pattern) {
+                       return xs::utils::use_str_as_regex(pattern);
+                     });
+}
+
+Grep::Boundary Grep::boundary() const {
+  if (_options.line_regexp) {
+    return Grep::Boundary::LINE;
+  }
+  return _options.word_regexp ? Grep::Boundary::WORD : Grep::Boundary::NONE;
+}
+
+std::vector<std::string> Grep::ngram_literals() const {
+  if (_options.invert_match || _options.before_context >= 0 ||
+      _options.after_context >= 0 ||
+      (_options.ignore_case && _options.locale != Grep::Locale::ASCII)) {
+    // inverted searches select lines of chunks without matches, so do context
+    //  lines, the filters only fold the case of ASCII characters
+    return {};
+  }
+  bool regex = use_regex();
+  std::vector<std::string> literals;
+  for (const auto& pattern : search_patterns()) {
+    auto required = regex ? required_literals(pattern, _options.ignore_case)
+                          : std::vector<std::string>{pattern};
+    if (required.empty() ||
+        std::any_of(required.begin(), required.end(),
+                    [](const std::string& str) { return str.size() < 3; })) {
+      // lines selected by this pattern may contain no trigram at all
+      return {};
+    }
+    literals.insert(literals.end(), required.begin(), required.end());
+  }
+  return literals;
 }
 
 const int Grep::_max_phys_cores =
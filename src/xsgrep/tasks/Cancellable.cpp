@@ -0,0 +1,37 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <xsgrep/tasks/Cancellable.h>
+
+// ===== CancellableReader =====================================================
+// _____________________________________________________________________________
+CancellableReader::CancellableReader(
+    std::unique_ptr<xs::task::base::DataProvider<xs::DataChunk>> reader,
+    std::shared_ptr<Cancellation> cancellation)
+    : xs::task::base::DataProvider<xs::DataChunk>(reader->get_max_readers()),
+      _reader(std::move(reader)),
+      _cancellation(std::move(cancellation)) {}
+
+// _____________________________________________________________________________
+std::optional<std::pair<xs::DataChunk, xs::chunk_index>>
+CancellableReader::getNextData() {
+  if (_cancellation->cancelled()) {
+    return {};
+  }
+  return _reader->getNextData();
+}
+
+// ===== CancellableProcessor ==================================================
+// _____________________________________________________________________________
+CancellableProcessor::CancellableProcessor(
+    std::unique_ptr<xs::task::base::InplaceProcessor<xs::DataChunk>> processor,
+    std::shared_ptr<Cancellation> cancellation)
+    : _processor(std::move(processor)),
+      _cancellation(std::move(cancellation)) {}
+
+// _____________________________________________________________________________
+void CancellableProcessor::process(xs::DataChunk* data) const {
+  if (!_cancellation->cancelled()) {
+    _processor->process(data);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <xsgrep/tasks/GrepDecompressor.h>
+
+// _____________________________________________________________________________
+GrepDecompressor::GrepDecompressor(std::shared_ptr<ChunkFileTable> chunk_files)
+    : _chunk_files(std::move(chunk_files)) {}
+
+// _____________________________________________________________________________
+void GrepDecompressor::process(xs::DataChunk* data) const {
+  switch (_chunk_files->compression_type(data->getMetaData().chunk_index)) {
+    case xs::CompressionType::LZ4:
+      _lz4.process(data);
+      break;
+    case xs::CompressionType::ZSTD:
+      _zstd.process(data);
+      break;
+    default:
+      break;
+  }
+}
\ No newline at end of file
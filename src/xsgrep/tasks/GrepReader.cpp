@@ -1,80 +1,509 @@
 // Copyright 2023, Leon Freist
 // Author: Leon Freist <freist@informatik.uni-freiburg.de>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <xsgrep/tasks/GrepReader.h>
+#include <xsgrep/utils/page_cache.h>
 
-#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
 
-GrepReader::GrepReader(std::string path, int recursive_depth)
-    : task::base::DataProvider<DataChunk>(1),
-      _recursive_depth(recursive_depth) {
-  if (std::filesystem::is_regular_file(path)) {
-    _file_queue.emplace(std::move(path));
-  } else if (std::filesystem::is_directory(path)) {
-    _directory_queue.emplace(std::move(path), 0);
-  } else {
-    throw std::runtime_error(path + " is not a file or directory.");
+// ----- Helper function -------------------------------------------------------
+// _____________________________________________________________________________
+/**
+ * Read up to size bytes at offset from fd (retries on partial reads).
+ * @return number of bytes read
+ */
+size_t pread_all_(int fd, char* buffer, size_t size, uint64_t offset) {
+  size_t total = 0;
+  while (total < size) {
+    ssize_t n = ::pread(fd, buffer + total, size - total,
+                        static_cast<off_t>(offset + total));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    total += static_cast<size_t>(n);
+  }
+  return total;
+}
+
+// ===== ChunkFileTable ========================================================
+// _____________________________________________________________________________
+void ChunkFileTable::insert(uint64_t chunk_index,
+                            std::vector<ChunkFile> files) {
+  std::unique_lock lock(_mutex);
+  _files.insert_or_assign(chunk_index, std::move(files));
+}
+
+// _____________________________________________________________________________
+std::optional<std::vector<ChunkFile>> ChunkFileTable::extract(
+    uint64_t chunk_index) {
+  std::unique_lock lock(_mutex);
+  auto search = _files.find(chunk_index);
+  if (search == _files.end()) {
+    return {};
+  }
+  std::vector<ChunkFile> files = std::move(search->second);
+  _files.erase(search);
+  return files;
+}
+
+// _____________________________________________________________________________
+CompressionType ChunkFileTable::compression_type(uint64_t chunk_index) {
+  std::unique_lock lock(_mutex);
+  auto search = _files.find(chunk_index);
+  if (search == _files.end() || search->second.empty()) {
+    return CompressionType::NONE;
+  }
+  return search->second.front().compression_type;
+}
+
+// ===== GrepReader ============================================================
+// _____________________________________________________________________________
+GrepReader::OpenFile::OpenFile(std::string path, int fd, uint64_t size)
+    : path(std::move(path)), fd(fd), size(size) {}
+
+// _____________________________________________________________________________
+GrepReader::OpenFile::~OpenFile() {
+  if (mapping != nullptr) {
+    ::munmap(const_cast<char*>(mapping), size);
+  }
+  ::close(fd);
+}
+
+// _____________________________________________________________________________
+std::shared_ptr<GrepReader::OpenFile> GrepReader::OpenFile::open(
+    std::string path, const std::string& meta_path, bool read_filters) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat st {};
+  if (fd < 0 || ::fstat(fd, &st) != 0) {
+    if (fd >= 0) {
+      int error = errno;
+      ::close(fd);
+      errno = error;
+    }
+    return nullptr;
+  }
+  auto file = std::make_shared<OpenFile>(std::move(path), fd,
+                                         static_cast<uint64_t>(st.st_size));
+  if (!meta_path.empty() && std::filesystem::is_regular_file(meta_path)) {
+    MetaFile meta_file(meta_path, std::ios::in);
+    file->preprocessed = true;
+    file->compression_type = meta_file.get_compression_type();
+    while (auto meta_data = meta_file.next_chunk_meta_data()) {
+      file->meta_chunks.push_back(std::move(*meta_data));
+    }
+    std::string filter_path = meta_path + NgramFilter::file_suffix;
+    if (read_filters && std::filesystem::is_regular_file(filter_path)) {
+      file->ngram_filters = NgramFilter::read_file(filter_path);
+    }
   }
+  return file;
 }
 
+// _____________________________________________________________________________
+void GrepReader::OpenFile::map() {
+  if (mapping != nullptr || size == 0) {
+    return;
+  }
+  void* ptr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (ptr != MAP_FAILED) {
+    mapping = static_cast<const char*>(ptr);
+  }
+}
+
+// _____________________________________________________________________________
+size_t GrepReader::OpenFile::read(char* buffer, size_t n,
+                                  uint64_t offset) const {
+  if (mapping == nullptr) {
+    return pread_all_(fd, buffer, n, offset);
+  }
+  if (offset >= size) {
+    return 0;
+  }
+  n = std::min<uint64_t>(n, size - offset);
+  std::memcpy(buffer, mapping + offset, n);
+  return n;
+}
+
+// _____________________________________________________________________________
+uint64_t GrepReader::OpenFile::line_start(uint64_t offset) const {
+  if (offset == 0 || offset >= size) {
+    return offset >= size ? size : 0;
+  }
+  // a line starts at offset if the byte before is a new line
+  if (mapping != nullptr) {
+    auto* nl = static_cast<const char*>(
+        std::memchr(mapping + offset - 1, '\n', size - offset + 1));
+    return nl == nullptr ? size : (nl - mapping) + 1;
+  }
+  char buffer[4096];
+  uint64_t position = offset - 1;
+  while (position < size) {
+    size_t n = pread_all_(fd, buffer, sizeof(buffer), position);
+    if (n == 0) {
+      break;
+    }
+    auto* nl = static_cast<const char*>(std::memchr(buffer, '\n', n));
+    if (nl != nullptr) {
+      return position + (nl - buffer) + 1;
+    }
+    position += n;
+  }
+  return size;
+}
+
+// _____________________________________________________________________________
+GrepReader::GrepReader(std::string path, int recursive_depth, int max_readers,
+                       size_t pack_size, size_t stripe_size,
+                       std::shared_ptr<ErrorLog> errors)
+    : task::base::DataProvider<DataChunk>(max_readers < 1 ? 1 : max_readers),
+      _errors(errors != nullptr ? std::move(errors)
+                                : std::make_shared<ErrorLog>()),
+      _walker(std::move(path), recursive_depth, 0, 4096, _errors),
+      _pack_size(pack_size),
+      _stripe_size(stripe_size == 0 ? 1 : stripe_size),
+      _chunk_files(std::make_shared<ChunkFileTable>()) {}
+
+// _____________________________________________________________________________
 std::optional<std::pair<DataChunk, chunk_index>> GrepReader::getNextData() {
-  if (_reader == nullptr) {
-    if (_file_queue.empty()) {
-      if (getNextFiles()) {
-        auto file = std::move(_file_queue.front());
-        _file_queue.pop();
-        _reader =
-            std::make_unique<task::reader::FileBlockReader>(std::move(file));
-      } else {
-        // no files left, stop reading
+  auto item = next_work_item();
+  if (!item.has_value()) {
+    return {};
+  }
+  // reading happens without holding the lock
+  if (item->first.chunk_meta_data.has_value()) {
+    return {std::make_pair(read_meta_chunk(&item->first, item->second),
+                           item->second)};
+  }
+  if (item->first.split) {
+    return {std::make_pair(read_stripe(item->first, item->second),
+                           item->second)};
+  }
+  return {std::make_pair(read_pack(item->first, item->second), item->second)};
+}
+
+// _____________________________________________________________________________
+std::shared_ptr<ChunkFileTable> GrepReader::chunk_files() const {
+  return _chunk_files;
+}
+
+// _____________________________________________________________________________
+GrepReader& GrepReader::set_use_mmap(bool val) {
+  _use_mmap = val;
+  return *this;
+}
+
+// _____________________________________________________________________________
+GrepReader& GrepReader::set_auto_mmap(bool val) {
+  _auto_mmap = val;
+  return *this;
+}
+
+// _____________________________________________________________________________
+GrepReader& GrepReader::set_meta_file_suffix(std::string suffix) {
+  _meta_file_suffix = std::move(suffix);
+  return *this;
+}
+
+// _____________________________________________________________________________
+GrepReader& GrepReader::set_meta_file(std::string meta_file) {
+  _meta_file = std::move(meta_file);
+  return *this;
+}
+
+// _____________________________________________________________________________
+GrepReader& GrepReader::set_ngram_literals(std::vector<std::string> literals) {
+  _ngram_literals = std::move(literals);
+  return *this;
+}
+
+// _____________________________________________________________________________
+GrepReader& GrepReader::set_cancellation(
+    std::shared_ptr<Cancellation> cancellation) {
+  _cancellation = std::move(cancellation);
+  return *this;
+}
+
+// _____________________________________________________________________________
+GrepReader& GrepReader::set_file_cache(std::shared_ptr<FileCache> cache) {
+  _file_cache = std::move(cache);
+  return *this;
+}
+
+// _____________________________________________________________________________
+std::optional<std::pair<GrepReader::WorkItem, chunk_index>>
+GrepReader::next_work_item() {
+  std::unique_lock lock(_mutex);
+  WorkItem item;
+  while (true) {
+    if (_cancellation != nullptr) {
+      if (_cancellation->cancelled()) {
         return {};
       }
-    } else {
-      auto file = std::move(_file_queue.front());
-      _file_queue.pop();
-      _reader =
-          std::make_unique<task::reader::FileBlockReader>(std::move(file));
+      if (_split_file != nullptr &&
+          _cancellation->file_cancelled(_split_file->path)) {
+        // skip the remaining chunks of the file
+        _split_file = nullptr;
+      }
+    }
+    if (_split_file != nullptr && _split_file->preprocessed) {
+      if (_next_stripe >= _num_stripes) {
+        // all chunks of the preprocessed file were read
+        _split_file = nullptr;
+        continue;
+      }
+      item.chunk_meta_data = _split_file->meta_chunks[_next_stripe++];
+      if (!_ngram_literals.empty() && !_split_file->ngram_filters.empty()) {
+        auto search = _split_file->ngram_filters.find(
+            item.chunk_meta_data->original_offset);
+        item.skip = search != _split_file->ngram_filters.end() &&
+                    !search->second.may_contain_any(_ngram_literals);
+      }
+      item.files.push_back(_split_file);
+      return {std::make_pair(std::move(item), _chunk_index++)};
+    }
+    if (_split_file != nullptr) {
+      item.files.push_back(_split_file);
+      item.stripe = _next_stripe++;
+      item.split = true;
+      if (_next_stripe >= _num_stripes) {
+        _split_file = nullptr;
+      }
+      return {std::make_pair(std::move(item), _chunk_index++)};
+    }
+    size_t pack_size = 0;
+    while (true) {
+      std::shared_ptr<OpenFile> file = std::move(_pending_file);
+      _pending_file = nullptr;
+      if (file == nullptr) {
+        file = next_file();
+      }
+      if (file == nullptr) {
+        break;
+      }
+      if (file->size >= _pack_size || file->preprocessed) {
+        // large file: split it after the current pack was returned
+        if (!file->cached) {
+          if (_auto_mmap ? prefer_mmap(file->fd, file->size) : _use_mmap) {
+            file->map();
+          }
+          if (file->mapping == nullptr) {
+            advise_sequential(file->fd);
+          }
+        }
+        _split_file = std::move(file);
+        _next_stripe = 0;
+        _num_stripes =
+            _split_file->preprocessed
+                ? _split_file->meta_chunks.size()
+                : (_split_file->size + _stripe_size - 1) / _stripe_size;
+        break;
+      }
+      if (!item.files.empty() && (pack_size + file->size + 1 > _pack_size ||
+                                  item.files.size() >= max_pack_files)) {
+        // every file of the pack keeps its descriptor until the pack is read
+        _pending_file = std::move(file);
+        break;
+      }
+      pack_size += file->size + 1;
+      item.files.push_back(std::move(file));
+    }
+    if (!item.files.empty()) {
+      return {std::make_pair(std::move(item), _chunk_index++)};
+    }
+    if (_split_file == nullptr) {
+      // no files left, stop reading
+      return {};
     }
   }
-  auto res = _reader->getNextData();
-  if (!res.has_value()) {
-    _reader = nullptr;
-    _chunk_index++;
-    return getNextData();
-  }
-  _chunk_index += res->second;
-  return {std::make_pair(res->first, res->second + _chunk_index)};
 }
 
-bool GrepReader::getNextFiles() {
+// _____________________________________________________________________________
+std::shared_ptr<GrepReader::OpenFile> GrepReader::next_file() {
   while (true) {
-    if (_directory_queue.empty()) {
-      // no additional files found, break and return false
-      break;
-    }
-    // pop next directory from queue
-    auto directory = std::move(_directory_queue.front());
-    _directory_queue.pop();
-    // skip directory if recursion depth is reached
-    if (directory.second >= _recursive_depth && _recursive_depth != -1) {
-      continue;
+    auto entry = _walker.next_file();
+    if (!entry.has_value()) {
+      return nullptr;
     }
-    // iterate through all objects within the given directory
-    for (auto& obj : std::filesystem::directory_iterator(directory.first)) {
-      if (std::filesystem::is_regular_file(obj)) {
-        // if object is file, add it to file queue
-        _file_queue.push(obj);
-      } else if (std::filesystem::is_directory(obj)) {
-        // if object is directory add it to directory queue and increase
-        // recursive counter
-        _directory_queue.emplace(obj, directory.second + 1);
+    std::string meta_path = _meta_file;
+    if (meta_path.empty() && !_meta_file_suffix.empty()) {
+      if (is_meta_file(*entry)) {
+        continue;
+      }
+      // the listing of the directory tells if the metafile exists, only the
+      //  root file is probed
+      std::string_view name(entry->path);
+      name.remove_prefix(name.rfind('/') + 1);
+      if (entry->has_sibling(std::string(name) + _meta_file_suffix)
+              .value_or(true)) {
+        meta_path = entry->path + _meta_file_suffix;
       }
     }
-    // repeat if no files were added
-    if (_file_queue.empty()) {
-      continue;
+    auto file =
+        _file_cache != nullptr
+            ? _file_cache->get(entry->path, meta_path)
+            : OpenFile::open(entry->path, meta_path, !_ngram_literals.empty());
+    if (file != nullptr) {
+      return file;
+    }
+    _errors->report(entry->path, std::strerror(errno));
+  }
+}
+
+// _____________________________________________________________________________
+bool GrepReader::is_meta_file(const DirectoryWalker::File& file) const {
+  std::string_view base(file.path);
+  if (base.ends_with(NgramFilter::file_suffix)) {
+    base.remove_suffix(std::strlen(NgramFilter::file_suffix));
+  }
+  if (base.size() <= _meta_file_suffix.size() ||
+      !base.ends_with(_meta_file_suffix)) {
+    return false;
+  }
+  base.remove_suffix(_meta_file_suffix.size());
+  std::string_view name = base.substr(base.rfind('/') + 1);
+  auto exists = file.has_sibling(name);
+  return exists.has_value() ? *exists
+                            : std::filesystem::is_regular_file(base);
+}
+
+// _____________________________________________________________________________
+DataChunk GrepReader::read_pack(const WorkItem& item, chunk_index id) {
+  size_t size = 0;
+  for (const auto& file : item.files) {
+    size += file->size + 1;
+  }
+  DataChunk chunk(size);
+  chunk.getMetaData() = {id, 0, 0, size, size, {{0, 0}}};
+  std::vector<ChunkFile> files;
+  files.reserve(item.files.size());
+  size_t offset = 0;
+  for (const auto& file : item.files) {
+    size_t n = file->read(chunk.data() + offset, file->size, 0);
+    // files that shrank since they were opened are padded with new lines
+    std::memset(chunk.data() + offset + n, '\n', file->size - n + 1);
+    files.push_back({file->path, offset, 0, n});
+    offset += file->size + 1;
+  }
+  _chunk_files->insert(id, std::move(files));
+  return chunk;
+}
+
+// _____________________________________________________________________________
+DataChunk GrepReader::read_stripe(const WorkItem& item, chunk_index id) {
+  const auto& file = item.files.front();
+  // the stripe consists of all lines starting within
+  //  [stripe * _stripe_size, (stripe + 1) * _stripe_size)
+  uint64_t begin = file->line_start(item.stripe * _stripe_size);
+  uint64_t end = file->line_start((item.stripe + 1) * _stripe_size);
+  if (file->mapping == nullptr && end < file->size) {
+    // the next stripe is read from disk while this one is searched
+    advise_will_need(file->fd, end, _stripe_size);
+  }
+  size_t size = end - begin;
+  DataChunk chunk(size);
+  size_t n = file->read(chunk.data(), size, begin);
+  std::memset(chunk.data() + n, '\n', size - n);
+  chunk.getMetaData() = {id, begin, begin, size, size, {{begin, 0}}};
+  _chunk_files->insert(id, {{file->path, 0, begin, n}});
+  return chunk;
+}
+
+// _____________________________________________________________________________
+DataChunk GrepReader::read_meta_chunk(WorkItem* item, chunk_index id) {
+  const auto& file = item->files.front();
+  ChunkMetaData& meta_data = *item->chunk_meta_data;
+  // chunks are identified by the global id, not the index within the file
+  meta_data.chunk_index = id;
+  if (item->skip) {
+    // an empty chunk: the file is still known to the searcher and the output
+    _chunk_files->insert(
+        id, {{file->path, 0, meta_data.original_offset, 0, true}});
+    meta_data.actual_size = 0;
+    meta_data.original_size = 0;
+    DataChunk chunk(0);
+    chunk.getMetaData() = std::move(meta_data);
+    return chunk;
+  }
+  DataChunk chunk(meta_data.actual_size);
+  size_t n = file->read(chunk.data(), meta_data.actual_size,
+                        meta_data.actual_offset);
+  if (n != meta_data.actual_size) {
+    throw std::runtime_error(file->path + ": does not match its metafile.");
+  }
+  _chunk_files->insert(
+      id, {{file->path, 0, meta_data.original_offset, meta_data.original_size,
+            true, file->compression_type}});
+  chunk.getMetaData() = std::move(meta_data);
+  return chunk;
+}
+
+// ===== FileCache =============================================================
+// _____________________________________________________________________________
+FileCache::FileCache(size_t max_files, size_t min_size)
+    : _max_files(std::max<size_t>(max_files, 1)), _min_size(min_size) {}
+
+// _____________________________________________________________________________
+size_t FileCache::size() const {
+  std::unique_lock lock(_mutex);
+  return _entries.size();
+}
+
+// _____________________________________________________________________________
+FileCache::FileId FileCache::file_id(const std::string& path) {
+  struct stat st {};
+  if (path.empty() || ::stat(path.c_str(), &st) != 0) {
+    return {};
+  }
+  return {static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(st.st_ino),
+          static_cast<uint64_t>(st.st_size),
+          st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec};
+}
+
+// _____________________________________________________________________________
+std::shared_ptr<GrepReader::OpenFile> FileCache::get(
+    const std::string& path, const std::string& meta_path) {
+  std::vector<FileId> ids = {
+      file_id(path), file_id(meta_path),
+      file_id(meta_path.empty() ? meta_path
+                                : meta_path + NgramFilter::file_suffix)};
+  std::string key = path + '\0' + meta_path;
+  {
+    std::unique_lock lock(_mutex);
+    auto search = _entries.find(key);
+    if (search != _entries.end() && search->second.ids == ids) {
+      _lru.splice(_lru.begin(), _lru, search->second.lru);
+      return search->second.file;
     }
-    return true;
   }
-  return false;
+  // opened without holding the lock: parsing a metafile may take a while
+  auto file = GrepReader::OpenFile::open(path, meta_path, true);
+  if (file == nullptr || (file->size < _min_size && !file->preprocessed)) {
+    return file;
+  }
+  file->map();
+  file->cached = true;
+  std::unique_lock lock(_mutex);
+  auto search = _entries.find(key);
+  if (search != _entries.end()) {
+    _lru.erase(search->second.lru);
+    _entries.erase(search);
+  }
+  _lru.push_front(key);
+  _entries.emplace(std::move(key), Entry{file, std::move(ids), _lru.begin()});
+  while (_entries.size() > _max_files) {
+    _entries.erase(_lru.back());
+    _lru.pop_back();
+  }
+  return file;
 }
\ No newline at end of file
@@ -4,185 +4,811 @@
 #include <xsearch/utils/InlineBench.h>
 #include <xsgrep/tasks/GrepResult.h>
 
+#include <algorithm>
+#include <filesystem>
+
+// ----- Helper functions ------------------------------------------------------
+// _____________________________________________________________________________
+/// number of selected lines of partial_result (context lines are not counted)
+size_t num_selected_(const Grep::PartialResult& partial_result) {
+  return std::count_if(
+      partial_result.matches.begin(), partial_result.matches.end(),
+      [](const Grep::MatchRef& match) { return match.context == 0; });
+}
+
+// _____________________________________________________________________________
+/// byte position of the line following the line match
+int64_t next_line_(const Grep::MatchRef& match) {
+  return match.byte_position + static_cast<int64_t>(match.size) + 1;
+}
+
+// _____________________________________________________________________________
+int64_t next_line_(const Grep::Match& match) {
+  return match.byte_position + static_cast<int64_t>(match.match.size()) + 1;
+}
+
+// _____________________________________________________________________________
+/// append the line of match, occurrences of the pattern are colored RED
+void append_highlighted_(const Grep::PartialResult& partial_result,
+                         const Grep::MatchRef& match, std::string* out) {
+  std::string_view line = partial_result.str(match);
+  // the searcher provides the location of every occurrence of the pattern
+  //  within the line: print them in RED and the rest uncolored.
+  size_t shift = 0;
+  for (size_t i = match.highlight_begin; i < match.highlight_end; ++i) {
+    const auto& span = partial_result.highlights[i];
+    out->append(line.substr(shift, span.offset - shift));
+    out->append(RED).append(line.substr(span.offset, span.size));
+    out->append(COLOR_RESET);
+    shift = span.offset + span.size;
+  }
+  // print rest of the string (eq. pythonic substr is str[shift:])
+  out->append(line.substr(shift)).push_back('\n');
+}
+
+// ===== Grep::PartialResult ===================================================
+// _____________________________________________________________________________
+std::string_view Grep::PartialResult::str(const Grep::MatchRef& match) const {
+  return {buffer.data() + match.offset, match.size};
+}
+
+// _____________________________________________________________________________
+Grep::Match Grep::PartialResult::to_match(const Grep::MatchRef& match) const {
+  return {match.byte_position, match.line_number, std::string(str(match))};
+}
+
+// ===== LineNumberResolver ====================================================
+// _____________________________________________________________________________
+void LineNumberResolver::resolve(Grep::PartialResult* partial_result) {
+  if (!partial_result->relative_line_numbers) {
+    return;
+  }
+  size_t begin = 0;
+  for (const auto& segment : partial_result->segments) {
+    enter_file(segment.file_name);
+    for (size_t i = begin; i < segment.matches_end; ++i) {
+      partial_result->matches[i].line_number +=
+          static_cast<int64_t>(_num_lines);
+    }
+    _num_lines += segment.num_lines;
+    begin = segment.matches_end;
+  }
+  partial_result->relative_line_numbers = false;
+}
+
+// _____________________________________________________________________________
+void LineNumberResolver::skip(const std::vector<Grep::FileSegment>& segments) {
+  for (const auto& segment : segments) {
+    enter_file(segment.file_name);
+    _num_lines += segment.num_lines;
+  }
+}
+
+// _____________________________________________________________________________
+void LineNumberResolver::enter_file(const std::string& file_name) {
+  if (file_name != _file_name) {
+    _file_name = file_name;
+    _num_lines = 0;
+  }
+}
+
 // ===== GrepOutput ============================================================
 // _____________________________________________________________________________
-GrepOutput::GrepOutput(Grep::Options options, std::ostream& ostream)
-    : _options(std::move(options)), _ostream(ostream) {}
+GrepOutput::GrepOutput(Grep::Options options, std::ostream& ostream,
+                       std::shared_ptr<Cancellation> cancellation)
+    : _options(std::move(options)),
+      _sink(ostream),
+      _limited(_options.max_count >= 0 || _options.quiet ||
+               _options.files_with_matches || _options.files_without_match),
+      _cancellation(std::move(cancellation)),
+      _context((_options.before_context >= 0 || _options.after_context >= 0) &&
+               !_options.only_matching && !_options.count && !_options.quiet &&
+               !_options.files_with_matches && !_options.files_without_match),
+      _sequencer(
+          max_pending,
+          [this](uint64_t id, Pending pending) {
+            INLINE_BENCHMARK_WALL_START(_, "output");
+            write_ordered(id, &pending);
+          },
+          _options.max_memory) {
+  if (!std::filesystem::is_directory(_options.file)) {
+    _single_file_name =
+        _options.file.empty() || _options.file == "-"
+            ? "(standard input)"
+            : std::string(relative_name(_options.file, _options.display_root));
+  }
+}
+
+// _____________________________________________________________________________
+void GrepOutput::add(Grep::PartialResult partial_result, uint64_t id) {
+  Pending pending;
+  pending.num_lines =
+      _context ? num_selected_(partial_result) : partial_result.matches.size();
+  if (_options.line_number && !_limited) {
+    resolve_early(&partial_result, id);
+  }
+  pending.resolve_lines =
+      _options.line_number && partial_result.relative_line_numbers;
+  if (pending.resolve_lines || _limited) {
+    pending.partial_result = std::move(partial_result);
+  } else {
+    if (_context) {
+      chunk_context(partial_result, &pending.context);
+    }
+    format(partial_result, &pending.formatted);
+  }
+  size_t bytes = pending.formatted.size() +
+                 pending.partial_result.buffer.size() +
+                 pending.partial_result.matches.size() * sizeof(Grep::MatchRef);
+  // written in order by the writer thread of the sequencer (blocks if the
+  //  results waiting for it exceed max_memory)
+  _sequencer.publish(id, std::move(pending), bytes);
+}
+
+// _____________________________________________________________________________
+size_t GrepOutput::size() const {
+  _sequencer.flush();
+  return _lines_written;
+}
 
 // _____________________________________________________________________________
-void GrepOutput::add(
-    std::pair<std::string, std::vector<Grep::Match>> partial_result,
-    uint64_t id) {
-  std::unique_lock lock(*this->_mutex);
-  if (_current_index == id) {
-    add(std::move(partial_result));
-    _current_index++;
-    // check if buffered results can be added now
+Sequencer<GrepOutput::Pending>::Stats GrepOutput::stats() const {
+  return _sequencer.stats();
+}
+
+// _____________________________________________________________________________
+void GrepOutput::abort() { _sequencer.abort(); }
+
+// _____________________________________________________________________________
+void GrepOutput::finish() {
+  // write all results and stop the writer thread
+  _sequencer.close();
+  if (!_options.files_without_match || _options.quiet) {
+    return;
+  }
+  if (!_file_started) {
+    // no data was read at all (e.g. an empty file)
+    if (!_single_file_name.empty()) {
+      write_file_name(_single_file_name);
+    }
+    return;
+  }
+  if (_file_matches == 0) {
+    write_file_name(_file_name);
+  }
+}
+
+// _____________________________________________________________________________
+void GrepOutput::add(Grep::PartialResult partial_result) {
+  _line_numbers.resolve(&partial_result);
+  std::string formatted;
+  format(partial_result, &formatted);
+  _sink.write(formatted);
+  _lines_written += partial_result.matches.size();
+}
+
+// _____________________________________________________________________________
+void GrepOutput::write_ordered(uint64_t id, Pending* pending) {
+  if (_limited) {
+    auto& partial_result = pending->partial_result;
+    _line_numbers.resolve(&partial_result);
+    if (_options.quiet || _options.files_with_matches ||
+        _options.files_without_match) {
+      list_files(partial_result);
+      return;
+    }
+    limit_matches(&partial_result);
+    pending->num_lines = _context ? num_selected_(partial_result)
+                                  : partial_result.matches.size();
+    if (_context) {
+      chunk_context(partial_result, &pending->context);
+    }
+    format(partial_result, &pending->formatted);
+  } else if (_options.line_number) {
+    // all previous chunks were counted: the line number state is known (if
+    //  it was not used by resolve_early() already)
+    std::unique_lock lock(*this->_mutex);
+    auto state = _line_states.extract(id);
+    lock.unlock();
+    if (pending->resolve_lines) {
+      state.mapped().resolve(&pending->partial_result);
+      if (_context) {
+        chunk_context(pending->partial_result, &pending->context);
+      }
+      format(pending->partial_result, &pending->formatted);
+    }
+  }
+  if (_context) {
+    std::string joined;
+    join_context(pending->context, &joined);
+    _sink.write(joined);
+  }
+  _sink.write(pending->formatted);
+  _lines_written += pending->num_lines;
+  if (_options.line_buffered && !pending->formatted.empty()) {
+    _sink.flush();
+  }
+}
+
+// _____________________________________________________________________________
+void GrepOutput::resolve_early(Grep::PartialResult* partial_result,
+                               uint64_t id) {
+  LineNumberResolver state;
+  {
+    std::unique_lock lock(*this->_mutex);
+    // only the number of lines is needed to advance the prefix sum
+    _line_segments.insert({id, partial_result->segments});
     while (true) {
-      auto search = _buffer.find(_current_index);
-      if (search == _buffer.end()) {
+      auto search = _line_segments.find(_line_index);
+      if (search == _line_segments.end()) {
         break;
       }
-      add(std::move(search->second));
-      _buffer.erase(_current_index);
-      _current_index++;
+      _line_states.insert({_line_index, _line_prefix});
+      _line_prefix.skip(search->second);
+      _line_segments.erase(search);
+      _line_index++;
+    }
+    auto search = _line_states.find(id);
+    if (search == _line_states.end()) {
+      // resolved once it is the turn of the partial result
+      return;
+    }
+    state = std::move(search->second);
+    _line_states.erase(search);
+  }
+  state.resolve(partial_result);
+}
+
+// _____________________________________________________________________________
+void GrepOutput::limit_matches(Grep::PartialResult* partial_result) {
+  if (_context) {
+    limit_context(partial_result);
+    return;
+  }
+  auto max_count = static_cast<uint64_t>(_options.max_count);
+  // number of the n matches of file_name that are kept
+  auto take = [&](const std::string& file_name, size_t n) -> size_t {
+    enter_file(file_name);
+    size_t keep = std::min<uint64_t>(n, max_count - _file_matches);
+    _file_matches += keep;
+    if (_file_matches >= max_count && _cancellation != nullptr) {
+      _cancellation->cancel_file(file_name);
     }
-    // at least one partial_result was added -> notify
-    this->_cv->notify_one();
+    return keep;
+  };
+  auto& matches = partial_result->matches;
+  if (partial_result->segments.empty()) {
+    if (!matches.empty()) {
+      matches.resize(take(partial_result->file_name, matches.size()));
+    }
+    return;
+  }
+  size_t begin = 0;
+  size_t kept = 0;
+  for (auto& segment : partial_result->segments) {
+    size_t keep = take(segment.file_name, segment.matches_end - begin);
+    std::move(matches.begin() + static_cast<int64_t>(begin),
+              matches.begin() + static_cast<int64_t>(begin + keep),
+              matches.begin() + static_cast<int64_t>(kept));
+    begin = segment.matches_end;
+    kept += keep;
+    segment.matches_end = kept;
+  }
+  matches.resize(kept);
+}
+
+// _____________________________________________________________________________
+void GrepOutput::limit_context(Grep::PartialResult* partial_result) {
+  auto max_count = static_cast<uint64_t>(_options.max_count);
+  auto& matches = partial_result->matches;
+  // no leading context is needed if the first selected line is dropped
+  bool first_selected = true;
+  size_t begin = 0;
+  size_t kept = 0;
+  auto limit = [&](const std::string& file_name, size_t end) {
+    enter_file(file_name);
+    for (size_t m = begin; m < end; ++m) {
+      auto& line = matches[m];
+      bool keep = true;
+      if (_file_matches < max_count) {
+        if (line.context == 0 && ++_file_matches == max_count) {
+          _trailing = std::max<int64_t>(_options.after_context, 0);
+          _trailing_end = next_line_(line);
+        }
+      } else if (_trailing > 0 && line.byte_position == _trailing_end) {
+        // selected lines are written as trailing context, too (like grep)
+        line.context = Grep::CONTEXT_LINE;
+        _trailing--;
+        _trailing_end = next_line_(line);
+      } else {
+        keep = false;
+      }
+      if (line.context == 0 && first_selected) {
+        first_selected = false;
+        if (!keep) {
+          partial_result->before_missing = 0;
+        }
+      }
+      if (keep) {
+        matches[kept++] = line;
+      }
+    }
+    // the file is cancelled once its trailing context is complete
+    if (_file_matches >= max_count && _trailing == 0 &&
+        _cancellation != nullptr) {
+      _cancellation->cancel_file(file_name);
+    }
+    begin = end;
+  };
+  if (partial_result->segments.empty()) {
+    limit(partial_result->file_name, matches.size());
   } else {
-    // buffer the partial result
-    _buffer.insert({id, std::move(partial_result)});
+    for (auto& segment : partial_result->segments) {
+      limit(segment.file_name, segment.matches_end);
+      segment.matches_end = kept;
+    }
+  }
+  matches.resize(kept);
+  if (_file_matches >= max_count) {
+    // the trailing context is completed by limit_context() itself
+    partial_result->after_missing = 0;
+  }
+}
+
+// _____________________________________________________________________________
+void GrepOutput::list_files(const Grep::PartialResult& partial_result) {
+  partial_result.for_each_file([&](const std::string& file_name, size_t begin,
+                                   size_t end) {
+    enter_file(file_name);
+    if (begin == end) {
+      return;
+    }
+    bool first_match = _file_matches == 0;
+    _file_matches += end - begin;
+    if (_options.quiet) {
+      // any match decides the search
+      _lines_written += end - begin;
+      if (_cancellation != nullptr) {
+        _cancellation->cancel();
+      }
+      return;
+    }
+    if (first_match) {
+      if (_options.files_with_matches) {
+        write_file_name(file_name);
+      }
+      // -l and -L: the file is decided by its first match
+      if (_cancellation != nullptr) {
+        _cancellation->cancel_file(file_name);
+      }
+    }
+  });
+}
+
+// _____________________________________________________________________________
+void GrepOutput::enter_file(const std::string& file_name) {
+  if (_file_started && file_name == _file_name) {
+    return;
+  }
+  if (_file_started && _file_matches == 0 && _options.files_without_match &&
+      !_options.quiet) {
+    write_file_name(_file_name);
   }
+  _file_name = file_name;
+  _file_started = true;
+  _file_matches = 0;
+  _trailing = 0;
 }
 
 // _____________________________________________________________________________
-size_t GrepOutput::size() const { return _lines_written; }
+std::string_view GrepOutput::relative_name(std::string_view file_name,
+                                           std::string_view root) {
+  if (root.empty() || !file_name.starts_with(root)) {
+    return file_name;
+  }
+  std::string_view name = file_name.substr(root.size());
+  if (root.back() == '/') {
+    return name;
+  }
+  if (!name.starts_with('/')) {
+    // root is a prefix of the name of another directory
+    return file_name;
+  }
+  return name.substr(1);
+}
 
 // _____________________________________________________________________________
-void GrepOutput::add(
-    std::pair<std::string, std::vector<Grep::Match>> partial_result) {
-  INLINE_BENCHMARK_WALL_START(_, "output");
+void GrepOutput::write_file_name(const std::string& file_name) {
+  std::string_view name =
+      _single_file_name.empty()
+          ? relative_name(file_name, _options.display_root)
+          : std::string_view(_single_file_name);
+  std::string out;
   if (_options.color == Grep::Color::ON) {
-    colored(partial_result);
+    out.append(MAGENTA).append(name).append(COLOR_RESET);
+  } else {
+    out.append(name);
+  }
+  out.push_back('\n');
+  _sink.write(out);
+  _lines_written++;
+}
+
+// _____________________________________________________________________________
+void GrepOutput::format(const Grep::PartialResult& partial_result,
+                        std::string* out) const {
+  INLINE_BENCHMARK_WALL_START(_, "format");
+  if (_context) {
+    format_context(partial_result, out);
+  } else if (_options.color == Grep::Color::ON) {
+    colored(partial_result, out);
   } else {
-    uncolored(partial_result);
+    uncolored(partial_result, out);
   }
 }
 
-void GrepOutput::colored(
-    std::pair<std::string, std::vector<Grep::Match>>& partial_result) {
-  for (auto& r : partial_result.second) {
+// _____________________________________________________________________________
+void GrepOutput::colored(const Grep::PartialResult& partial_result,
+                         std::string* out) const {
+  partial_result.for_each_file([&](const std::string& file_name, size_t begin,
+                                   size_t end) {
+    auto name = relative_name(file_name, _options.display_root);
+    for (size_t m = begin; m < end; ++m) {
+      const auto& r = partial_result.matches[m];
+      std::string_view match = partial_result.str(r);
+      if (_options.print_file_path) {
+        out->append(MAGENTA).append(name);
+        out->append(CYAN ":" COLOR_RESET);
+      }
+      if (_options.line_number) {
+        out->append(GREEN);
+        append_int(out, r.line_number);
+        out->append(CYAN ":" COLOR_RESET);
+      }
+      if (_options.byte_offset) {
+        out->append(GREEN);
+        append_int(out, r.byte_position);
+        out->append(CYAN ":" COLOR_RESET);
+      }
+      if (_options.only_matching) {
+        out->append(RED).append(match).append(COLOR_RESET "\n");
+      } else {
+        append_highlighted_(partial_result, r, out);
+      }
+    }
+  });
+}
+
+// _____________________________________________________________________________
+void GrepOutput::uncolored(const Grep::PartialResult& partial_result,
+                           std::string* out) const {
+  // matched bytes + '\n' + some bytes for line numbers/byte offsets per line
+  out->reserve(partial_result.buffer.size() +
+               partial_result.matches.size() * 24);
+  partial_result.for_each_file([&](const std::string& file_name, size_t begin,
+                                   size_t end) {
+    auto name = relative_name(file_name, _options.display_root);
     if (_options.print_file_path) {
-      _ostream << MAGENTA << partial_result.first << CYAN << ':' << COLOR_RESET;
+      out->reserve(out->size() + (end - begin) * name.size());
     }
-    if (_options.line_number) {
-      _ostream << GREEN << r.line_number << CYAN << ':' << COLOR_RESET;
+    for (size_t m = begin; m < end; ++m) {
+      const auto& r = partial_result.matches[m];
+      if (_options.print_file_path) {
+        out->append(name).push_back(':');
+      }
+      if (_options.line_number) {
+        append_int(out, r.line_number);
+        out->push_back(':');
+      }
+      if (_options.byte_offset) {
+        append_int(out, r.byte_position);
+        out->push_back(':');
+      }
+      out->append(partial_result.str(r)).push_back('\n');
     }
-    if (_options.byte_offset) {
-      _ostream << GREEN << r.byte_position << CYAN << ':' << COLOR_RESET;
+  });
+}
+
+// _____________________________________________________________________________
+void GrepOutput::format_context(const Grep::PartialResult& partial_result,
+                                std::string* out) const {
+  out->reserve(partial_result.buffer.size() +
+               partial_result.matches.size() * 24);
+  bool written = false;
+  const std::string* last_file = nullptr;
+  int64_t last_end = -1;
+  partial_result.for_each_file([&](const std::string& file_name, size_t begin,
+                                   size_t end) {
+    for (size_t m = begin; m < end; ++m) {
+      const auto& r = partial_result.matches[m];
+      if (r.context != 0 && (r.context & Grep::CONTEXT_LINE) == 0) {
+        // lines at the borders of the chunk are written by join_context()
+        continue;
+      }
+      if (written && (*last_file != file_name || r.byte_position != last_end)) {
+        append_group_separator(out);
+      }
+      append_prefix(file_name, r.line_number, r.byte_position,
+                    r.context == 0 ? ':' : '-', out);
+      if (r.context == 0 && _options.color == Grep::Color::ON) {
+        append_highlighted_(partial_result, r, out);
+      } else {
+        out->append(partial_result.str(r)).push_back('\n');
+      }
+      written = true;
+      last_file = &file_name;
+      last_end = next_line_(r);
     }
-    if (_options.only_matching) {
-      _ostream << RED << r.match << COLOR_RESET << '\n';
+  });
+}
+
+// _____________________________________________________________________________
+void GrepOutput::append_prefix(const std::string& file_name,
+                               int64_t line_number, int64_t byte_position,
+                               char separator, std::string* out) const {
+  bool color = _options.color == Grep::Color::ON;
+  auto append_separator = [&]() {
+    if (color) {
+      out->append(CYAN).push_back(separator);
+      out->append(COLOR_RESET);
     } else {
-      // search for every occurrence of pattern within the string and
-      // print it out colored while the rest is printed uncolored.
-      size_t shift = 0;
-      size_t match_size = _options.pattern.size();
-      while (true) {
-        size_t match_pos;
-        if (xs::utils::use_str_as_regex(_options.pattern) ||
-            (_options.locale == Grep::Locale::UTF_8 && _options.ignore_case)) {
-          re2::RE2 re_pattern(
-              '(' +
-              std::string(_options.fixed_string
-                              ? xs::utils::str::escaped(_options.pattern)
-                              : _options.pattern) +
-              ')');
-          re2::StringPiece input(r.match.data() + shift,
-                                 r.match.size() - shift);
-          re2::StringPiece re_match;
-          auto tmp = re2::RE2::PartialMatch(input, re_pattern, &re_match);
-          if (tmp) {
-            match_pos = re_match.data() - input.data() + shift;
-            match_size = re_match.size();
-          } else {
-            break;
-          }
-        } else {
-          const char* match;
-          if (_options.ignore_case) {
-            match = xs::search::simd::strcasestr(
-                r.match.data() + shift, r.match.size() - shift,
-                _options.pattern.data(), _options.pattern.size());
-          } else {
-            match = xs::search::simd::strstr(
-                r.match.data() + shift, r.match.size() - shift,
-                _options.pattern.data(), _options.pattern.size());
-          }
-          if (match == nullptr) {
-            break;
-          }
-          match_pos = match - r.match.data();
-        }
-        // print string part uncolored (eq. pythonic substr is
-        //  str[shift:match_pos]) and pattern in RED
-        _ostream << std::string(
-                        r.match.begin() + static_cast<int64_t>(shift),
-                        r.match.begin() + static_cast<int64_t>(match_pos))
-                 << RED << std::string(r.match.data() + match_pos, match_size)
-                 << COLOR_RESET;
-        // start next search at new shift
-        shift = match_pos + match_size;
-        if (shift >= r.match.size()) {
-          break;
+      out->push_back(separator);
+    }
+  };
+  if (_options.print_file_path) {
+    out->append(color ? MAGENTA : "")
+        .append(relative_name(file_name, _options.display_root));
+    append_separator();
+  }
+  if (_options.line_number) {
+    out->append(color ? GREEN : "");
+    append_int(out, line_number);
+    append_separator();
+  }
+  if (_options.byte_offset) {
+    out->append(color ? GREEN : "");
+    append_int(out, byte_position);
+    append_separator();
+  }
+}
+
+// _____________________________________________________________________________
+void GrepOutput::append_group_separator(std::string* out) const {
+  if (_options.color == Grep::Color::ON) {
+    out->append(CYAN "--" COLOR_RESET "\n");
+  } else {
+    out->append("--\n");
+  }
+}
+
+// _____________________________________________________________________________
+void GrepOutput::chunk_context(const Grep::PartialResult& partial_result,
+                               ChunkContext* context) {
+  context->before_missing = partial_result.before_missing;
+  context->after_missing = partial_result.after_missing;
+  partial_result.for_each_file([&](const std::string& file_name, size_t begin,
+                                   size_t end) {
+    for (size_t m = begin; m < end; ++m) {
+      const auto& r = partial_result.matches[m];
+      if (r.context == 0 || (r.context & Grep::CONTEXT_LINE) != 0) {
+        if (context->first_position < 0) {
+          context->first_file = file_name;
+          context->first_position = r.byte_position;
         }
+        context->last_file = file_name;
+        context->last_end = next_line_(r);
+      }
+      if ((r.context & Grep::HEAD_LINE) != 0) {
+        context->head.push_back({file_name, partial_result.to_match(r)});
+      }
+      if ((r.context & Grep::TAIL_LINE) != 0) {
+        context->tail.push_back({file_name, partial_result.to_match(r)});
       }
-      // print rest of the string (eq. pythonic substr is str[shift:])
-      _ostream << std::string(r.match.begin() + static_cast<int64_t>(shift),
-                              r.match.end())
-               << '\n';
     }
-  }
+  });
 }
 
-void GrepOutput::uncolored(
-    std::pair<std::string, std::vector<Grep::Match>>& partial_result) {
-  for (auto& r : partial_result.second) {
-    if (_options.print_file_path) {
-      _ostream << partial_result.first << ':';
+// _____________________________________________________________________________
+void GrepOutput::join_context(const ChunkContext& context, std::string* out) {
+  bool has_lines = context.first_position >= 0;
+  // trailing context of the last selected line of the previous chunks
+  for (const auto& line : context.head) {
+    int64_t position = line.line.byte_position;
+    if (_after_remaining == 0 || line.file_name != _written_file ||
+        (has_lines && line.file_name == context.first_file &&
+         position >= context.first_position)) {
+      break;
     }
-    if (_options.line_number) {
-      _ostream << r.line_number << ':';
+    if (position < _written_end) {
+      continue;
     }
-    if (_options.byte_offset) {
-      _ostream << r.byte_position << ':';
+    if (position != _written_end) {
+      break;
+    }
+    append_context_line(line, out);
+    _after_remaining--;
+  }
+  // leading context of the first selected line located in previous chunks
+  if (has_lines && context.before_missing > 0 && !_recent_lines.empty() &&
+      _recent_lines.back().file_name == context.first_file &&
+      next_line_(_recent_lines.back().line) == context.first_position) {
+    size_t n = std::min(context.before_missing, _recent_lines.size());
+    for (auto it = _recent_lines.end() - static_cast<int64_t>(n);
+         it != _recent_lines.end(); ++it) {
+      if (!_written || it->file_name != _written_file ||
+          it->line.byte_position >= _written_end) {
+        append_context_line(*it, out);
+      }
+    }
+  }
+  if (has_lines) {
+    if (_written && (context.first_file != _written_file ||
+                     context.first_position != _written_end)) {
+      append_group_separator(out);
+    }
+    _written = true;
+    _written_file = context.last_file;
+    _written_end = context.last_end;
+    _after_remaining = context.after_missing;
+  }
+  // the last lines are the leading context of the next chunks
+  for (const auto& line : context.tail) {
+    if (!_recent_lines.empty() &&
+        (_recent_lines.back().file_name != line.file_name ||
+         next_line_(_recent_lines.back().line) != line.line.byte_position)) {
+      _recent_lines.clear();
+    }
+    _recent_lines.push_back(line);
+    if (static_cast<int64_t>(_recent_lines.size()) >
+        std::max<int64_t>(_options.before_context, 0)) {
+      _recent_lines.pop_front();
     }
-    _ostream << r.match << '\n';
   }
 }
 
-// ===== GrepContainer =========================================================
-void GrepContainer::add(
-    std::pair<std::string, std::vector<Grep::Match>> partial_result,
-    uint64_t id) {
-  std::unique_lock lock(*this->_mutex);
-  if (_current_index == id) {
-    add(std::move(partial_result));
-    _current_index++;
-    // check if buffered results can be added now
-    while (true) {
-      auto search = _buffer.find(_current_index);
-      if (search == _buffer.end()) {
-        break;
+// _____________________________________________________________________________
+void GrepOutput::append_context_line(const ChunkContext::Line& line,
+                                     std::string* out) {
+  if (_written && (line.file_name != _written_file ||
+                   line.line.byte_position != _written_end)) {
+    append_group_separator(out);
+  }
+  append_prefix(line.file_name, line.line.line_number, line.line.byte_position,
+                '-', out);
+  out->append(line.line.match).push_back('\n');
+  _written = true;
+  _written_file = line.file_name;
+  _written_end = next_line_(line.line);
+}
+
+// ===== GrepVisitor ===========================================================
+// _____________________________________________________________________________
+GrepVisitor::GrepVisitor(Grep::visitor visitor, int64_t max_count,
+                         size_t max_memory,
+                         std::shared_ptr<Cancellation> cancellation)
+    : _visitor(std::move(visitor)),
+      _max_count(max_count),
+      _cancellation(std::move(cancellation)),
+      _sequencer(
+          max_pending,
+          [this](uint64_t, Grep::PartialResult partial_result) {
+            add(std::move(partial_result));
+          },
+          max_memory) {}
+
+// _____________________________________________________________________________
+void GrepVisitor::add(Grep::PartialResult partial_result, uint64_t id) {
+  size_t bytes = partial_result.buffer.size() +
+                 partial_result.matches.size() * sizeof(Grep::MatchRef);
+  // visited in order by the writer thread of the sequencer (blocks if the
+  //  results waiting for it exceed max_memory)
+  _sequencer.publish(id, std::move(partial_result), bytes);
+}
+
+// _____________________________________________________________________________
+size_t GrepVisitor::size() const {
+  _sequencer.flush();
+  return _num_matches;
+}
+
+// _____________________________________________________________________________
+void GrepVisitor::finish() { _sequencer.close(); }
+
+// _____________________________________________________________________________
+void GrepVisitor::abort() { _sequencer.abort(); }
+
+// _____________________________________________________________________________
+void GrepVisitor::add(Grep::PartialResult partial_result) {
+  if (_stopped) {
+    return;
+  }
+  _line_numbers.resolve(&partial_result);
+  _views.clear();
+  partial_result.for_each_file([&](const std::string& file_name, size_t begin,
+                                   size_t end) {
+    if (file_name != _file_name) {
+      _file_name = file_name;
+      _file_matches = 0;
+    }
+    if (_max_count >= 0) {
+      uint64_t left = static_cast<uint64_t>(_max_count) - _file_matches;
+      if (end - begin >= left) {
+        end = begin + left;
+        if (_cancellation != nullptr) {
+          _cancellation->cancel_file(file_name);
+        }
       }
-      add(std::move(search->second));
-      _buffer.erase(_current_index);
-      _current_index++;
     }
-    // at least one partial_result was added -> notify
-    this->_cv->notify_one();
-  } else {
-    // buffer the partial result
-    _buffer.insert({id, std::move(partial_result)});
+    _file_matches += end - begin;
+    for (size_t m = begin; m < end; ++m) {
+      const auto& match = partial_result.matches[m];
+      _views.push_back({file_name, match.byte_position, match.line_number,
+                        partial_result.str(match)});
+    }
+  });
+  if (_views.empty()) {
+    return;
+  }
+  _num_matches += _views.size();
+  bool proceed = false;
+  try {
+    proceed = _visitor(_views);
+  } catch (...) {
+    _stopped = true;
+    if (_cancellation != nullptr) {
+      _cancellation->cancel();
+    }
+    throw;
+  }
+  if (!proceed) {
+    _stopped = true;
+    if (_cancellation != nullptr) {
+      _cancellation->cancel();
+    }
   }
 }
 
-void GrepContainer::add(
-    std::pair<std::string, std::vector<Grep::Match>> partial_result) {
-  auto search = _data.find(partial_result.first);
-  if (search == _data.end()) {
-    _data.insert(std::move(partial_result));
-  } else {
-    auto& value_data = _data.at(partial_result.first);
-    value_data.insert(value_data.end(),
-                      std::make_move_iterator(partial_result.second.begin()),
-                      std::make_move_iterator(partial_result.second.end()));
-  }
+// ===== GrepCountContainer ====================================================
+GrepCountContainer::GrepCountContainer(
+    int64_t max_count, std::shared_ptr<Cancellation> cancellation)
+    : _max_count(max_count),
+      _cancellation(std::move(cancellation)),
+      _sequencer(max_pending,
+                 [this](uint64_t, Grep::PartialResult partial_result) {
+                   add(std::move(partial_result));
+                 }) {}
+
+void GrepCountContainer::add(Grep::PartialResult partial_result, uint64_t id) {
+  _sequencer.publish(id, std::move(partial_result));
+}
+
+void GrepCountContainer::add(Grep::PartialResult partial_result) {
+  partial_result.for_each_file(
+      [&](const std::string& file_name, size_t begin, size_t end) {
+        // a file that is split into several chunks has one segment per chunk
+        if (_counts.empty() || _counts.back().first != file_name) {
+          _counts.emplace_back(file_name, 0);
+        }
+        _counts.back().second += end - begin;
+        if (_max_count >= 0 &&
+            _counts.back().second >= static_cast<uint64_t>(_max_count)) {
+          _counts.back().second = static_cast<uint64_t>(_max_count);
+          if (_cancellation != nullptr) {
+            _cancellation->cancel_file(file_name);
+          }
+        }
+      });
 }
 
-size_t GrepContainer::size() const { return _data.size(); }
+size_t GrepCountContainer::size() const {
+  _sequencer.flush();
+  return _counts.size();
+}
+
+std::vector<std::pair<std::string, uint64_t>>
+GrepCountContainer::copyResultSafe() {
+  _sequencer.flush();
+  return _counts;
+}
 
-std::map<std::string, std::vector<Grep::Match>>
-GrepContainer::copyResultSafe() {
-  return _data;
-}
\ No newline at end of file
+void GrepCountContainer::abort() { _sequencer.abort(); }
\ No newline at end of file
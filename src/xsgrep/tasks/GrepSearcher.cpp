@@ -3,151 +3,987 @@
 
 #include <xsearch/utils/InlineBench.h>
 #include <xsgrep/tasks/GrepSearcher.h>
+#include <xsgrep/utils/regex_literals.h>
+#include <xsgrep/utils/search.h>
+
+#include <algorithm>
+#include <cstring>
+#include <tuple>
 
 // ----- Helper function -------------------------------------------------------
 // _____________________________________________________________________________
-std::string get_regex_match_(const char* data, size_t size,
-                             const re2::RE2& pattern) {
+re2::StringPiece get_regex_match_(const char* data, size_t size,
+                                  const re2::RE2& pattern) {
   re2::StringPiece input(data, size);
   re2::StringPiece match;
   re2::RE2::PartialMatch(input, pattern, &match);
-  return match.as_string();
+  return match;
+}
+
+// _____________________________________________________________________________
+/// c is a word constituent (ASCII letter, digit or '_') like for grep -w
+bool is_word_char_(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+// _____________________________________________________________________________
+/// [begin, end) of data (size bytes) is not part of a longer word (line)
+bool bounded_(const char* data, size_t size, size_t begin, size_t end,
+              Grep::Boundary boundary) {
+  if (boundary == Grep::Boundary::LINE) {
+    return (begin == 0 || data[begin - 1] == '\n') &&
+           (end == size || data[end] == '\n');
+  }
+  return (begin == 0 || !is_word_char_(data[begin - 1])) &&
+         (end == size || !is_word_char_(data[end]));
+}
+
+// _____________________________________________________________________________
+/**
+ * The regex matching pattern within boundary. The match of pattern is the
+ *  first group (the third one for words: the characters around the word are
+ *  part of the match since re2 has no look around).
+ */
+std::string wrapped_(const std::string& pattern, Grep::Boundary boundary) {
+  switch (boundary) {
+    case Grep::Boundary::WORD:
+      return "(^|[^[:alnum:]_])(" + pattern + ")([^[:alnum:]_]|$)";
+    case Grep::Boundary::LINE:
+      return "^(" + pattern + ")$";
+    default:
+      return '(' + pattern + ')';
+  }
+}
+
+// _____________________________________________________________________________
+size_t line_end_(const xs::DataChunk* data, size_t local_offset) {
+  auto* end = static_cast<const char*>(std::memchr(
+      data->data() + local_offset, '\n', data->size() - local_offset));
+  return end == nullptr ? data->size() : end - data->data();
+}
+
+// _____________________________________________________________________________
+/// number of lines of data[begin, end) (the last line may lack its new line)
+size_t num_lines_(const xs::DataChunk* data, size_t begin, size_t end) {
+  if (begin >= end) {
+    return 0;
+  }
+  return count_new_lines(data->data() + begin, end - begin) +
+         (data->data()[end - 1] == '\n' ? 0 : 1);
+}
+
+// _____________________________________________________________________________
+/**
+ * The lines of the regions [begin, end) that are not covered by the sorted
+ *  line spans, i.e. the lines selected by an inverted search. The gaps
+ *  between matching lines are found from the spans alone: only the gaps are
+ *  split into lines (by memchr), unless join is set, in which case every gap
+ *  is returned as one span holding its lines separated by new lines.
+ */
+std::vector<std::pair<size_t, size_t>> inverted_spans_(
+    const xs::DataChunk* data,
+    const std::vector<std::pair<size_t, size_t>>& regions,
+    const std::vector<std::pair<size_t, size_t>>& spans, bool join) {
+  const char* begin = data->data();
+  std::vector<std::pair<size_t, size_t>> selected;
+  // add the lines [first, last): last is the end of the last line
+  auto add_lines = [&](size_t first, size_t last) {
+    if (join) {
+      selected.emplace_back(first, last - first);
+      return;
+    }
+    while (true) {
+      const void* new_line = std::memchr(begin + first, '\n', last - first);
+      if (new_line == nullptr) {
+        selected.emplace_back(first, last - first);
+        return;
+      }
+      size_t end = static_cast<const char*>(new_line) - begin;
+      selected.emplace_back(first, end - first);
+      first = end + 1;
+    }
+  };
+  auto span = spans.begin();
+  for (auto [region_begin, region_end] : regions) {
+    // skip spans before the region (new line separators of packed files)
+    while (span != spans.end() && span->first < region_begin) {
+      span++;
+    }
+    size_t position = region_begin;
+    for (; span != spans.end() && span->first < region_end; ++span) {
+      if (span->first > position) {
+        // the lines up to the new line preceding the matching line
+        add_lines(position, span->first - 1);
+      }
+      position = span->first + span->second + 1;
+    }
+    if (position < region_end) {
+      add_lines(position, begin[region_end - 1] == '\n' ? region_end - 1
+                                                          : region_end);
+    }
+  }
+  return selected;
+}
+
+// _____________________________________________________________________________
+/**
+ * Copy the byte ranges (local offset, size) of data into the buffer of result
+ *  and create the corresponding MatchRefs. The buffer is allocated once for
+ *  all matches of the chunk.
+ */
+void fill_result_(const xs::DataChunk* data,
+                  const std::vector<std::pair<size_t, size_t>>& spans,
+                  Grep::PartialResult* result) {
+  size_t total_size = 0;
+  for (const auto& span : spans) {
+    total_size += span.second;
+  }
+  result->buffer.reserve(total_size);
+  result->matches.resize(spans.size());
+  for (size_t i = 0; i < spans.size(); ++i) {
+    result->matches[i].offset = result->buffer.size();
+    result->matches[i].size = spans[i].second;
+    result->buffer.append(data->data() + spans[i].first, spans[i].second);
+  }
+}
+
+// _____________________________________________________________________________
+/**
+ * Case-insensitive equivalent of xs::search::global_byte_offsets_match that
+ *  searches the chunk in place (pattern must be lower case).
+ */
+std::vector<uint64_t> global_byte_offsets_match_icase_(
+    const xs::DataChunk* data, const std::string& pattern, bool skip_to_nl) {
+  std::vector<uint64_t> byte_offsets;
+  const char* begin = data->data();
+  const char* end = data->data() + data->size();
+  const char* shift = begin;
+  while (shift < end) {
+    const char* match = find_icase(shift, end - shift, pattern.data(),
+                                   pattern.size());
+    if (match == nullptr) {
+      break;
+    }
+    byte_offsets.push_back(data->getMetaData().actual_offset + (match - begin));
+    if (skip_to_nl) {
+      // continue searching in the next line
+      shift = static_cast<const char*>(std::memchr(match, '\n', end - match));
+      if (shift == nullptr) {
+        break;
+      }
+      shift++;
+    } else {
+      shift = match + (pattern.empty() ? 1 : pattern.size());
+    }
+  }
+  return byte_offsets;
 }
 
 // ===== GrepSearcher ==========================================================
 // _____________________________________________________________________________
 GrepSearcher::GrepSearcher(std::string pattern, bool byte_offset,
                            bool line_number, bool only_matching, bool regex,
-                           bool ignore_case, Grep::Locale locale)
-    : _pattern(std::move(pattern)),
-      _line_number(line_number),
+                           bool ignore_case, Grep::Locale locale,
+                           Grep::Boundary boundary)
+    : GrepSearcher(std::vector<std::string>{std::move(pattern)}, byte_offset,
+                   line_number, only_matching, regex, ignore_case, locale,
+                   boundary) {}
+
+// _____________________________________________________________________________
+GrepSearcher::GrepSearcher(std::vector<std::string> patterns,
+                           bool byte_offset, bool line_number,
+                           bool only_matching, bool regex, bool ignore_case,
+                           Grep::Locale locale, Grep::Boundary boundary)
+    : _line_number(line_number),
       _byte_offset(byte_offset),
       _only_matching(only_matching),
       _regex(regex),
       _ignore_case(ignore_case),
-      _locale(locale) {
+      _locale(locale),
+      _boundary(boundary) {
+  if (patterns.empty()) {
+    _no_patterns = true;
+    return;
+  }
+  if (patterns.size() != 1) {
+    if (!_regex && !(_ignore_case && _locale != Grep::Locale::ASCII)) {
+      _multi = std::make_shared<MultiLiteral>(patterns, _ignore_case);
+      return;
+    }
+    // one regular expression matching any of the patterns
+    for (auto& pattern : patterns) {
+      if (!_regex) {
+        pattern = xs::utils::str::escaped(pattern);
+      }
+      _pattern.append(_pattern.empty() ? "" : "|").append(pattern);
+    }
+  } else {
+    _pattern = std::move(patterns.front());
+  }
+  if (_ignore_case) {
+    _pattern_lower.resize(_pattern.size());
+    std::transform(_pattern.begin(), _pattern.end(), _pattern_lower.begin(),
+                   to_lower_ascii);
+  }
   if (regex) {
     re2::RE2::Options re2_options;
     re2_options.set_posix_syntax(true);
     re2_options.set_case_sensitive(!_ignore_case);
-    _re_pattern = std::make_unique<re2::RE2>('(' + _pattern + ')', re2_options);
+    _re_pattern = std::make_shared<re2::RE2>(wrapped_(_pattern, _boundary),
+                                             re2_options);
+    // lines without any literal required by the pattern are not passed to
+    //  re2 (literals are only case folded for ASCII)
+    if (!_ignore_case || _locale == Grep::Locale::ASCII) {
+      auto literals =
+          required_literals(_pattern, _ignore_case, &_literals_exact);
+      if (!literals.empty()) {
+        _required_literals =
+            std::make_shared<MultiLiteral>(literals, _ignore_case);
+      }
+      // the boundary is only checked by re2
+      _literals_exact = _literals_exact && _boundary == Grep::Boundary::NONE;
+    }
   } else if (_ignore_case && _locale != Grep::Locale::ASCII) {
     // not regex, but ignore case and not ascii: use re2 and implicitly assume
     // pattern to be UTF-8
     re2::RE2::Options re2_options;
     re2_options.set_case_sensitive(false);
-    auto escaped_pattern = xs::utils::str::escaped(_pattern);
-    _re_pattern =
-        std::make_unique<re2::RE2>('(' + escaped_pattern + ')', re2_options);
+    // ^ and $ of the boundary match at every line
+    re2_options.set_posix_syntax(true);
+    // several patterns were escaped and combined already
+    auto escaped_pattern =
+        patterns.size() == 1 ? xs::utils::str::escaped(_pattern) : _pattern;
+    _re_pattern = std::make_shared<re2::RE2>(
+        wrapped_(escaped_pattern, _boundary), re2_options);
   }
 }
 
 // _____________________________________________________________________________
-std::pair<std::string, std::vector<Grep::Match>> GrepSearcher::process(
-    const xs::DataChunk* data) const {
+Grep::PartialResult GrepSearcher::process(const xs::DataChunk* data) const {
   INLINE_BENCHMARK_WALL_START(_, "search");
-  if (_regex || (_ignore_case && _locale != Grep::Locale::ASCII)) {
-    return process_regex(data);
+  Grep::PartialResult res;
+  res.file_name = data->get_file_name();
+  std::optional<std::vector<ChunkFile>> files;
+  if (_chunk_files != nullptr) {
+    files = _chunk_files->extract(data->getMetaData().chunk_index);
+  }
+  if (_cancellation != nullptr &&
+      (_cancellation->cancelled() ||
+       (files.has_value() &&
+        std::all_of(files->begin(), files->end(), [&](const ChunkFile& f) {
+          return _cancellation->file_cancelled(f.file_name);
+        })))) {
+    // nothing to do: return an empty result
+    return res;
+  }
+
+  bool regex = _regex || (_ignore_case && _locale != Grep::Locale::ASCII);
+  std::vector<std::pair<size_t, size_t>> spans;
+  if (!_no_patterns) {
+    spans = regex ? search_regex(data) : search_plain(data);
+  }
+  bool context = _context && !_only_matching && !_count_only;
+  // byte positions are always known for regex searches (context lines of
+  //  neighbouring chunks are joined by their byte positions)
+  bool byte_position = regex || _byte_offset || context;
+  if (_count_only) {
+    if (!files.has_value() || files->front().line_mapping) {
+      // all lines of the chunk belong to one file
+      size_t count = _invert ? num_lines_(data, 0, data->size()) - spans.size()
+                             : spans.size();
+      res.segments.push_back({files.has_value() ? files->front().file_name
+                                                : res.file_name,
+                              count, 0});
+    } else {
+      count_file_matches(data, *files, spans, &res);
+    }
+    return res;
+  }
+  // [begin, end) of the data of every file in the chunk
+  std::vector<std::pair<size_t, size_t>> regions;
+  if (files.has_value() && !files->empty() && !files->front().line_mapping) {
+    for (const auto& file : *files) {
+      regions.emplace_back(file.chunk_offset, file.chunk_offset + file.size);
+    }
+  } else {
+    regions.emplace_back(0, data->size());
+  }
+  if (_invert) {
+    spans = inverted_spans_(
+        data, regions, spans,
+        _join_lines && !_line_number && !_byte_offset && !context);
+  }
+  std::vector<uint8_t> context_flags;
+  if (context) {
+    add_context(data, regions, &spans, &context_flags, &res);
+  }
+  if (files.has_value() && !files->empty() && files->front().line_mapping) {
+    // chunk of a preprocessed file: positions are known from its metadata
+    fill_result_(data, spans, &res);
+    set_positions(data, spans, data->getMetaData().original_offset,
+                  byte_position, &res);
+    res.segments.push_back({files->front().file_name, res.matches.size(), 0});
+  } else if (files.has_value()) {
+    set_file_segments(data, *files, &spans, byte_position, &res);
+  } else if (_line_number && data->getMetaData().line_mapping_data.empty()) {
+    // no line mapping (no metafile): lines are counted lazily
+    set_relative_positions(data, spans, data->getMetaData().original_offset,
+                           byte_position, &res);
+  } else {
+    fill_result_(data, spans, &res);
+    // the chunks of preprocessed files are not stored in order: only the
+    //  original offset is the position within the searched file
+    set_positions(data, spans, data->getMetaData().original_offset,
+                  byte_position, &res);
   }
-  return process_plain(data);
+  for (size_t i = 0; i < context_flags.size() && i < res.matches.size(); ++i) {
+    res.matches[i].context = context_flags[i];
+  }
+  if (_highlight && !_only_matching && !_invert) {
+    add_highlights(&res);
+  }
+  return res;
+}
+
+// _____________________________________________________________________________
+GrepSearcher& GrepSearcher::set_highlight(bool val) {
+  _highlight = val;
+  return *this;
+}
+
+// _____________________________________________________________________________
+GrepSearcher& GrepSearcher::set_chunk_files(
+    std::shared_ptr<ChunkFileTable> chunk_files) {
+  _chunk_files = std::move(chunk_files);
+  return *this;
+}
+
+// _____________________________________________________________________________
+GrepSearcher& GrepSearcher::set_count_only(bool val) {
+  _count_only = val;
+  return *this;
 }
 
 // _____________________________________________________________________________
-std::pair<std::string, std::vector<Grep::Match>> GrepSearcher::process_regex(
+GrepSearcher& GrepSearcher::set_invert_match(bool val, bool join_lines) {
+  _invert = val;
+  _join_lines = join_lines;
+  return *this;
+}
+
+// _____________________________________________________________________________
+GrepSearcher& GrepSearcher::set_cancellation(
+    std::shared_ptr<Cancellation> cancellation) {
+  _cancellation = std::move(cancellation);
+  return *this;
+}
+
+// _____________________________________________________________________________
+GrepSearcher& GrepSearcher::set_context(size_t before, size_t after) {
+  _context = true;
+  _before_context = before;
+  _after_context = after;
+  return *this;
+}
+
+// _____________________________________________________________________________
+std::vector<std::pair<size_t, size_t>> GrepSearcher::search_regex(
     const xs::DataChunk* data) const {
+  if (_required_literals != nullptr || _boundary == Grep::Boundary::WORD) {
+    // the x-search searches take the first group as the match
+    return search_regex_prefiltered(data);
+  }
   std::vector<uint64_t> byte_offsets =
       _only_matching
           ? xs::search::regex::global_byte_offsets_match(data, *_re_pattern,
                                                          false)
           : xs::search::regex::global_byte_offsets_line(data, *_re_pattern);
-  std::vector<uint64_t> line_numbers;
-  if (_line_number) {
-    line_numbers = xs::map::bytes::to_line_indices(data, byte_offsets);
-    std::transform(line_numbers.begin(), line_numbers.end(),
-                   line_numbers.begin(), [](uint64_t li) { return li + 1; });
-  }
-  std::vector<std::string> lines;
+  std::vector<std::pair<size_t, size_t>> spans(byte_offsets.size());
   if (_only_matching) {
-    lines.resize(byte_offsets.size());
-    std::transform(byte_offsets.begin(), byte_offsets.end(), lines.begin(),
+    std::transform(byte_offsets.begin(), byte_offsets.end(), spans.begin(),
                    [&](uint64_t index) {
                      size_t local_byte_offset =
                          index - data->getMetaData().original_offset;
-                     return get_regex_match_(data->data() + local_byte_offset,
-                                             data->size() - local_byte_offset,
-                                             *_re_pattern);
+                     auto match = get_regex_match_(
+                         data->data() + local_byte_offset,
+                         data->size() - local_byte_offset, *_re_pattern);
+                     return std::make_pair(
+                         static_cast<size_t>(match.data() - data->data()),
+                         match.size());
+                   });
+  } else {
+    std::transform(byte_offsets.begin(), byte_offsets.end(), spans.begin(),
+                   [data](uint64_t index) {
+                     size_t local_byte_offset =
+                         index - data->getMetaData().original_offset;
+                     return std::make_pair(
+                         local_byte_offset,
+                         line_end_(data, local_byte_offset) -
+                             local_byte_offset);
+                   });
+  }
+  return spans;
+}
+
+// _____________________________________________________________________________
+std::vector<std::pair<size_t, size_t>> GrepSearcher::search_plain(
+    const xs::DataChunk* data) const {
+  if (_boundary != Grep::Boundary::NONE) {
+    return search_bounded(data);
+  }
+  if (_multi != nullptr) {
+    return search_multi(data);
+  }
+  // case-insensitive searches run on the original data (no lower case copy)
+  std::vector<uint64_t> byte_offsets_match =
+      _ignore_case ? global_byte_offsets_match_icase_(data, _pattern_lower,
+                                                      !_only_matching)
+                   : xs::search::global_byte_offsets_match(data, _pattern,
+                                                           !_only_matching);
+  std::vector<std::pair<size_t, size_t>> spans(byte_offsets_match.size());
+  if (_only_matching) {
+    std::transform(byte_offsets_match.begin(), byte_offsets_match.end(),
+                   spans.begin(), [&](uint64_t index) {
+                     return std::make_pair(
+                         index - data->getMetaData().actual_offset,
+                         _pattern.size());
                    });
   } else {
-    lines.resize(byte_offsets.size());
     std::transform(
-        byte_offsets.begin(), byte_offsets.end(), lines.begin(),
-        [data](uint64_t index) { return xs::map::byte::to_line(data, index); });
+        byte_offsets_match.begin(), byte_offsets_match.end(), spans.begin(),
+        [data](uint64_t index) {
+          size_t local_byte_offset =
+              index - data->getMetaData().actual_offset -
+              xs::search::previous_new_line_offset_relative_to_match(
+                  data, index - data->getMetaData().actual_offset);
+          return std::make_pair(
+              local_byte_offset,
+              line_end_(data, local_byte_offset) - local_byte_offset);
+        });
   }
+  return spans;
+}
 
-  std::vector<Grep::Match> res(byte_offsets.size());
-  for (uint64_t i = 0; i < byte_offsets.size(); ++i) {
-    res[i].line_number =
-        _line_number ? static_cast<int64_t>(line_numbers[i]) : -1;
-    res[i].byte_position = static_cast<int64_t>(byte_offsets[i]);
-    res[i].match = lines[i];
+// _____________________________________________________________________________
+std::vector<std::pair<size_t, size_t>> GrepSearcher::search_multi(
+    const xs::DataChunk* data) const {
+  std::vector<std::pair<size_t, size_t>> spans;
+  const char* begin = data->data();
+  size_t size = data->size();
+  size_t shift = 0;
+  while (shift < size) {
+    auto match = _multi->find(begin + shift, size - shift);
+    if (!match.has_value()) {
+      break;
+    }
+    size_t offset = shift + match->offset;
+    if (_only_matching) {
+      // empty matches are not written (like grep -o)
+      if (match->size > 0) {
+        spans.emplace_back(offset, match->size);
+      }
+      shift = offset + std::max<size_t>(match->size, 1);
+      continue;
+    }
+    // shift always is the start of a line: search the line start from there
+    const void* new_line = ::memrchr(begin + shift, '\n', offset - shift);
+    size_t line_begin =
+        new_line == nullptr
+            ? shift
+            : static_cast<size_t>(static_cast<const char*>(new_line) - begin) +
+                  1;
+    size_t line_end = line_end_(data, offset);
+    spans.emplace_back(line_begin, line_end - line_begin);
+    // continue searching in the next line
+    shift = line_end + 1;
   }
-  return {data->get_file_name(), res};
+  return spans;
 }
 
 // _____________________________________________________________________________
-std::pair<std::string, std::vector<Grep::Match>> GrepSearcher::process_plain(
+std::vector<std::pair<size_t, size_t>> GrepSearcher::search_regex_prefiltered(
     const xs::DataChunk* data) const {
-  xs::DataChunk tmp_chunk;
-  const xs::DataChunk* op_chunk = data;
-  std::string pattern = _pattern;
-  if (_ignore_case) {
-    tmp_chunk = xs::DataChunk(*data);
-    xs::utils::str::simd::toLower(tmp_chunk.data(), tmp_chunk.size());
-    op_chunk = &tmp_chunk;
-    std::transform(_pattern.begin(), _pattern.end(), pattern.begin(),
-                   ::tolower);
+  std::vector<std::pair<size_t, size_t>> spans;
+  const char* begin = data->data();
+  size_t size = data->size();
+  size_t shift = 0;
+  while (shift < size) {
+    size_t offset = 0;
+    if (_required_literals != nullptr) {
+      auto candidate = _required_literals->find(begin + shift, size - shift);
+      if (!candidate.has_value()) {
+        break;
+      }
+      offset = shift + candidate->offset;
+    } else {
+      // ^ and $ match at every line of the chunk (posix syntax)
+      re2::StringPiece match;
+      if (!match_regex({begin, size}, shift, &match)) {
+        break;
+      }
+      offset = match.data() - begin;
+    }
+    // shift always is the start of a line: search the line start from there
+    const void* new_line = ::memrchr(begin + shift, '\n', offset - shift);
+    size_t line_begin =
+        new_line == nullptr
+            ? shift
+            : static_cast<size_t>(static_cast<const char*>(new_line) - begin) +
+                  1;
+    size_t line_end = line_end_(data, offset);
+    // the whole line is passed as text so that anchors are respected
+    re2::StringPiece line(begin + line_begin, line_end - line_begin);
+    if (!_only_matching) {
+      // the line matches if the pattern is just the literals or it was found
+      //  by re2 already, otherwise re2 only runs its DFA (no submatch needed)
+      if (_literals_exact || _required_literals == nullptr ||
+          _re_pattern->Match(line, 0, line.size(), re2::RE2::UNANCHORED,
+                             nullptr, 0)) {
+        spans.emplace_back(line_begin, line.size());
+      }
+    } else {
+      re2::StringPiece match;
+      size_t position = 0;
+      while (position <= line.size() && match_regex(line, position, &match)) {
+        size_t match_offset = match.data() - line.data();
+        if (!match.empty()) {
+          spans.emplace_back(line_begin + match_offset, match.size());
+        }
+        position = match_offset + std::max<size_t>(match.size(), 1);
+      }
+    }
+    // continue searching in the next line
+    shift = line_end + 1;
   }
-  std::vector<uint64_t> byte_offsets_match =
-      xs::search::global_byte_offsets_match(op_chunk, pattern, !_only_matching);
-  std::vector<uint64_t> byte_offsets_line;
+  return spans;
+}
+
+// _____________________________________________________________________________
+std::vector<std::pair<size_t, size_t>> GrepSearcher::search_bounded(
+    const xs::DataChunk* data) const {
+  std::vector<std::pair<size_t, size_t>> spans;
+  const char* begin = data->data();
+  size_t size = data->size();
+  size_t shift = 0;
+  while (shift < size) {
+    auto match = find_literal(begin + shift, size - shift);
+    if (!match.has_value()) {
+      break;
+    }
+    size_t offset = shift + match->offset;
+    auto match_size = bounded_match(begin, size, offset, match->size);
+    if (!match_size.has_value()) {
+      // a later occurrence may be a word of its own, a line only matches at
+      //  its start
+      shift = _boundary == Grep::Boundary::LINE ? line_end_(data, offset) + 1
+                                                : offset + 1;
+      continue;
+    }
+    if (_only_matching) {
+      if (*match_size > 0) {
+        spans.emplace_back(offset, *match_size);
+      }
+      shift = offset + std::max<size_t>(*match_size, 1);
+      continue;
+    }
+    const void* new_line = ::memrchr(begin, '\n', offset);
+    size_t line_begin =
+        new_line == nullptr
+            ? 0
+            : static_cast<size_t>(static_cast<const char*>(new_line) - begin) +
+                  1;
+    size_t line_end = line_end_(data, offset);
+    spans.emplace_back(line_begin, line_end - line_begin);
+    // continue searching in the next line
+    shift = line_end + 1;
+  }
+  return spans;
+}
+
+// _____________________________________________________________________________
+std::optional<MultiLiteral::Match> GrepSearcher::find_literal(
+    const char* data, size_t size) const {
+  if (_multi != nullptr) {
+    return _multi->find(data, size);
+  }
+  const char* match =
+      _ignore_case ? find_icase(data, size, _pattern_lower.data(),
+                                _pattern_lower.size())
+                   : xs::search::simd::strstr(data, size, _pattern.data(),
+                                              _pattern.size());
+  if (match == nullptr) {
+    return std::nullopt;
+  }
+  return MultiLiteral::Match{static_cast<size_t>(match - data),
+                             _pattern.size(), 0};
+}
+
+// _____________________________________________________________________________
+std::optional<size_t> GrepSearcher::bounded_match(const char* data,
+                                                  size_t size, size_t offset,
+                                                  size_t match_size) const {
+  if (_boundary == Grep::Boundary::NONE ||
+      bounded_(data, size, offset, offset + match_size, _boundary)) {
+    return match_size;
+  }
+  if (_multi != nullptr) {
+    // e.g. foo of foo and foo-bar is a word of foo-barx
+    for (const auto& match : _multi->matches_at(data, size, offset)) {
+      if (match.size < match_size &&
+          bounded_(data, size, offset, offset + match.size, _boundary)) {
+        return match.size;
+      }
+    }
+  }
+  return std::nullopt;
+}
+
+// _____________________________________________________________________________
+bool GrepSearcher::match_regex(re2::StringPiece text, size_t position,
+                               re2::StringPiece* match) const {
+  size_t group = _boundary == Grep::Boundary::WORD ? 2 : 0;
+  re2::StringPiece groups[3];
+  if (!_re_pattern->Match(text, position, text.size(), re2::RE2::UNANCHORED,
+                          groups, static_cast<int>(group) + 1)) {
+    return false;
+  }
+  *match = groups[group];
+  return true;
+}
+
+// _____________________________________________________________________________
+void GrepSearcher::set_positions(
+    const xs::DataChunk* data,
+    const std::vector<std::pair<size_t, size_t>>& spans, uint64_t base_offset,
+    bool byte_position, Grep::PartialResult* result) const {
+  std::vector<uint64_t> byte_offsets(spans.size());
+  std::transform(
+      spans.begin(), spans.end(), byte_offsets.begin(),
+      [base_offset](const auto& span) { return base_offset + span.first; });
   std::vector<uint64_t> line_numbers;
   if (_line_number) {
-    line_numbers =
-        xs::map::bytes::to_line_indices(op_chunk, byte_offsets_match);
-    std::transform(line_numbers.begin(), line_numbers.end(),
-                   line_numbers.begin(), [](uint64_t li) { return li + 1; });
+    line_numbers = xs::map::bytes::to_line_indices(data, byte_offsets);
   }
-  std::vector<std::string> lines;
-  lines.reserve(byte_offsets_match.size());
-  if (_only_matching) {
-    for (auto bo : byte_offsets_match) {
-      lines.emplace_back(data->data() + bo - data->getMetaData().actual_offset,
-                         _pattern.size());
+  for (size_t i = 0; i < byte_offsets.size(); ++i) {
+    result->matches[i].line_number =
+        _line_number ? static_cast<int64_t>(line_numbers[i] + 1) : -1;
+    result->matches[i].byte_position =
+        byte_position ? static_cast<int64_t>(byte_offsets[i]) : -1;
+  }
+}
+
+// _____________________________________________________________________________
+void GrepSearcher::set_relative_positions(
+    const xs::DataChunk* data,
+    const std::vector<std::pair<size_t, size_t>>& spans, uint64_t base_offset,
+    bool byte_position, Grep::PartialResult* result) const {
+  fill_result_(data, spans, result);
+  // new lines are only counted up to the matches and once for the remaining
+  //  data of the chunk
+  size_t position = 0;
+  int64_t line = 1;
+  for (size_t i = 0; i < spans.size(); ++i) {
+    size_t offset = spans[i].first;
+    line += static_cast<int64_t>(
+        count_new_lines(data->data() + position, offset - position));
+    position = offset;
+    result->matches[i].line_number = line;
+    result->matches[i].byte_position =
+        byte_position ? static_cast<int64_t>(base_offset + offset) : -1;
+  }
+  uint64_t num_lines =
+      line - 1 +
+      count_new_lines(data->data() + position, data->size() - position);
+  result->segments.push_back({result->file_name, spans.size(), num_lines});
+  result->relative_line_numbers = true;
+}
+
+// _____________________________________________________________________________
+void GrepSearcher::count_file_matches(
+    const xs::DataChunk* data, const std::vector<ChunkFile>& files,
+    const std::vector<std::pair<size_t, size_t>>& spans,
+    Grep::PartialResult* result) const {
+  result->segments.reserve(files.size());
+  size_t count = 0;
+  auto span = spans.begin();
+  for (const auto& file : files) {
+    // skip spans before the file (new line separators of packed files)
+    while (span != spans.end() && span->first < file.chunk_offset) {
+      span++;
     }
-  } else {
-    byte_offsets_line.resize(byte_offsets_match.size());
-    std::transform(
-        byte_offsets_match.begin(), byte_offsets_match.end(),
-        byte_offsets_line.begin(), [data](uint64_t index) {
-          return index - xs::search::previous_new_line_offset_relative_to_match(
-                             data, index - data->getMetaData().actual_offset);
-        });
-    lines.resize(byte_offsets_match.size());
-    std::transform(
-        byte_offsets_line.begin(), byte_offsets_line.end(), lines.begin(),
-        [data](uint64_t index) { return xs::map::byte::to_line(data, index); });
-  }
-
-  std::vector<Grep::Match> res(byte_offsets_match.size());
-  for (uint64_t i = 0; i < byte_offsets_match.size(); ++i) {
-    res[i].line_number =
-        _line_number ? static_cast<int64_t>(line_numbers[i]) : -1;
-    res[i].byte_position =
-        _byte_offset
-            ? (_only_matching ? static_cast<int64_t>(byte_offsets_match[i])
-                              : static_cast<int64_t>(byte_offsets_line[i]))
-            : -1;
-    res[i].match = lines[i];
-  }
-  return {data->get_file_name(), res};
+    size_t matching = 0;
+    for (; span != spans.end() && span->first < file.chunk_offset + file.size;
+         span++) {
+      matching++;
+    }
+    // inverted: the lines of the file are counted, nothing is allocated
+    count += _invert ? num_lines_(data, file.chunk_offset,
+                                  file.chunk_offset + file.size) -
+                           matching
+                     : matching;
+    result->segments.push_back({file.file_name, count, 0});
+  }
+}
+
+// _____________________________________________________________________________
+void GrepSearcher::set_file_segments(
+    const xs::DataChunk* data, const std::vector<ChunkFile>& files,
+    std::vector<std::pair<size_t, size_t>>* spans, bool byte_position,
+    Grep::PartialResult* result) const {
+  // assign the spans to the files and drop spans that start outside the data
+  //  of a file (e.g. the new line separators of packed files)
+  std::vector<size_t> file_indices;
+  file_indices.reserve(spans->size());
+  size_t num_spans = 0;
+  size_t f = 0;
+  for (const auto& span : *spans) {
+    while (f + 1 < files.size() && span.first >= files[f + 1].chunk_offset) {
+      f++;
+    }
+    if (f >= files.size() ||
+        span.first >= files[f].chunk_offset + files[f].size) {
+      continue;
+    }
+    (*spans)[num_spans++] = span;
+    file_indices.push_back(f);
+  }
+  spans->resize(num_spans);
+  fill_result_(data, *spans, result);
+
+  result->relative_line_numbers = _line_number;
+  size_t i = 0;
+  for (f = 0; f < files.size(); ++f) {
+    const auto& file = files[f];
+    size_t begin = i;
+    // lines are counted incrementally from the start of the file data
+    size_t position = file.chunk_offset;
+    int64_t line = 1;
+    for (; i < num_spans && file_indices[i] == f; ++i) {
+      size_t offset = (*spans)[i].first;
+      if (_line_number) {
+        line += count_new_lines(data->data() + position, offset - position);
+        position = offset;
+        result->matches[i].line_number = line;
+      }
+      result->matches[i].byte_position =
+          byte_position
+              ? static_cast<int64_t>(offset - file.chunk_offset +
+                                     file.file_offset)
+              : -1;
+    }
+    // files without matches are only kept if they may be continued in the
+    //  next chunk
+    if (i == begin && f + 1 < files.size()) {
+      continue;
+    }
+    uint64_t num_lines = 0;
+    if (_line_number) {
+      num_lines = line - 1 +
+                  count_new_lines(data->data() + position,
+                                  file.chunk_offset + file.size - position);
+    }
+    result->segments.push_back({file.file_name, i, num_lines});
+  }
+}
+
+// _____________________________________________________________________________
+void GrepSearcher::add_highlights(Grep::PartialResult* result) const {
+  for (auto& match : result->matches) {
+    match.highlight_begin = result->highlights.size();
+    if (match.context != 0) {
+      // context lines are not highlighted
+      match.highlight_end = match.highlight_begin;
+      continue;
+    }
+    std::string_view line = result->str(match);
+    size_t shift = 0;
+    while (shift <= line.size()) {
+      size_t pos;
+      size_t size;
+      if (_re_pattern != nullptr) {
+        // the whole line is passed as text so that anchors are respected
+        re2::StringPiece re_match;
+        if (!match_regex({line.data(), line.size()}, shift, &re_match)) {
+          break;
+        }
+        pos = re_match.data() - line.data();
+        size = re_match.size();
+      } else {
+        auto literal_match =
+            find_literal(line.data() + shift, line.size() - shift);
+        if (!literal_match.has_value()) {
+          break;
+        }
+        pos = shift + literal_match->offset;
+        auto bounded_size =
+            bounded_match(line.data(), line.size(), pos, literal_match->size);
+        if (!bounded_size.has_value()) {
+          shift = pos + 1;
+          continue;
+        }
+        size = *bounded_size;
+      }
+      if (size > 0) {
+        result->highlights.push_back({pos, size});
+      }
+      // empty matches do not advance the search by themselves
+      shift = pos + (size > 0 ? size : 1);
+    }
+    match.highlight_end = result->highlights.size();
+  }
+}
+
+// _____________________________________________________________________________
+void GrepSearcher::add_context(
+    const xs::DataChunk* data,
+    const std::vector<std::pair<size_t, size_t>>& regions,
+    std::vector<std::pair<size_t, size_t>>* spans, std::vector<uint8_t>* flags,
+    Grep::PartialResult* result) const {
+  const char* begin = data->data();
+  // (offset, size, flags) of all lines, selected lines have no flags
+  std::vector<std::tuple<size_t, size_t, uint8_t>> lines;
+  lines.reserve(spans->size());
+  auto span = spans->begin();
+  for (size_t r = 0; r < regions.size(); ++r) {
+    auto [region_begin, region_end] = regions[r];
+    // skip spans before the region (new line separators of packed files)
+    while (span != spans->end() && span->first < region_begin) {
+      span++;
+    }
+    // the lines [region_begin, covered) were added already
+    size_t covered = region_begin;
+    bool first = true;
+    for (; span != spans->end() && span->first < region_end; ++span) {
+      // leading context: walk back line by line
+      size_t start = span->first;
+      size_t num_before = 0;
+      while (num_before < _before_context && start > covered) {
+        size_t end = start - 1;
+        const void* new_line = ::memrchr(begin + covered, '\n', end - covered);
+        start = new_line == nullptr
+                    ? covered
+                    : static_cast<const char*>(new_line) - begin + 1;
+        lines.emplace_back(start, end - start, Grep::CONTEXT_LINE);
+        num_before++;
+      }
+      if (first && r == 0 && num_before < _before_context) {
+        // continued by the last lines of the previous chunk
+        result->before_missing = _before_context - num_before;
+      }
+      first = false;
+      lines.emplace_back(span->first, span->second, 0);
+      // trailing context: up to the next selected line
+      size_t next = std::next(span) != spans->end()
+                        ? std::min(std::next(span)->first, region_end)
+                        : region_end;
+      size_t position = span->first + span->second + 1;
+      size_t num_after = 0;
+      while (num_after < _after_context && position < next) {
+        size_t end = std::min(line_end_(data, position), region_end);
+        lines.emplace_back(position, end - position, Grep::CONTEXT_LINE);
+        position = end + 1;
+        num_after++;
+      }
+      covered = position;
+      // continued by the first lines of the next chunk
+      result->after_missing = r + 1 == regions.size() &&
+                                      num_after < _after_context &&
+                                      position >= region_end
+                                  ? _after_context - num_after
+                                  : 0;
+    }
+  }
+  if (!regions.empty() && _after_context > 0) {
+    // first lines of the chunk: trailing context of the previous chunk
+    auto [region_begin, region_end] = regions.front();
+    size_t position = region_begin;
+    for (size_t i = 0; i < _after_context && position < region_end; ++i) {
+      size_t end = std::min(line_end_(data, position), region_end);
+      lines.emplace_back(position, end - position, Grep::HEAD_LINE);
+      position = end + 1;
+    }
+  }
+  if (!regions.empty() && _before_context > 0 &&
+      regions.back().second > regions.back().first) {
+    // last lines of the chunk: leading context of the next chunk
+    auto [region_begin, region_end] = regions.back();
+    size_t end = begin[region_end - 1] == '\n' ? region_end - 1 : region_end;
+    for (size_t i = 0; i < _before_context; ++i) {
+      const void* new_line =
+          ::memrchr(begin + region_begin, '\n', end - region_begin);
+      size_t start = new_line == nullptr
+                         ? region_begin
+                         : static_cast<const char*>(new_line) - begin + 1;
+      lines.emplace_back(start, end - start, Grep::TAIL_LINE);
+      if (start == region_begin) {
+        break;
+      }
+      end = start - 1;
+    }
+  }
+  std::sort(lines.begin(), lines.end(), [](const auto& a, const auto& b) {
+    return std::get<0>(a) < std::get<0>(b);
+  });
+  spans->clear();
+  flags->clear();
+  for (const auto& [offset, size, flag] : lines) {
+    if (!spans->empty() && spans->back().first == offset) {
+      // a selected line stays selected
+      flags->back() =
+          flags->back() == 0 || flag == 0 ? 0 : flags->back() | flag;
+      continue;
+    }
+    spans->emplace_back(offset, size);
+    flags->push_back(flag);
+  }
+}
+
+// ===== SearcherCache =========================================================
+// _____________________________________________________________________________
+SearcherCache::SearcherCache(size_t max_size)
+    : _max_size(std::max<size_t>(max_size, 1)) {}
+
+// _____________________________________________________________________________
+std::unique_ptr<GrepSearcher> SearcherCache::get(
+    const std::vector<std::string>& patterns, bool byte_offset,
+    bool line_number, bool only_matching, bool regex, bool ignore_case,
+    Grep::Locale locale, Grep::Boundary boundary) {
+  std::string key = {static_cast<char>('0' + byte_offset),
+                     static_cast<char>('0' + line_number),
+                     static_cast<char>('0' + only_matching),
+                     static_cast<char>('0' + regex),
+                     static_cast<char>('0' + ignore_case),
+                     static_cast<char>('0' + static_cast<int>(locale)),
+                     static_cast<char>('0' + static_cast<int>(boundary))};
+  for (const auto& pattern : patterns) {
+    key.append(std::to_string(pattern.size())).append(":").append(pattern);
+  }
+  {
+    std::unique_lock lock(_mutex);
+    auto search = _index.find(key);
+    if (search != _index.end()) {
+      _searchers.splice(_searchers.begin(), _searchers, search->second);
+      return std::make_unique<GrepSearcher>(search->second->second);
+    }
+  }
+  // compiled without holding the lock
+  GrepSearcher searcher(patterns, byte_offset, line_number, only_matching,
+                        regex, ignore_case, locale, boundary);
+  std::unique_lock lock(_mutex);
+  if (_index.find(key) == _index.end()) {
+    _searchers.emplace_front(key, searcher);
+    _index.emplace(std::move(key), _searchers.begin());
+    if (_searchers.size() > _max_size) {
+      _index.erase(_searchers.back().first);
+      _searchers.pop_back();
+    }
+  }
+  return std::make_unique<GrepSearcher>(std::move(searcher));
+}
+
+// _____________________________________________________________________________
+size_t SearcherCache::size() const {
+  std::unique_lock lock(_mutex);
+  return _searchers.size();
 }
\ No newline at end of file
@@ -0,0 +1,108 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <poll.h>
+#include <unistd.h>
+#include <xsgrep/tasks/StreamReader.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+// ----- Helper functions ------------------------------------------------------
+/// interval in milliseconds in which waiting for data checks the cancellation
+const int poll_interval_ = 100;
+
+// ===== StreamReader ==========================================================
+// _____________________________________________________________________________
+StreamReader::StreamReader(int fd, size_t min_size, size_t max_size)
+    : xs::task::base::DataProvider<xs::DataChunk>(1),
+      _fd(fd),
+      _min_size(std::max<size_t>(min_size, 1)),
+      _max_size(std::max(max_size, _min_size)),
+      _block_size(_min_size) {}
+
+// _____________________________________________________________________________
+std::optional<std::pair<xs::DataChunk, xs::chunk_index>>
+StreamReader::getNextData() {
+  // the incomplete line of the previous chunk is continued
+  std::string data = std::move(_carry);
+  _carry.clear();
+  size_t size = data.size();
+  data.resize(std::max(_block_size, size + 1));
+  // end of the last complete line read so far
+  size_t lines_end = 0;
+  bool filled = false;
+  while (!_eof) {
+    if (size == data.size()) {
+      if (lines_end > 0) {
+        filled = true;
+        break;
+      }
+      // a line longer than the block
+      data.resize(data.size() * 2);
+    }
+    // complete lines are searched as soon as no more data are available
+    if (!wait_readable(lines_end > 0 ? 0 : poll_interval_)) {
+      if (lines_end > 0) {
+        break;
+      }
+      if (_cancellation != nullptr && _cancellation->cancelled()) {
+        return {};
+      }
+      continue;
+    }
+    ssize_t n = ::read(_fd, data.data() + size, data.size() - size);
+    if (n < 0) {
+      if (errno == EINTR || errno == EAGAIN) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(),
+                              "error reading input");
+    }
+    if (n == 0) {
+      _eof = true;
+      break;
+    }
+    if (const void* nl = ::memrchr(data.data() + size, '\n', n)) {
+      lines_end = static_cast<const char*>(nl) - data.data() + 1;
+    }
+    size += static_cast<size_t>(n);
+  }
+  _block_size = filled ? std::min(_block_size * 2, _max_size)
+                       : std::max(_block_size / 2, _min_size);
+  if (_eof) {
+    lines_end = size;
+  } else {
+    _carry.assign(data, lines_end, size - lines_end);
+  }
+  if (lines_end == 0) {
+    return {};
+  }
+  xs::DataChunk chunk(lines_end);
+  std::memcpy(chunk.data(), data.data(), lines_end);
+  chunk.getMetaData() = {_chunk_index, _offset, _offset, lines_end,
+                         lines_end, {}};
+  _offset += lines_end;
+  return {std::make_pair(std::move(chunk), _chunk_index++)};
+}
+
+// _____________________________________________________________________________
+StreamReader& StreamReader::set_cancellation(
+    std::shared_ptr<Cancellation> cancellation) {
+  _cancellation = std::move(cancellation);
+  return *this;
+}
+
+// _____________________________________________________________________________
+size_t StreamReader::block_size() const { return _block_size; }
+
+// _____________________________________________________________________________
+bool StreamReader::wait_readable(int timeout_ms) const {
+  pollfd fd{_fd, POLLIN, 0};
+  int ready = ::poll(&fd, 1, timeout_ms);
+  // errors (and hang ups) are reported by read()
+  return ready > 0 || (ready < 0 && errno != EINTR);
+}
\ No newline at end of file
@@ -0,0 +1,393 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <xsgrep/tasks/UringReader.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define XSGREP_IO_URING 1
+#endif
+
+// ----- Helper functions ------------------------------------------------------
+/// maximum length of a single read (larger reads complete partially)
+const size_t max_read_ = size_t(1) << 30;
+/// size of the reads searching for the end of a block
+const size_t probe_size_ = 4096;
+
+// ===== UringReader::Ring =====================================================
+#ifdef XSGREP_IO_URING
+/**
+ * Ring: Minimal io_uring instance: the submission and the completion queue
+ *  are memory mapped, entries are passed by the system calls.
+ */
+class UringReader::Ring {
+ public:
+  explicit Ring(unsigned entries) {
+    io_uring_params params{};
+    _fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (_fd < 0) {
+      throw std::system_error(errno, std::generic_category(), "io_uring");
+    }
+    _sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    _cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+      _sq_size = _cq_size = std::max(_sq_size, _cq_size);
+    }
+    _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    try {
+      _sq = map(_sq_size, IORING_OFF_SQ_RING);
+      _cq = single_mmap ? _sq : map(_cq_size, IORING_OFF_CQ_RING);
+      _sqes = static_cast<io_uring_sqe*>(map(_sqes_size, IORING_OFF_SQES));
+    } catch (...) {
+      release();
+      throw;
+    }
+    auto* sq = static_cast<char*>(_sq);
+    _sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    _sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    _sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    _sq_entries = params.sq_entries;
+    _sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    auto* cq = static_cast<char*>(_cq);
+    _cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    _cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    _cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    _cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  }
+
+  ~Ring() { release(); }
+
+  Ring(const Ring&) = delete;
+  Ring& operator=(const Ring&) = delete;
+
+  /// queue a readv of iov at offset of fd
+  void prepare_readv(int fd, const iovec* iov, uint64_t offset,
+                     uint64_t user_data) {
+    unsigned tail = *_sq_tail;
+    if (tail - std::atomic_ref(*_sq_head).load(std::memory_order_acquire) >=
+        _sq_entries) {
+      // never happens: no more reads are in flight than the ring has entries
+      throw std::logic_error("io_uring submission queue is full.");
+    }
+    unsigned index = tail & _sq_mask;
+    io_uring_sqe* sqe = &_sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(iov);
+    sqe->len = 1;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    _sq_array[index] = index;
+    std::atomic_ref(*_sq_tail).store(tail + 1, std::memory_order_release);
+    _pending++;
+  }
+
+  /// submit the queued reads and wait until min_complete reads completed
+  void submit(unsigned min_complete) {
+    while (_pending > 0 || min_complete > 0) {
+      unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+      long ret = ::syscall(__NR_io_uring_enter, _fd, _pending, min_complete,
+                           flags, nullptr, 0);
+      if (ret < 0) {
+        if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+          continue;
+        }
+        throw std::system_error(errno, std::generic_category(), "io_uring");
+      }
+      _pending -= static_cast<unsigned>(ret);
+      min_complete = 0;
+    }
+  }
+
+  /// take the next completion if there is one
+  bool pop(uint64_t* user_data, int32_t* result) {
+    unsigned head = *_cq_head;
+    if (head == std::atomic_ref(*_cq_tail).load(std::memory_order_acquire)) {
+      return false;
+    }
+    const io_uring_cqe& cqe = _cqes[head & _cq_mask];
+    *user_data = cqe.user_data;
+    *result = cqe.res;
+    std::atomic_ref(*_cq_head).store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  void* map(size_t size, off_t offset) {
+    void* ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, _fd, offset);
+    if (ptr == MAP_FAILED) {
+      throw std::system_error(errno, std::generic_category(), "io_uring");
+    }
+    return ptr;
+  }
+
+  void release() {
+    if (_sqes != nullptr) {
+      ::munmap(_sqes, _sqes_size);
+    }
+    if (_cq != nullptr && _cq != _sq) {
+      ::munmap(_cq, _cq_size);
+    }
+    if (_sq != nullptr) {
+      ::munmap(_sq, _sq_size);
+    }
+    ::close(_fd);
+  }
+
+  int _fd{-1};
+  void* _sq{nullptr};
+  void* _cq{nullptr};
+  size_t _sq_size{0};
+  size_t _cq_size{0};
+  io_uring_sqe* _sqes{nullptr};
+  size_t _sqes_size{0};
+  unsigned* _sq_head{nullptr};
+  unsigned* _sq_tail{nullptr};
+  unsigned _sq_mask{0};
+  unsigned _sq_entries{0};
+  unsigned* _sq_array{nullptr};
+  unsigned* _cq_head{nullptr};
+  unsigned* _cq_tail{nullptr};
+  unsigned _cq_mask{0};
+  io_uring_cqe* _cqes{nullptr};
+  /// number of queued reads not submitted yet
+  unsigned _pending{0};
+};
+#else
+/// io_uring headers are not available: the reader cannot be constructed
+class UringReader::Ring {
+ public:
+  explicit Ring(unsigned) {
+    throw std::system_error(ENOSYS, std::generic_category(), "io_uring");
+  }
+  void prepare_readv(int, const iovec*, uint64_t, uint64_t) {}
+  void submit(unsigned) {}
+  bool pop(uint64_t*, int32_t*) { return false; }
+};
+#endif
+
+// ===== UringReader ===========================================================
+// _____________________________________________________________________________
+UringReader::UringReader(std::string path, std::string meta_file,
+                         size_t queue_depth, size_t block_size)
+    : xs::task::base::DataProvider<xs::DataChunk>(1),
+      _path(std::move(path)),
+      _block_size(std::max<size_t>(block_size, 1)) {
+  queue_depth = std::clamp<size_t>(queue_depth, 1, 4096);
+  if (!meta_file.empty()) {
+    _meta_file = std::make_unique<xs::MetaFile>(meta_file, std::ios::in);
+  }
+  _ring = std::make_unique<Ring>(static_cast<unsigned>(queue_depth));
+  _fd = ::open(_path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat st {};
+  if (_fd < 0 || ::fstat(_fd, &st) != 0) {
+    int error = errno;
+    if (_fd >= 0) {
+      ::close(_fd);
+    }
+    throw std::system_error(error, std::generic_category(), _path);
+  }
+  _size = static_cast<uint64_t>(st.st_size);
+  _requests.resize(queue_depth);
+  for (size_t slot = queue_depth; slot > 0; --slot) {
+    _free_slots.push_back(slot - 1);
+  }
+}
+
+// _____________________________________________________________________________
+UringReader::~UringReader() {
+  // the kernel may still write into the chunks
+  try {
+    while (_in_flight > 0) {
+      _ring->submit(1);
+      uint64_t slot;
+      int32_t result;
+      while (_ring->pop(&slot, &result)) {
+        _in_flight--;
+      }
+    }
+  } catch (...) {
+    // the ring is closed anyway
+  }
+  ::close(_fd);
+}
+
+// _____________________________________________________________________________
+std::optional<std::pair<xs::DataChunk, xs::chunk_index>>
+UringReader::getNextData() {
+  std::unique_lock lock(_mutex);
+  while (true) {
+    if (_cancellation != nullptr && _cancellation->cancelled()) {
+      return {};
+    }
+    submit_reads();
+    if (_queue.empty()) {
+      return {};
+    }
+    size_t slot = _queue.front();
+    wait_for(slot);
+    _queue.pop_front();
+    _free_slots.push_back(slot);
+    Request& request = _requests[slot];
+    xs::DataChunk chunk = std::move(request.chunk);
+    if (request.meta_data.has_value()) {
+      if (request.done != request.meta_data->actual_size) {
+        throw std::runtime_error(_path + ": does not match its metafile.");
+      }
+      chunk.getMetaData() = std::move(*request.meta_data);
+      chunk.getMetaData().chunk_index = _chunk_index;
+      return {std::make_pair(std::move(chunk), _chunk_index++)};
+    }
+    if (request.done == 0) {
+      // the file shrank since it was opened
+      continue;
+    }
+    if (request.done < request.size) {
+      // a short read: the file shrank since it was opened, it ends here
+      xs::DataChunk shrunk(request.done);
+      std::memcpy(shrunk.data(), chunk.data(), request.done);
+      chunk = std::move(shrunk);
+    }
+    uint64_t offset = request.offset;
+    size_t size = request.done;
+    chunk.getMetaData() = {_chunk_index, offset, offset, size, size, {}};
+    return {std::make_pair(std::move(chunk), _chunk_index++)};
+  }
+}
+
+// _____________________________________________________________________________
+UringReader& UringReader::set_cancellation(
+    std::shared_ptr<Cancellation> cancellation) {
+  _cancellation = std::move(cancellation);
+  return *this;
+}
+
+// _____________________________________________________________________________
+bool UringReader::available() {
+  static const bool available = [] {
+    try {
+      Ring ring(1);
+      return true;
+    } catch (const std::system_error&) {
+      return false;
+    }
+  }();
+  return available;
+}
+
+// _____________________________________________________________________________
+void UringReader::submit_reads() {
+  while (!_free_slots.empty()) {
+    size_t slot = _free_slots.back();
+    Request& request = _requests[slot];
+    request.meta_data.reset();
+    if (_meta_file != nullptr) {
+      request.meta_data = _meta_file->next_chunk_meta_data();
+      if (!request.meta_data.has_value()) {
+        break;
+      }
+      request.offset = request.meta_data->actual_offset;
+      request.size = request.meta_data->actual_size;
+    } else {
+      if (_next_offset >= _size) {
+        break;
+      }
+      request.offset = _next_offset;
+      request.size = block_end(_next_offset) - _next_offset;
+      _next_offset += request.size;
+    }
+    request.chunk = xs::DataChunk(request.size);
+    request.done = 0;
+    request.complete = false;
+    _free_slots.pop_back();
+    _queue.push_back(slot);
+    submit_read(slot);
+  }
+  _ring->submit(0);
+}
+
+// _____________________________________________________________________________
+void UringReader::submit_read(size_t slot) {
+  Request& request = _requests[slot];
+  request.iov.iov_base = request.chunk.data() + request.done;
+  request.iov.iov_len = std::min(request.size - request.done, max_read_);
+  _ring->prepare_readv(_fd, &request.iov, request.offset + request.done, slot);
+  _in_flight++;
+}
+
+// _____________________________________________________________________________
+void UringReader::wait_for(size_t slot) {
+  reap();
+  while (!_requests[slot].complete) {
+    _ring->submit(1);
+    reap();
+  }
+}
+
+// _____________________________________________________________________________
+void UringReader::reap() {
+  uint64_t slot;
+  int32_t result;
+  while (_ring->pop(&slot, &result)) {
+    _in_flight--;
+    Request& request = _requests[slot];
+    if (result == -EINTR || result == -EAGAIN) {
+      submit_read(slot);
+      continue;
+    }
+    if (result < 0) {
+      throw std::system_error(-result, std::generic_category(), _path);
+    }
+    request.done += static_cast<size_t>(result);
+    if (result == 0 || request.done == request.size) {
+      request.complete = true;
+    } else {
+      // partial read: read the rest
+      submit_read(slot);
+    }
+  }
+}
+
+// _____________________________________________________________________________
+uint64_t UringReader::block_end(uint64_t offset) const {
+  uint64_t end = offset + _block_size;
+  if (end >= _size) {
+    return _size;
+  }
+  // the first new line at or after the last byte of the block
+  char buffer[probe_size_];
+  uint64_t position = end - 1;
+  while (position < _size) {
+    ssize_t n =
+        ::pread(_fd, buffer, probe_size_, static_cast<off_t>(position));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      // the file shrank (or cannot be read): the read of the block tells
+      break;
+    }
+    auto* nl = static_cast<const char*>(
+        std::memchr(buffer, '\n', static_cast<size_t>(n)));
+    if (nl != nullptr) {
+      return position + (nl - buffer) + 1;
+    }
+    position += static_cast<uint64_t>(n);
+  }
+  return _size;
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <xsgrep/utils/Cancellation.h>
+
+// _____________________________________________________________________________
+Cancellation::Cancellation(bool single_file) : _single_file(single_file) {}
+
+// _____________________________________________________________________________
+void Cancellation::cancel() {
+  _cancelled.store(true, std::memory_order_relaxed);
+}
+
+// _____________________________________________________________________________
+bool Cancellation::cancelled() const {
+  return _cancelled.load(std::memory_order_relaxed);
+}
+
+// _____________________________________________________________________________
+void Cancellation::cancel_file(const std::string& file_name) {
+  if (_single_file) {
+    cancel();
+    return;
+  }
+  std::unique_lock lock(_mutex);
+  _cancelled_files.insert(file_name);
+  _files_cancelled.store(true, std::memory_order_release);
+}
+
+// _____________________________________________________________________________
+bool Cancellation::file_cancelled(const std::string& file_name) const {
+  if (cancelled()) {
+    return true;
+  }
+  if (!_files_cancelled.load(std::memory_order_acquire)) {
+    return false;
+  }
+  std::unique_lock lock(_mutex);
+  return _cancelled_files.contains(file_name);
+}
\ No newline at end of file
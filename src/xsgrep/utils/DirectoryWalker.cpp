@@ -0,0 +1,210 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <xsgrep/utils/DirectoryWalker.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+// _____________________________________________________________________________
+DirectoryWalker::DirectoryWalker(std::string root, int max_depth,
+                                 int num_threads, size_t max_queued_files,
+                                 std::shared_ptr<ErrorLog> errors)
+    : _max_depth(max_depth),
+      _files(max_queued_files),
+      _errors(errors != nullptr ? std::move(errors)
+                                : std::make_shared<ErrorLog>()) {
+  struct stat st {};
+  if (::stat(root.c_str(), &st) != 0) {
+    throw std::runtime_error(root + " is not a file or directory.");
+  }
+  if (S_ISREG(st.st_mode)) {
+    _files.push({std::move(root), nullptr});
+    _files.close();
+    return;
+  }
+  if (!S_ISDIR(st.st_mode)) {
+    throw std::runtime_error(root + " is not a file or directory.");
+  }
+  if (_max_depth == 0) {
+    _files.close();
+    return;
+  }
+  if (num_threads <= 0) {
+    num_threads = std::clamp(
+        static_cast<int>(std::thread::hardware_concurrency()) / 2, 1, 8);
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    _work_queues.push_back(std::make_unique<WorkQueue>());
+  }
+  while (root.size() > 1 && root.back() == '/') {
+    root.pop_back();
+  }
+  push_directory(0, {std::move(root), 0});
+  for (int i = 0; i < num_threads; ++i) {
+    _threads.emplace_back(&DirectoryWalker::run, this, i);
+  }
+}
+
+// _____________________________________________________________________________
+DirectoryWalker::~DirectoryWalker() {
+  _stop = true;
+  _files.close();
+  {
+    std::unique_lock lock(_idle_mutex);
+    _idle_cv.notify_all();
+  }
+  for (auto& thread : _threads) {
+    thread.join();
+  }
+}
+
+// _____________________________________________________________________________
+std::optional<bool> DirectoryWalker::File::has_sibling(
+    std::string_view name) const {
+  if (siblings == nullptr) {
+    return {};
+  }
+  return std::binary_search(siblings->begin(), siblings->end(), name);
+}
+
+// _____________________________________________________________________________
+std::optional<std::string> DirectoryWalker::next() {
+  auto file = _files.pop();
+  if (!file.has_value()) {
+    return {};
+  }
+  return std::move(file->path);
+}
+
+// _____________________________________________________________________________
+std::optional<DirectoryWalker::File> DirectoryWalker::next_file() {
+  return _files.pop();
+}
+
+// _____________________________________________________________________________
+void DirectoryWalker::run(size_t id) {
+  while (!_stop) {
+    auto directory = pop_directory(id);
+    if (directory.has_value()) {
+      read_directory(id, *directory);
+      if (--_pending == 0) {
+        // traversal is done: no directory is queued or read anymore
+        _files.close();
+        std::unique_lock lock(_idle_mutex);
+        _idle_cv.notify_all();
+      }
+      continue;
+    }
+    std::unique_lock lock(_idle_mutex);
+    _idle_cv.wait(lock, [&] {
+      if (_stop || _pending == 0) {
+        return true;
+      }
+      return std::any_of(_work_queues.begin(), _work_queues.end(),
+                         [](const auto& queue) {
+                           std::unique_lock queue_lock(queue->mutex);
+                           return !queue->directories.empty();
+                         });
+    });
+    if (_pending == 0) {
+      return;
+    }
+  }
+}
+
+// _____________________________________________________________________________
+void DirectoryWalker::read_directory(size_t id, const Directory& directory) {
+  DIR* dir = ::opendir(directory.path.c_str());
+  if (dir == nullptr) {
+    _errors->report(directory.path, std::strerror(errno));
+    return;
+  }
+  std::string prefix = directory.path;
+  if (prefix.back() != '/') {
+    prefix.push_back('/');
+  }
+  auto names = std::make_shared<std::vector<std::string>>();
+  while (!_stop) {
+    dirent* entry = ::readdir(dir);
+    if (entry == nullptr) {
+      break;
+    }
+    const char* name = entry->d_name;
+    if (name[0] == '.' &&
+        (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+      continue;
+    }
+    std::string path = prefix + name;
+    unsigned char type = entry->d_type;
+    if (type == DT_LNK || type == DT_UNKNOWN) {
+      // the type is not known (or the target of a link is needed): stat
+      struct stat st {};
+      if (::stat(path.c_str(), &st) != 0) {
+        continue;
+      }
+      type = S_ISREG(st.st_mode) ? DT_REG
+                                 : (S_ISDIR(st.st_mode) ? DT_DIR : DT_UNKNOWN);
+    }
+    if (type == DT_REG) {
+      names->emplace_back(name);
+    } else if (type == DT_DIR) {
+      if (_max_depth == -1 || directory.depth + 1 < _max_depth) {
+        push_directory(id, {std::move(path), directory.depth + 1});
+      }
+    }
+  }
+  ::closedir(dir);
+  std::sort(names->begin(), names->end());
+  std::shared_ptr<const std::vector<std::string>> siblings = names;
+  for (const auto& name : *names) {
+    if (_stop) {
+      break;
+    }
+    // blocks while the file queue is full
+    _files.push({prefix + name, siblings});
+  }
+}
+
+// _____________________________________________________________________________
+void DirectoryWalker::push_directory(size_t id, Directory directory) {
+  _pending++;
+  {
+    std::unique_lock lock(_work_queues[id]->mutex);
+    _work_queues[id]->directories.push_back(std::move(directory));
+  }
+  // acquire the idle mutex so that no thread misses the notification between
+  //  checking the queues and waiting
+  std::unique_lock lock(_idle_mutex);
+  _idle_cv.notify_one();
+}
+
+// _____________________________________________________________________________
+std::optional<DirectoryWalker::Directory> DirectoryWalker::pop_directory(
+    size_t id) {
+  {
+    // own queue: depth first (back)
+    std::unique_lock lock(_work_queues[id]->mutex);
+    auto& directories = _work_queues[id]->directories;
+    if (!directories.empty()) {
+      Directory directory = std::move(directories.back());
+      directories.pop_back();
+      return directory;
+    }
+  }
+  // steal from the other queues (front)
+  for (size_t i = 1; i < _work_queues.size(); ++i) {
+    auto& queue = _work_queues[(id + i) % _work_queues.size()];
+    std::unique_lock lock(queue->mutex);
+    if (!queue->directories.empty()) {
+      Directory directory = std::move(queue->directories.front());
+      queue->directories.pop_front();
+      return directory;
+    }
+  }
+  return {};
+}
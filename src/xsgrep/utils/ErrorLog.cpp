@@ -0,0 +1,19 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <xsgrep/utils/ErrorLog.h>
+
+// _____________________________________________________________________________
+ErrorLog::ErrorLog(std::ostream* stream) : _stream(stream) {}
+
+// _____________________________________________________________________________
+void ErrorLog::report(const std::string& path, const std::string& message) {
+  _count.fetch_add(1, std::memory_order_relaxed);
+  std::unique_lock lock(_mutex);
+  *_stream << path << ": " << message << '\n';
+}
+
+// _____________________________________________________________________________
+size_t ErrorLog::count() const {
+  return _count.load(std::memory_order_relaxed);
+}
\ No newline at end of file
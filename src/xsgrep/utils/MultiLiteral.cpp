@@ -0,0 +1,322 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <xsgrep/utils/MultiLiteral.h>
+#include <xsgrep/utils/search.h>
+
+#include <algorithm>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// ----- Helper functions ------------------------------------------------------
+// _____________________________________________________________________________
+/// the byte c and (if ignore_case) its other ASCII case
+std::vector<char> case_variants_(char c, bool ignore_case) {
+  if (ignore_case && c >= 'a' && c <= 'z') {
+    return {c, static_cast<char>(c & ~0x20)};
+  }
+  return {c};
+}
+
+// ===== MultiLiteral ==========================================================
+// _____________________________________________________________________________
+MultiLiteral::MultiLiteral(const std::vector<std::string>& patterns,
+                           bool ignore_case)
+    : _num_patterns(patterns.size()), _ignore_case(ignore_case) {
+  std::vector<std::string> folded(patterns);
+  if (_ignore_case) {
+    for (auto& pattern : folded) {
+      std::transform(pattern.begin(), pattern.end(), pattern.begin(),
+                     to_lower_ascii);
+    }
+  }
+  // bytes that do not occur in any pattern share class 0
+  for (const auto& pattern : folded) {
+    for (char c : pattern) {
+      auto& byte_class = _classes[static_cast<uint8_t>(c)];
+      if (byte_class == 0) {
+        byte_class = _num_classes++;
+      }
+    }
+  }
+  if (_ignore_case) {
+    for (char c = 'a'; c <= 'z'; ++c) {
+      _classes[static_cast<uint8_t>(c & ~0x20)] =
+          _classes[static_cast<uint8_t>(c)];
+    }
+  }
+  // trie of the patterns
+  add_state(0);
+  for (size_t i = 0; i < folded.size(); ++i) {
+    const auto& pattern = folded[i];
+    if (pattern.empty()) {
+      if (_empty_pattern < 0) {
+        _empty_pattern = static_cast<int64_t>(i);
+      }
+      continue;
+    }
+    uint32_t state = 0;
+    for (char c : pattern) {
+      size_t transition = state + _classes[static_cast<uint8_t>(c)];
+      if (_delta[transition] == 0) {
+        uint32_t id = add_state(_depth[state / _num_classes] + 1);
+        _delta[transition] = id;
+      }
+      state = _delta[transition];
+    }
+    uint32_t index = state / _num_classes;
+    if (_pattern[index] < 0) {
+      _pattern[index] = static_cast<int32_t>(i);
+      _output[index] = static_cast<uint32_t>(pattern.size());
+    }
+    _max_length = std::max(_max_length, pattern.size());
+  }
+  build_automaton();
+  build_prefilter(folded);
+}
+
+// _____________________________________________________________________________
+std::optional<MultiLiteral::Match> MultiLiteral::find(const char* data,
+                                                      size_t size) const {
+  if (_empty_pattern >= 0) {
+    // the empty pattern matches at the very beginning
+    auto match = match_at(data, size, 0);
+    if (match.has_value()) {
+      return match;
+    }
+    return Match{0, 0, static_cast<size_t>(_empty_pattern)};
+  }
+  return _use_automaton ? find_automaton(data, size)
+                        : find_prefilter(data, size);
+}
+
+// _____________________________________________________________________________
+size_t MultiLiteral::num_patterns() const { return _num_patterns; }
+
+// _____________________________________________________________________________
+bool MultiLiteral::uses_automaton() const { return _use_automaton; }
+
+// _____________________________________________________________________________
+std::optional<MultiLiteral::Match> MultiLiteral::match_at(
+    const char* data, size_t size, size_t position) const {
+  std::optional<Match> longest;
+  uint32_t state = 0;
+  for (size_t i = position; i < size; ++i) {
+    uint32_t next =
+        _delta[state + _classes[static_cast<uint8_t>(data[i])]] & ~accept_flag;
+    // transitions that do not follow a trie edge lead to a state of at most
+    //  the same depth
+    if (_depth[next / _num_classes] != _depth[state / _num_classes] + 1) {
+      break;
+    }
+    state = next;
+    int32_t pattern = _pattern[state / _num_classes];
+    if (pattern >= 0) {
+      longest = Match{position, i - position + 1, static_cast<size_t>(pattern)};
+    }
+  }
+  return longest;
+}
+
+// _____________________________________________________________________________
+std::vector<MultiLiteral::Match> MultiLiteral::matches_at(
+    const char* data, size_t size, size_t position) const {
+  std::vector<Match> matches;
+  if (_empty_pattern >= 0) {
+    matches.push_back({position, 0, static_cast<size_t>(_empty_pattern)});
+  }
+  uint32_t state = 0;
+  for (size_t i = position; i < size; ++i) {
+    uint32_t next =
+        _delta[state + _classes[static_cast<uint8_t>(data[i])]] & ~accept_flag;
+    if (_depth[next / _num_classes] != _depth[state / _num_classes] + 1) {
+      break;
+    }
+    state = next;
+    int32_t pattern = _pattern[state / _num_classes];
+    if (pattern >= 0) {
+      matches.push_back(
+          {position, i - position + 1, static_cast<size_t>(pattern)});
+    }
+  }
+  std::reverse(matches.begin(), matches.end());
+  return matches;
+}
+
+// _____________________________________________________________________________
+std::optional<MultiLiteral::Match> MultiLiteral::find_prefilter(
+    const char* data, size_t size) const {
+  size_t i = 0;
+#if defined(__AVX2__)
+  alignas(32) __m256i first[max_prefixes]{};
+  alignas(32) __m256i second[max_prefixes]{};
+  for (size_t p = 0; p < _prefixes.size(); ++p) {
+    first[p] = _mm256_set1_epi8(_prefixes[p].first);
+    second[p] = _mm256_set1_epi8(_prefixes[p].second);
+  }
+  for (; i + 33 <= size; i += 32) {
+    const __m256i block_first =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+    const __m256i block_second =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 1));
+    __m256i candidates = _mm256_setzero_si256();
+    for (size_t p = 0; p < _prefixes.size(); ++p) {
+      __m256i eq = _mm256_cmpeq_epi8(block_first, first[p]);
+      if (!_prefixes[p].single) {
+        eq = _mm256_and_si256(eq, _mm256_cmpeq_epi8(block_second, second[p]));
+      }
+      candidates = _mm256_or_si256(candidates, eq);
+    }
+    auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(candidates));
+    while (mask != 0) {
+      auto match = match_at(data, size, i + __builtin_ctz(mask));
+      if (match.has_value()) {
+        return match;
+      }
+      mask &= mask - 1;
+    }
+  }
+#elif defined(__SSE2__)
+  alignas(16) __m128i first[max_prefixes]{};
+  alignas(16) __m128i second[max_prefixes]{};
+  for (size_t p = 0; p < _prefixes.size(); ++p) {
+    first[p] = _mm_set1_epi8(_prefixes[p].first);
+    second[p] = _mm_set1_epi8(_prefixes[p].second);
+  }
+  for (; i + 17 <= size; i += 16) {
+    const __m128i block_first =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    const __m128i block_second =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+    __m128i candidates = _mm_setzero_si128();
+    for (size_t p = 0; p < _prefixes.size(); ++p) {
+      __m128i eq = _mm_cmpeq_epi8(block_first, first[p]);
+      if (!_prefixes[p].single) {
+        eq = _mm_and_si128(eq, _mm_cmpeq_epi8(block_second, second[p]));
+      }
+      candidates = _mm_or_si128(candidates, eq);
+    }
+    auto mask = static_cast<uint32_t>(_mm_movemask_epi8(candidates));
+    while (mask != 0) {
+      auto match = match_at(data, size, i + __builtin_ctz(mask));
+      if (match.has_value()) {
+        return match;
+      }
+      mask &= mask - 1;
+    }
+  }
+#endif
+  // remaining bytes (or no SIMD available)
+  for (; i < size; ++i) {
+    if (_first_bytes[static_cast<uint8_t>(data[i])]) {
+      auto match = match_at(data, size, i);
+      if (match.has_value()) {
+        return match;
+      }
+    }
+  }
+  return {};
+}
+
+// _____________________________________________________________________________
+std::optional<MultiLiteral::Match> MultiLiteral::find_automaton(
+    const char* data, size_t size) const {
+  uint32_t state = 0;
+  for (size_t i = 0; i < size; ++i) {
+    uint32_t next = _delta[state + _classes[static_cast<uint8_t>(data[i])]];
+    state = next & ~accept_flag;
+    if ((next & accept_flag) == 0) {
+      continue;
+    }
+    // the first match ends at i: a match starting further left must end
+    //  after i, so it starts within the last _max_length bytes
+    size_t end = i + 1;
+    size_t start = end - _output[state / _num_classes];
+    for (size_t p = end > _max_length ? end - _max_length : 0; p < start;
+         ++p) {
+      auto match = match_at(data, size, p);
+      if (match.has_value()) {
+        return match;
+      }
+    }
+    return match_at(data, size, start);
+  }
+  return {};
+}
+
+// _____________________________________________________________________________
+uint32_t MultiLiteral::add_state(uint32_t depth) {
+  auto id = static_cast<uint32_t>(_delta.size());
+  _delta.resize(_delta.size() + _num_classes, 0);
+  _depth.push_back(depth);
+  _pattern.push_back(-1);
+  _output.push_back(0);
+  return id;
+}
+
+// _____________________________________________________________________________
+void MultiLiteral::build_automaton() {
+  // breadth first: the failure state of a state is known before the state
+  //  itself is processed. Missing transitions of the root stay at the root (0)
+  std::vector<uint32_t> fail(_depth.size(), 0);
+  std::vector<uint32_t> queue;
+  queue.reserve(_depth.size());
+  for (uint32_t c = 0; c < _num_classes; ++c) {
+    if (_delta[c] != 0) {
+      queue.push_back(_delta[c]);
+    }
+  }
+  for (size_t head = 0; head < queue.size(); ++head) {
+    uint32_t state = queue[head];
+    uint32_t failure = fail[state / _num_classes];
+    for (uint32_t c = 0; c < _num_classes; ++c) {
+      uint32_t next = _delta[state + c];
+      if (next == 0) {
+        // no trie edge: continue as the failure state does
+        _delta[state + c] = _delta[failure + c];
+        continue;
+      }
+      uint32_t index = next / _num_classes;
+      fail[index] = _delta[failure + c];
+      _output[index] =
+          std::max(_output[index], _output[fail[index] / _num_classes]);
+      queue.push_back(next);
+    }
+  }
+  for (auto& next : _delta) {
+    if (_output[next / _num_classes] > 0) {
+      next |= accept_flag;
+    }
+  }
+}
+
+// _____________________________________________________________________________
+void MultiLiteral::build_prefilter(const std::vector<std::string>& patterns) {
+  for (const auto& pattern : patterns) {
+    if (pattern.empty()) {
+      continue;
+    }
+    for (char first : case_variants_(pattern[0], _ignore_case)) {
+      _first_bytes[static_cast<uint8_t>(first)] = true;
+      std::vector<char> seconds{'\0'};
+      if (pattern.size() > 1) {
+        seconds = case_variants_(pattern[1], _ignore_case);
+      }
+      for (char second : seconds) {
+        Prefix prefix{first, second, pattern.size() == 1};
+        if (std::none_of(_prefixes.begin(), _prefixes.end(),
+                         [&](const Prefix& p) {
+                           return p.first == prefix.first &&
+                                  p.second == prefix.second &&
+                                  p.single == prefix.single;
+                         })) {
+          _prefixes.push_back(prefix);
+        }
+      }
+    }
+  }
+  // too many candidates per block: the automaton is faster
+  _use_automaton = _prefixes.size() > max_prefixes;
+}
\ No newline at end of file
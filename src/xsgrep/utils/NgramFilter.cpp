@@ -0,0 +1,150 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <xsgrep/utils/NgramFilter.h>
+#include <xsgrep/utils/search.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+// ----- Helper functions ------------------------------------------------------
+/// first bytes of a filter file
+const char magic_[] = {'X', 'S', 'N', 'G', 'R', 'A', 'M', '1'};
+/// maximum size of a filter accepted when reading a filter file
+const uint64_t max_bytes_ = uint64_t(1) << 30;
+
+// _____________________________________________________________________________
+/// mix the bits of the trigram (64 bit finalizer of MurmurHash3)
+uint64_t hash_(uint64_t trigram) {
+  trigram ^= trigram >> 33;
+  trigram *= 0xff51afd7ed558ccdULL;
+  trigram ^= trigram >> 33;
+  trigram *= 0xc4ceb9fe1a85ec53ULL;
+  trigram ^= trigram >> 33;
+  return trigram;
+}
+
+// _____________________________________________________________________________
+/// call f for every trigram of [data, data + size) that contains no new line
+template <typename F>
+bool for_each_trigram_(const char* data, size_t size, F f) {
+  uint32_t trigram = 0;
+  size_t length = 0;
+  for (size_t i = 0; i < size; ++i) {
+    if (data[i] == '\n') {
+      length = 0;
+      continue;
+    }
+    trigram = ((trigram << 8) |
+               static_cast<unsigned char>(to_lower_ascii(data[i]))) &
+              0xffffff;
+    if (++length >= 3 && !f(trigram)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// _____________________________________________________________________________
+/**
+ * Read the header of a filter file.
+ * @return size of the filters
+ * @throws std::runtime_error if the header is not valid
+ */
+uint64_t read_header_(std::istream& in, const std::string& path) {
+  char magic[sizeof(magic_)];
+  uint64_t num_bytes = 0;
+  if (!in.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, magic_, sizeof(magic_)) != 0 ||
+      !in.read(reinterpret_cast<char*>(&num_bytes), sizeof(num_bytes)) ||
+      num_bytes < 8 || num_bytes > max_bytes_ ||
+      !std::has_single_bit(num_bytes)) {
+    throw std::runtime_error(path + ": not a valid n-gram filter file.");
+  }
+  return num_bytes;
+}
+
+// ===== NgramFilter ===========================================================
+// _____________________________________________________________________________
+NgramFilter::NgramFilter(size_t num_bytes)
+    : _bits(std::bit_ceil(std::max<size_t>(num_bytes, 8)) / 8, 0),
+      _mask(_bits.size() * 64 - 1) {}
+
+// _____________________________________________________________________________
+void NgramFilter::add(const char* data, size_t size) {
+  for_each_trigram_(data, size, [this](uint32_t trigram) {
+    // two bits per trigram: the lower and the upper half of the hash
+    uint64_t hash = hash_(trigram);
+    uint64_t first = hash & _mask;
+    uint64_t second = (hash >> 32) & _mask;
+    _bits[first / 64] |= uint64_t(1) << (first % 64);
+    _bits[second / 64] |= uint64_t(1) << (second % 64);
+    return true;
+  });
+}
+
+// _____________________________________________________________________________
+bool NgramFilter::may_contain(std::string_view literal) const {
+  return for_each_trigram_(
+      literal.data(), literal.size(), [this](uint32_t trigram) {
+        uint64_t hash = hash_(trigram);
+        uint64_t first = hash & _mask;
+        uint64_t second = (hash >> 32) & _mask;
+        return (_bits[first / 64] >> (first % 64) & 1) != 0 &&
+               (_bits[second / 64] >> (second % 64) & 1) != 0;
+      });
+}
+
+// _____________________________________________________________________________
+bool NgramFilter::may_contain_any(
+    const std::vector<std::string>& literals) const {
+  return std::any_of(
+      literals.begin(), literals.end(),
+      [this](const std::string& literal) { return may_contain(literal); });
+}
+
+// _____________________________________________________________________________
+size_t NgramFilter::num_bytes() const { return _bits.size() * 8; }
+
+// _____________________________________________________________________________
+void NgramFilter::write(std::ostream& out, uint64_t original_offset) const {
+  out.write(reinterpret_cast<const char*>(&original_offset),
+            sizeof(original_offset));
+  out.write(reinterpret_cast<const char*>(_bits.data()),
+            static_cast<std::streamsize>(num_bytes()));
+}
+
+// _____________________________________________________________________________
+void NgramFilter::write_header(std::ostream& out, size_t num_bytes) {
+  uint64_t size = NgramFilter(num_bytes).num_bytes();
+  out.write(magic_, sizeof(magic_));
+  out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+}
+
+// _____________________________________________________________________________
+std::unordered_map<uint64_t, NgramFilter> NgramFilter::read_file(
+    const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  uint64_t num_bytes = read_header_(in, path);
+  std::unordered_map<uint64_t, NgramFilter> filters;
+  uint64_t original_offset = 0;
+  while (in.read(reinterpret_cast<char*>(&original_offset),
+                 sizeof(original_offset))) {
+    NgramFilter filter(num_bytes);
+    if (!in.read(reinterpret_cast<char*>(filter._bits.data()),
+                 static_cast<std::streamsize>(num_bytes))) {
+      throw std::runtime_error(path + ": truncated n-gram filter file.");
+    }
+    filters.insert_or_assign(original_offset, std::move(filter));
+  }
+  return filters;
+}
+
+// _____________________________________________________________________________
+size_t NgramFilter::read_filter_size(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  return read_header_(in, path);
+}
\ No newline at end of file
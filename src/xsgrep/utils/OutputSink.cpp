@@ -0,0 +1,149 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <sys/uio.h>
+#include <unistd.h>
+#include <xsgrep/utils/OutputSink.h>
+
+#include <cerrno>
+#include <charconv>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+
+// ----- Helper functions ------------------------------------------------------
+// _____________________________________________________________________________
+void append_uint(std::string* out, uint64_t val) {
+  char tmp[20];
+  auto res = std::to_chars(tmp, tmp + sizeof(tmp), val);
+  out->append(tmp, res.ptr);
+}
+
+// _____________________________________________________________________________
+void append_int(std::string* out, int64_t val) {
+  char tmp[20];
+  auto res = std::to_chars(tmp, tmp + sizeof(tmp), val);
+  out->append(tmp, res.ptr);
+}
+
+// ===== OutputSink ============================================================
+// _____________________________________________________________________________
+OutputSink::OutputSink(int fd, size_t capacity)
+    : _fd(fd), _capacity(capacity) {
+  _buffer.reserve(_capacity);
+}
+
+// _____________________________________________________________________________
+OutputSink::OutputSink(std::ostream& stream, size_t capacity)
+    : _capacity(capacity) {
+  if (&stream == &std::cout) {
+    // anything written through std::cout before must be written first
+    std::cout.flush();
+    _fd = STDOUT_FILENO;
+  } else {
+    _ostream = &stream;
+  }
+  _buffer.reserve(_capacity);
+}
+
+// _____________________________________________________________________________
+OutputSink::~OutputSink() {
+  try {
+    flush();
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+// _____________________________________________________________________________
+void OutputSink::write(std::string_view data) {
+  _bytes_written += data.size();
+  if (_buffer.size() + data.size() <= _capacity) {
+    _buffer.append(data);
+    return;
+  }
+  if (data.size() < _capacity / 2) {
+    // small block: fill the buffer and start over with the rest
+    size_t fill = _capacity - _buffer.size();
+    _buffer.append(data.substr(0, fill));
+    write_through({});
+    _buffer.append(data.substr(fill));
+  } else {
+    // large block: write it directly behind the buffered data without copying
+    write_through(data);
+  }
+}
+
+// _____________________________________________________________________________
+void OutputSink::write(char c) {
+  _bytes_written++;
+  if (_buffer.size() == _capacity) {
+    write_through({});
+  }
+  _buffer.push_back(c);
+}
+
+// _____________________________________________________________________________
+void OutputSink::write_uint(uint64_t val) {
+  char tmp[20];
+  auto res = std::to_chars(tmp, tmp + sizeof(tmp), val);
+  write(std::string_view(tmp, res.ptr - tmp));
+}
+
+// _____________________________________________________________________________
+void OutputSink::write_int(int64_t val) {
+  char tmp[20];
+  auto res = std::to_chars(tmp, tmp + sizeof(tmp), val);
+  write(std::string_view(tmp, res.ptr - tmp));
+}
+
+// _____________________________________________________________________________
+void OutputSink::flush() {
+  write_through({});
+  if (_ostream != nullptr) {
+    _ostream->flush();
+  }
+}
+
+// _____________________________________________________________________________
+uint64_t OutputSink::bytes_written() const { return _bytes_written; }
+
+// _____________________________________________________________________________
+void OutputSink::write_through(std::string_view data) {
+  if (_buffer.empty() && data.empty()) {
+    return;
+  }
+  if (_ostream != nullptr) {
+    _ostream->write(_buffer.data(),
+                    static_cast<std::streamsize>(_buffer.size()));
+    _ostream->write(data.data(), static_cast<std::streamsize>(data.size()));
+    _buffer.clear();
+    return;
+  }
+  iovec iov[2] = {{_buffer.data(), _buffer.size()},
+                  {const_cast<char*>(data.data()), data.size()}};
+  int iov_index = iov[0].iov_len == 0 ? 1 : 0;
+  while (iov_index < 2) {
+    ssize_t written = ::writev(_fd, iov + iov_index, 2 - iov_index);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      _buffer.clear();
+      throw std::system_error(errno, std::generic_category(),
+                              "error writing output");
+    }
+    // advance iovecs by the number of bytes written
+    auto remaining = static_cast<size_t>(written);
+    while (iov_index < 2 && remaining >= iov[iov_index].iov_len) {
+      remaining -= iov[iov_index].iov_len;
+      iov_index++;
+    }
+    if (iov_index < 2) {
+      iov[iov_index].iov_base =
+          static_cast<char*>(iov[iov_index].iov_base) + remaining;
+      iov[iov_index].iov_len -= remaining;
+    }
+  }
+  _buffer.clear();
+}
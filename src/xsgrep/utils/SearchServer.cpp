@@ -0,0 +1,355 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <xsgrep/utils/SearchServer.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string_view>
+#include <system_error>
+#include <thread>
+
+// ----- Helper functions ------------------------------------------------------
+/// maximum size of a message accepted
+const uint32_t max_message_size_ = 64 << 20;
+
+// _____________________________________________________________________________
+/// send all size bytes of data (no SIGPIPE if the peer is gone)
+void send_all_(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(),
+                              "error sending message");
+    }
+    data += n;
+    size -= static_cast<size_t>(n);
+  }
+}
+
+// _____________________________________________________________________________
+/// receive exactly size bytes, false if the connection was closed before
+bool receive_all_(int fd, char* data, size_t size) {
+  while (size > 0) {
+    ssize_t n = ::recv(fd, data, size, 0);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(),
+                              "error receiving message");
+    }
+    if (n == 0) {
+      return false;
+    }
+    data += n;
+    size -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+// _____________________________________________________________________________
+void send_message_(int fd, char type, std::string_view payload) {
+  char header[1 + sizeof(uint32_t)];
+  auto size = static_cast<uint32_t>(payload.size());
+  header[0] = type;
+  std::memcpy(header + 1, &size, sizeof(size));
+  send_all_(fd, header, sizeof(header));
+  send_all_(fd, payload.data(), payload.size());
+}
+
+// _____________________________________________________________________________
+/// receive the next message, false if the connection was closed
+bool receive_message_(int fd, char* type, std::string* payload) {
+  char header[1 + sizeof(uint32_t)];
+  if (!receive_all_(fd, header, sizeof(header))) {
+    return false;
+  }
+  uint32_t size = 0;
+  std::memcpy(&size, header + 1, sizeof(size));
+  if (size > max_message_size_) {
+    throw std::system_error(EPROTO, std::generic_category(),
+                            "invalid message");
+  }
+  *type = header[0];
+  payload->resize(size);
+  if (!receive_all_(fd, payload->data(), size)) {
+    throw std::system_error(ECONNRESET, std::generic_category(),
+                            "incomplete message");
+  }
+  return true;
+}
+
+// _____________________________________________________________________________
+sockaddr_un address_(const std::string& socket_path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    throw std::system_error(ENAMETOOLONG, std::generic_category(),
+                            socket_path);
+  }
+  std::memcpy(address.sun_path, socket_path.data(), socket_path.size());
+  return address;
+}
+
+// _____________________________________________________________________________
+/// a socket connected to socket_path (-1 if no server accepts connections)
+int connect_(const std::string& socket_path) {
+  sockaddr_un address = address_(socket_path);
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "socket");
+  }
+  if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) !=
+      0) {
+    int error = errno;
+    ::close(fd);
+    errno = error;
+    return -1;
+  }
+  return fd;
+}
+
+// _____________________________________________________________________________
+/**
+ * Stream buffer sending everything written to it as messages of one type.
+ *  The data are sent once the buffer is full or the stream is flushed.
+ */
+class MessageBuf_ : public std::streambuf {
+ public:
+  MessageBuf_(int fd, char type) : _fd(fd), _type(type), _buffer(64 << 10) {
+    setp(_buffer.data(), _buffer.data() + _buffer.size());
+  }
+
+ protected:
+  int_type overflow(int_type c) override {
+    if (sync() != 0) {
+      return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+  std::streamsize xsputn(const char* data, std::streamsize size) override {
+    if (size < epptr() - pptr()) {
+      return std::streambuf::xsputn(data, size);
+    }
+    // large blocks are sent without copying them
+    if (sync() != 0) {
+      return 0;
+    }
+    try {
+      send_message_(_fd, _type, {data, static_cast<size_t>(size)});
+    } catch (const std::system_error&) {
+      return 0;
+    }
+    return size;
+  }
+
+  int sync() override {
+    if (pptr() == pbase()) {
+      return 0;
+    }
+    try {
+      send_message_(_fd, _type,
+                    {pbase(), static_cast<size_t>(pptr() - pbase())});
+    } catch (const std::system_error&) {
+      // the client is gone: the stream fails
+      return -1;
+    }
+    setp(_buffer.data(), _buffer.data() + _buffer.size());
+    return 0;
+  }
+
+ private:
+  int _fd;
+  char _type;
+  std::vector<char> _buffer;
+};
+
+// ===== SearchServer ==========================================================
+// _____________________________________________________________________________
+SearchServer::SearchServer(std::string socket_path, handler handler)
+    : _socket_path(std::move(socket_path)), _handler(std::move(handler)) {
+  sockaddr_un address = address_(_socket_path);
+  struct stat st {};
+  if (::stat(_socket_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+    int fd = connect_(_socket_path);
+    if (fd >= 0) {
+      ::close(fd);
+      throw std::system_error(EADDRINUSE, std::generic_category(),
+                              _socket_path);
+    }
+    // left behind by a server that was killed
+    ::unlink(_socket_path.c_str());
+  }
+  _fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  bool bound =
+      _fd >= 0 && ::bind(_fd, reinterpret_cast<sockaddr*>(&address),
+                         sizeof(address)) == 0;
+  // queries run with the permissions of the server: only its owner may
+  //  connect (restricted before connections are accepted)
+  if (!bound || ::chmod(_socket_path.c_str(), S_IRUSR | S_IWUSR) != 0 ||
+      ::listen(_fd, SOMAXCONN) != 0) {
+    int error = errno;
+    if (_fd >= 0) {
+      ::close(_fd);
+    }
+    if (bound) {
+      ::unlink(_socket_path.c_str());
+    }
+    throw std::system_error(error, std::generic_category(), _socket_path);
+  }
+}
+
+// _____________________________________________________________________________
+SearchServer::~SearchServer() {
+  stop();
+  std::unique_lock lock(_mutex);
+  _cv.wait(lock, [this] { return _active == 0; });
+  ::close(_fd);
+  ::unlink(_socket_path.c_str());
+}
+
+// _____________________________________________________________________________
+void SearchServer::run() {
+  while (true) {
+    int fd = ::accept4(_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    int error = errno;
+    std::unique_lock lock(_mutex);
+    if (_stopped) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      break;
+    }
+    if (fd < 0) {
+      if (error == EINTR || error == ECONNABORTED) {
+        continue;
+      }
+      throw std::system_error(error, std::generic_category(), "accept");
+    }
+    _active++;
+    std::thread([this, fd] {
+      answer(fd);
+      ::close(fd);
+      std::unique_lock lock(_mutex);
+      _active--;
+      _cv.notify_all();
+    }).detach();
+  }
+  std::unique_lock lock(_mutex);
+  _cv.wait(lock, [this] { return _active == 0; });
+}
+
+// _____________________________________________________________________________
+void SearchServer::stop() {
+  std::unique_lock lock(_mutex);
+  if (!_stopped) {
+    _stopped = true;
+    // wakes up accept()
+    ::shutdown(_fd, SHUT_RDWR);
+  }
+}
+
+// _____________________________________________________________________________
+void SearchServer::answer(int fd) {
+  try {
+    Query query;
+    char type = 0;
+    std::string payload;
+    while (true) {
+      if (!receive_message_(fd, &type, &payload)) {
+        // the client is gone before it sent its query
+        return;
+      }
+      if (type == 'q') {
+        break;
+      }
+      switch (type) {
+        case 'c':
+          query.cwd = std::move(payload);
+          break;
+        case 't':
+          query.tty = payload == "1";
+          break;
+        case 'a':
+          query.args.push_back(std::move(payload));
+          break;
+        default:
+          throw std::system_error(EPROTO, std::generic_category(),
+                                  "invalid message");
+      }
+    }
+    MessageBuf_ out_buf(fd, 'o');
+    MessageBuf_ err_buf(fd, 'e');
+    std::ostream out(&out_buf);
+    std::ostream err(&err_buf);
+    int status = 2;
+    try {
+      status = _handler(query, out, err);
+    } catch (const std::exception& e) {
+      err << e.what() << '\n';
+    }
+    out.flush();
+    err.flush();
+    send_message_(fd, 'x', std::to_string(status));
+  } catch (const std::exception& e) {
+    // the connection failed: the server continues
+    std::cerr << _socket_path << ": " << e.what() << std::endl;
+  }
+}
+
+// _____________________________________________________________________________
+int SearchServer::query(const std::string& socket_path, const Query& query,
+                        std::ostream& out, std::ostream& err) {
+  int fd = connect_(socket_path);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), socket_path);
+  }
+  try {
+    send_message_(fd, 'c', query.cwd);
+    send_message_(fd, 't', query.tty ? "1" : "0");
+    for (const auto& arg : query.args) {
+      send_message_(fd, 'a', arg);
+    }
+    send_message_(fd, 'q', {});
+    char type = 0;
+    std::string payload;
+    while (receive_message_(fd, &type, &payload)) {
+      switch (type) {
+        case 'o':
+          // passed on as soon as the server found it
+          out.write(payload.data(),
+                    static_cast<std::streamsize>(payload.size()));
+          out.flush();
+          break;
+        case 'e':
+          err.write(payload.data(),
+                    static_cast<std::streamsize>(payload.size()));
+          break;
+        case 'x':
+          ::close(fd);
+          return std::stoi(payload);
+        default:
+          throw std::system_error(EPROTO, std::generic_category(),
+                                  "invalid message");
+      }
+    }
+    throw std::system_error(ECONNRESET, std::generic_category(),
+                            "connection to " + socket_path + " lost");
+  } catch (...) {
+    ::close(fd);
+    throw;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <xsgrep/utils/WorkerPool.h>
+
+// _____________________________________________________________________________
+WorkerPool::WorkerPool(int num_threads) {
+  if (num_threads <= 0) {
+    num_threads = static_cast<int>(std::thread::hardware_concurrency());
+  }
+  if (num_threads <= 0) {
+    num_threads = 1;
+  }
+  _threads.reserve(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    _threads.emplace_back(&WorkerPool::main, this);
+  }
+}
+
+// _____________________________________________________________________________
+WorkerPool::~WorkerPool() {
+  {
+    std::unique_lock lock(_mutex);
+    _stop = true;
+  }
+  _cv.notify_all();
+  for (auto& thread : _threads) {
+    thread.join();
+  }
+}
+
+// _____________________________________________________________________________
+WorkerPool& WorkerPool::global() {
+  static WorkerPool pool;
+  return pool;
+}
+
+// _____________________________________________________________________________
+void WorkerPool::submit(std::function<void()> task) {
+  {
+    std::unique_lock lock(_mutex);
+    _tasks.push_back(std::move(task));
+  }
+  _cv.notify_one();
+}
+
+// _____________________________________________________________________________
+size_t WorkerPool::size() const { return _threads.size(); }
+
+// _____________________________________________________________________________
+void WorkerPool::main() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock lock(_mutex);
+      _cv.wait(lock, [this] { return _stop || !_tasks.empty(); });
+      if (_tasks.empty()) {
+        // stopped and no tasks left
+        return;
+      }
+      task = std::move(_tasks.front());
+      _tasks.pop_front();
+    }
+    task();
+  }
+}
\ No newline at end of file
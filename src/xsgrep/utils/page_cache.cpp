@@ -0,0 +1,89 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <xsgrep/utils/page_cache.h>
+
+#include <algorithm>
+#include <vector>
+
+// ----- Helper functions ------------------------------------------------------
+/// files smaller than this are read: mapping them does not pay off
+const uint64_t min_mmap_size_ = 1 << 20;
+/// minimum fraction of pages in the page cache for memory mapping a file
+const double min_residency_ = 0.5;
+/// number of pages probed per sample
+const size_t sample_pages_ = 16;
+
+// _____________________________________________________________________________
+double page_cache_residency(int fd, uint64_t size, size_t max_samples) {
+  if (size == 0) {
+    return 0;
+  }
+  void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    return 0;
+  }
+  auto page_size = static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+  uint64_t num_pages = (size + page_size - 1) / page_size;
+  max_samples = std::max<size_t>(max_samples, 1);
+  // probe the whole file if it is small, sample windows otherwise
+  uint64_t window = num_pages;
+  uint64_t num_windows = 1;
+  if (num_pages > max_samples * sample_pages_) {
+    window = sample_pages_;
+    num_windows = max_samples;
+  }
+  std::vector<unsigned char> residency(window);
+  uint64_t probed = 0;
+  uint64_t resident = 0;
+  for (uint64_t i = 0; i < num_windows; ++i) {
+    uint64_t first = num_windows == 1
+                         ? 0
+                         : i * (num_pages - window) / (num_windows - 1);
+    char* address = static_cast<char*>(mapping) + first * page_size;
+    uint64_t length = std::min(window * page_size, size - first * page_size);
+    if (::mincore(address, length, residency.data()) != 0) {
+      continue;
+    }
+    uint64_t pages = (length + page_size - 1) / page_size;
+    probed += pages;
+    resident += std::count_if(residency.begin(), residency.begin() + pages,
+                              [](unsigned char c) { return (c & 1) != 0; });
+  }
+  ::munmap(mapping, size);
+  return probed == 0 ? 0 : static_cast<double>(resident) / probed;
+}
+
+// _____________________________________________________________________________
+bool prefer_mmap(int fd, uint64_t size) {
+  return size >= min_mmap_size_ &&
+         page_cache_residency(fd, size) >= min_residency_;
+}
+
+// _____________________________________________________________________________
+bool prefer_mmap(const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st {};
+  bool ret = ::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+             prefer_mmap(fd, static_cast<uint64_t>(st.st_size));
+  ::close(fd);
+  return ret;
+}
+
+// _____________________________________________________________________________
+void advise_sequential(int fd) {
+  ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+// _____________________________________________________________________________
+void advise_will_need(int fd, uint64_t offset, uint64_t size) {
+  ::posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(size),
+                  POSIX_FADV_WILLNEED);
+}
\ No newline at end of file
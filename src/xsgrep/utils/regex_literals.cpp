@@ -0,0 +1,418 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <xsgrep/utils/regex_literals.h>
+#include <xsgrep/utils/search.h>
+
+#include <algorithm>
+#include <cctype>
+#include <optional>
+#include <set>
+#include <stdexcept>
+
+// ----- Helper functions ------------------------------------------------------
+typedef std::optional<std::set<std::string>> literal_set_;
+
+/// maximum number of literals of a set
+const size_t max_literals_ = 64;
+
+/**
+ * LiteralInfo_: What is known about the strings matched by a subexpression.
+ */
+struct LiteralInfo_ {
+  /// all strings the subexpression matches (if known and few)
+  literal_set_ exact;
+  /// every match of the subexpression contains one of these (if known)
+  literal_set_ required;
+};
+
+// _____________________________________________________________________________
+/// exact strings as required literals (not if one of them is empty)
+literal_set_ as_required_(const literal_set_& exact) {
+  if (!exact.has_value() || exact->empty() || exact->contains("")) {
+    return {};
+  }
+  return exact;
+}
+
+// _____________________________________________________________________________
+/// a is a better filter than b: longer shortest literal, then fewer literals
+bool better_(const literal_set_& a, const literal_set_& b) {
+  if (!a.has_value()) {
+    return false;
+  }
+  if (!b.has_value()) {
+    return true;
+  }
+  auto min_length = [](const std::set<std::string>& set) {
+    size_t length = std::string::npos;
+    for (const auto& str : set) {
+      length = std::min(length, str.size());
+    }
+    return length;
+  };
+  size_t a_length = min_length(*a);
+  size_t b_length = min_length(*b);
+  if (a_length != b_length) {
+    return a_length > b_length;
+  }
+  return a->size() < b->size();
+}
+
+// _____________________________________________________________________________
+/// all concatenations of a string of a and a string of b (if not too many)
+literal_set_ cross_(const std::set<std::string>& a,
+                    const std::set<std::string>& b) {
+  if (a.size() * b.size() > max_literals_) {
+    return {};
+  }
+  std::set<std::string> product;
+  for (const auto& x : a) {
+    for (const auto& y : b) {
+      product.insert(x + y);
+    }
+  }
+  return product;
+}
+
+// _____________________________________________________________________________
+/// union of a and b (if not too many)
+literal_set_ union_(const literal_set_& a, const literal_set_& b) {
+  if (!a.has_value() || !b.has_value()) {
+    return {};
+  }
+  std::set<std::string> result(*a);
+  result.insert(b->begin(), b->end());
+  if (result.size() > max_literals_) {
+    return {};
+  }
+  return result;
+}
+
+/**
+ * LiteralParser_: Recursive descent parser computing the LiteralInfo_ of a
+ *  regular expression. Throws std::invalid_argument for constructs that are
+ *  not understood.
+ */
+class LiteralParser_ {
+ public:
+  LiteralParser_(const std::string& pattern, bool ignore_case)
+      : _pattern(pattern), _ignore_case(ignore_case) {}
+
+  /// the pattern contains zero-width assertions (^, $, \b, ...)
+  bool has_assertions() const { return _assertions; }
+
+  LiteralInfo_ parse() {
+    LiteralInfo_ info = alternation();
+    if (_pos != _pattern.size()) {
+      throw std::invalid_argument("unbalanced ')'");
+    }
+    return info;
+  }
+
+ private:
+  bool at_end() const { return _pos >= _pattern.size(); }
+
+  char peek() const { return _pattern[_pos]; }
+
+  LiteralInfo_ alternation() {
+    LiteralInfo_ info = concatenation();
+    if (at_end() || peek() != '|') {
+      return info;
+    }
+    LiteralInfo_ result{info.exact, best_required(info)};
+    while (!at_end() && peek() == '|') {
+      _pos++;
+      LiteralInfo_ branch = concatenation();
+      result.exact = union_(result.exact, branch.exact);
+      result.required = union_(result.required, best_required(branch));
+    }
+    return result;
+  }
+
+  LiteralInfo_ concatenation() {
+    // consecutive exact subexpressions are combined into runs of literals
+    literal_set_ run = std::set<std::string>{""};
+    bool whole = true;
+    literal_set_ required;
+    auto consider = [&required](const literal_set_& candidate) {
+      if (better_(candidate, required)) {
+        required = candidate;
+      }
+    };
+    while (!at_end() && peek() != '|' && peek() != ')') {
+      LiteralInfo_ item = repetition();
+      consider(item.required);
+      if (!item.exact.has_value()) {
+        consider(as_required_(run));
+        run = std::set<std::string>{""};
+        whole = false;
+        continue;
+      }
+      literal_set_ product = cross_(*run, *item.exact);
+      if (!product.has_value()) {
+        consider(as_required_(run));
+        product = item.exact;
+        whole = false;
+      }
+      run = std::move(product);
+    }
+    consider(as_required_(run));
+    return {whole ? run : literal_set_{}, required};
+  }
+
+  LiteralInfo_ repetition() {
+    LiteralInfo_ info = atom();
+    while (!at_end()) {
+      size_t min = 0;
+      size_t max = 0;
+      if (peek() == '*') {
+        max = std::string::npos;
+      } else if (peek() == '+') {
+        min = 1;
+        max = std::string::npos;
+      } else if (peek() == '?') {
+        max = 1;
+      } else if (peek() == '{') {
+        counted_repetition(&min, &max);
+      } else {
+        break;
+      }
+      _pos++;
+      if (!at_end() && peek() == '?') {
+        // non-greedy
+        _pos++;
+      }
+      if (min == 1 && max == 1) {
+        continue;
+      }
+      if (min == 0) {
+        literal_set_ exact;
+        if (max == 1 && info.exact.has_value()) {
+          exact = union_(info.exact, std::set<std::string>{""});
+        }
+        info = {exact, {}};
+      } else {
+        info = {{}, best_required(info)};
+      }
+    }
+    return info;
+  }
+
+  /// parse {n}, {n,} or {n,m}, _pos is left at the closing '}'
+  void counted_repetition(size_t* min, size_t* max) {
+    size_t end = _pattern.find('}', _pos);
+    if (end == std::string::npos) {
+      throw std::invalid_argument("literal '{'");
+    }
+    std::string range = _pattern.substr(_pos + 1, end - _pos - 1);
+    size_t comma = range.find(',');
+    std::string lower = range.substr(0, comma);
+    std::string upper =
+        comma == std::string::npos ? lower : range.substr(comma + 1);
+    auto is_number = [](const std::string& str) {
+      return !str.empty() && std::all_of(str.begin(), str.end(), [](char c) {
+               return std::isdigit(static_cast<unsigned char>(c));
+             });
+    };
+    if (!is_number(lower) || (!upper.empty() && !is_number(upper))) {
+      throw std::invalid_argument("invalid repetition");
+    }
+    *min = std::stoul(lower);
+    *max = upper.empty() ? std::string::npos : std::stoul(upper);
+    _pos = end;
+  }
+
+  LiteralInfo_ atom() {
+    char c = peek();
+    _pos++;
+    switch (c) {
+      case '(': {
+        if (!at_end() && peek() == '?') {
+          // only non-capturing groups without flags are understood
+          if (_pattern.compare(_pos, 2, "?:") != 0) {
+            throw std::invalid_argument("group flags");
+          }
+          _pos += 2;
+        }
+        LiteralInfo_ info = alternation();
+        if (at_end() || peek() != ')') {
+          throw std::invalid_argument("missing ')'");
+        }
+        _pos++;
+        return info;
+      }
+      case '[':
+        return char_class();
+      case '.':
+        return {};
+      case '^':
+      case '$':
+        _assertions = true;
+        return {std::set<std::string>{""}, {}};
+      case '*':
+      case '+':
+      case '?':
+      case '{':
+      case ')':
+        throw std::invalid_argument("unexpected operator");
+      case '\\': {
+        if (at_end()) {
+          throw std::invalid_argument("trailing '\\'");
+        }
+        char escaped = peek();
+        _pos++;
+        if (!std::isalnum(static_cast<unsigned char>(escaped))) {
+          return literal(escaped);
+        }
+        switch (escaped) {
+          case 'b':
+          case 'B':
+          case 'A':
+          case 'z':
+            _assertions = true;
+            return {std::set<std::string>{""}, {}};
+          case 'd':
+          case 'D':
+          case 'w':
+          case 'W':
+          case 's':
+          case 'S':
+            return {};
+          default:
+            // \x, \p, \Q, \n, ...
+            throw std::invalid_argument("unsupported escape");
+        }
+      }
+      default:
+        return literal(c);
+    }
+  }
+
+  LiteralInfo_ literal(char c) {
+    std::string str(1, fold(c));
+    if (static_cast<unsigned char>(c) >= 0x80) {
+      if (_ignore_case) {
+        // non-ASCII case folding is not supported by the literal search
+        throw std::invalid_argument("non-ASCII literal");
+      }
+      // a multi byte (UTF-8) character is a single atom
+      while (!at_end() && (static_cast<unsigned char>(peek()) & 0xC0) == 0x80) {
+        str.push_back(peek());
+        _pos++;
+      }
+    }
+    return {std::set<std::string>{str}, {}};
+  }
+
+  /// [...]: a small set of single byte literals or nothing known
+  LiteralInfo_ char_class() {
+    bool negated = !at_end() && peek() == '^';
+    if (negated) {
+      _pos++;
+    }
+    std::set<char> chars;
+    bool known = !negated;
+    bool first = true;
+    while (true) {
+      if (at_end()) {
+        throw std::invalid_argument("missing ']'");
+      }
+      char c = peek();
+      _pos++;
+      if (c == ']' && !first) {
+        break;
+      }
+      first = false;
+      if (c == '[' && !at_end() && peek() == ':') {
+        // [:alpha:] and friends
+        size_t end = _pattern.find(":]", _pos);
+        if (end == std::string::npos) {
+          throw std::invalid_argument("invalid character class");
+        }
+        _pos = end + 2;
+        known = false;
+        continue;
+      }
+      if (c == '\\') {
+        if (at_end()) {
+          throw std::invalid_argument("trailing '\\'");
+        }
+        c = peek();
+        _pos++;
+        if (std::isalnum(static_cast<unsigned char>(c))) {
+          if (std::string("dDwWsS").find(c) == std::string::npos) {
+            throw std::invalid_argument("unsupported escape");
+          }
+          known = false;
+          continue;
+        }
+      }
+      if (static_cast<unsigned char>(c) >= 0x80) {
+        // multi byte characters
+        throw std::invalid_argument("non-ASCII character class");
+      }
+      char last = c;
+      if (_pos + 1 < _pattern.size() && peek() == '-' &&
+          _pattern[_pos + 1] != ']') {
+        last = _pattern[_pos + 1];
+        _pos += 2;
+        if (last == '\\' || static_cast<unsigned char>(last) >= 0x80 ||
+            last < c) {
+          throw std::invalid_argument("unsupported range");
+        }
+      }
+      for (int x = c; x <= last; ++x) {
+        chars.insert(fold(static_cast<char>(x)));
+      }
+    }
+    if (!known || chars.size() > 8) {
+      return {};
+    }
+    std::set<std::string> exact;
+    for (char c : chars) {
+      exact.insert(std::string(1, c));
+    }
+    return {exact, {}};
+  }
+
+  char fold(char c) const { return _ignore_case ? to_lower_ascii(c) : c; }
+
+  static literal_set_ best_required(const LiteralInfo_& info) {
+    literal_set_ exact = as_required_(info.exact);
+    return better_(exact, info.required) ? exact : info.required;
+  }
+
+  const std::string& _pattern;
+  bool _ignore_case;
+  size_t _pos{0};
+  bool _assertions{false};
+};
+
+// _____________________________________________________________________________
+std::vector<std::string> required_literals(const std::string& pattern,
+                                           bool ignore_case, bool* exact) {
+  literal_set_ required;
+  bool is_exact = false;
+  try {
+    LiteralParser_ parser(pattern, ignore_case);
+    LiteralInfo_ info = parser.parse();
+    required = as_required_(info.exact);
+    is_exact = required.has_value() && !parser.has_assertions();
+    if (better_(info.required, required)) {
+      required = info.required;
+      is_exact = false;
+    }
+  } catch (const std::invalid_argument&) {
+    return {};
+  }
+  if (!required.has_value() ||
+      std::any_of(required->begin(), required->end(),
+                  [](const std::string& str) { return str.size() < 2; })) {
+    return {};
+  }
+  if (exact != nullptr) {
+    *exact = is_exact;
+  }
+  return {required->begin(), required->end()};
+}
\ No newline at end of file
@@ -0,0 +1,155 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <xsgrep/utils/search.h>
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// ----- Helper functions ------------------------------------------------------
+// _____________________________________________________________________________
+char to_upper_ascii_(char c) {
+  return (c >= 'a' && c <= 'z') ? static_cast<char>(c & ~0x20) : c;
+}
+
+// _____________________________________________________________________________
+/// compare a with the lower case needle b (size bytes) ignoring case
+bool equal_icase_(const char* a, const char* b, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    if (to_lower_ascii(a[i]) != b[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// _____________________________________________________________________________
+const char* find_icase_scalar_(const char* haystack, size_t haystack_size,
+                               const char* needle, size_t needle_size,
+                               size_t start) {
+  for (size_t i = start; i + needle_size <= haystack_size; ++i) {
+    if (to_lower_ascii(haystack[i]) == needle[0] &&
+        equal_icase_(haystack + i + 1, needle + 1, needle_size - 1)) {
+      return haystack + i;
+    }
+  }
+  return nullptr;
+}
+
+// _____________________________________________________________________________
+const char* find_icase(const char* haystack, size_t haystack_size,
+                       const char* needle, size_t needle_size) {
+  if (needle_size == 0) {
+    return haystack;
+  }
+  if (needle_size > haystack_size) {
+    return nullptr;
+  }
+  size_t i = 0;
+  const size_t last = needle_size - 1;
+#if defined(__AVX2__)
+  const __m256i first_lo = _mm256_set1_epi8(needle[0]);
+  const __m256i first_up = _mm256_set1_epi8(to_upper_ascii_(needle[0]));
+  const __m256i last_lo = _mm256_set1_epi8(needle[last]);
+  const __m256i last_up = _mm256_set1_epi8(to_upper_ascii_(needle[last]));
+  for (; i + last + 32 <= haystack_size; i += 32) {
+    const __m256i block_first = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(haystack + i));
+    const __m256i block_last = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(haystack + i + last));
+    const __m256i eq_first =
+        _mm256_or_si256(_mm256_cmpeq_epi8(block_first, first_lo),
+                        _mm256_cmpeq_epi8(block_first, first_up));
+    const __m256i eq_last =
+        _mm256_or_si256(_mm256_cmpeq_epi8(block_last, last_lo),
+                        _mm256_cmpeq_epi8(block_last, last_up));
+    auto mask = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_and_si256(eq_first, eq_last)));
+    while (mask != 0) {
+      const int bit = __builtin_ctz(mask);
+      if (equal_icase_(haystack + i + bit + 1, needle + 1, needle_size - 1)) {
+        return haystack + i + bit;
+      }
+      mask &= mask - 1;
+    }
+  }
+#elif defined(__SSE2__)
+  const __m128i first_lo = _mm_set1_epi8(needle[0]);
+  const __m128i first_up = _mm_set1_epi8(to_upper_ascii_(needle[0]));
+  const __m128i last_lo = _mm_set1_epi8(needle[last]);
+  const __m128i last_up = _mm_set1_epi8(to_upper_ascii_(needle[last]));
+  for (; i + last + 16 <= haystack_size; i += 16) {
+    const __m128i block_first =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i));
+    const __m128i block_last =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i + last));
+    const __m128i eq_first = _mm_or_si128(_mm_cmpeq_epi8(block_first, first_lo),
+                                          _mm_cmpeq_epi8(block_first, first_up));
+    const __m128i eq_last = _mm_or_si128(_mm_cmpeq_epi8(block_last, last_lo),
+                                         _mm_cmpeq_epi8(block_last, last_up));
+    auto mask = static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_and_si128(eq_first, eq_last)));
+    while (mask != 0) {
+      const int bit = __builtin_ctz(mask);
+      if (equal_icase_(haystack + i + bit + 1, needle + 1, needle_size - 1)) {
+        return haystack + i + bit;
+      }
+      mask &= mask - 1;
+    }
+  }
+#endif
+  // remaining bytes (or no SIMD available)
+  return find_icase_scalar_(haystack, haystack_size, needle, needle_size, i);
+}
+
+// _____________________________________________________________________________
+uint64_t count_new_lines(const char* data, size_t size) {
+  uint64_t count = 0;
+  size_t i = 0;
+  // the per byte counters are summed up before they can overflow (255 blocks)
+#if defined(__AVX2__)
+  const __m256i new_line = _mm256_set1_epi8('\n');
+  const __m256i zero = _mm256_setzero_si256();
+  while (i + 32 <= size) {
+    size_t num_blocks = std::min<size_t>((size - i) / 32, 255);
+    __m256i counters = zero;
+    for (size_t b = 0; b < num_blocks; ++b, i += 32) {
+      const __m256i block =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+      // matching bytes are -1: subtracting them increments the counters
+      counters = _mm256_sub_epi8(counters, _mm256_cmpeq_epi8(block, new_line));
+    }
+    const __m256i sums = _mm256_sad_epu8(counters, zero);
+    count += static_cast<uint64_t>(_mm256_extract_epi64(sums, 0)) +
+             static_cast<uint64_t>(_mm256_extract_epi64(sums, 1)) +
+             static_cast<uint64_t>(_mm256_extract_epi64(sums, 2)) +
+             static_cast<uint64_t>(_mm256_extract_epi64(sums, 3));
+  }
+#elif defined(__SSE2__)
+  const __m128i new_line = _mm_set1_epi8('\n');
+  const __m128i zero = _mm_setzero_si128();
+  while (i + 16 <= size) {
+    size_t num_blocks = std::min<size_t>((size - i) / 16, 255);
+    __m128i counters = zero;
+    for (size_t b = 0; b < num_blocks; ++b, i += 16) {
+      const __m128i block =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+      // matching bytes are -1: subtracting them increments the counters
+      counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(block, new_line));
+    }
+    const __m128i sums = _mm_sad_epu8(counters, zero);
+    const __m128i high = _mm_srli_si128(sums, 8);
+    count += static_cast<uint64_t>(_mm_cvtsi128_si64(sums)) +
+             static_cast<uint64_t>(_mm_cvtsi128_si64(high));
+  }
+#endif
+  // remaining bytes (or no SIMD available)
+  for (; i < size; ++i) {
+    count += data[i] == '\n';
+  }
+  return count;
+}
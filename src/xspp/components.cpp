@@ -1,51 +1,271 @@
 // Copyright 2023, Leon Freist
 // Author: Leon Freist <freist@informatik.uni-freiburg.de>
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <xsgrep/xspp/components.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+
+// ----- Helper functions ------------------------------------------------------
+// _____________________________________________________________________________
+/// read up to size bytes at offset of fd (retries on partial reads)
+size_t pread_all_(int fd, char* buffer, size_t size, uint64_t offset) {
+  size_t total = 0;
+  while (total < size) {
+    ssize_t n = ::pread(fd, buffer + total, size - total,
+                        static_cast<off_t>(offset + total));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    total += static_cast<size_t>(n);
+  }
+  return total;
+}
+
+// _____________________________________________________________________________
+/// write all size bytes of data at offset of fd (retries on partial writes)
+void pwrite_all_(int fd, const char* data, size_t size, uint64_t offset) {
+  while (size > 0) {
+    ssize_t n = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(),
+                              "error writing output");
+    }
+    data += n;
+    size -= static_cast<size_t>(n);
+    offset += static_cast<uint64_t>(n);
+  }
+}
+
 // ----- MetaDataCreator -------------------------------------------------------
 // _____________________________________________________________________________
 preprocess_result MetaDataCreator::process(const xs::DataChunk* data) const {
   return {std::move(data->getMetaData()), std::move(*data)};
 }
 
+// ----- ProcessedPrefix -------------------------------------------------------
+// _____________________________________________________________________________
+ProcessedPrefix ProcessedPrefix::read(const std::string& meta_file_path,
+                                      const std::string& source_path) {
+  ProcessedPrefix prefix;
+  xs::MetaFile meta_file(meta_file_path, std::ios::in);
+  prefix.compression_type = meta_file.get_compression_type();
+  while (auto meta_data = meta_file.next_chunk_meta_data()) {
+    prefix.original_size = std::max(
+        prefix.original_size, meta_data->original_offset +
+                                  meta_data->original_size);
+    prefix.actual_size = std::max(
+        prefix.actual_size, meta_data->actual_offset + meta_data->actual_size);
+    prefix.chunks.push_back(std::move(*meta_data));
+  }
+  if (std::filesystem::file_size(source_path) < prefix.original_size) {
+    throw std::runtime_error(source_path +
+                             ": shorter than the data of its metafile.");
+  }
+  if (!prefix.chunks.empty()) {
+    char last = '\n';
+    std::ifstream source(source_path, std::ios::binary);
+    source.seekg(static_cast<std::streamoff>(prefix.original_size - 1));
+    source.get(last);
+    if (last != '\n') {
+      // the data of the dropped chunk remain unused in the output file
+      prefix.original_size = prefix.chunks.back().original_offset;
+      prefix.next_chunk_index = prefix.chunks.back().chunk_index;
+      prefix.chunks.pop_back();
+    } else {
+      prefix.next_chunk_index = prefix.chunks.back().chunk_index + 1;
+    }
+  }
+  return prefix;
+}
+
+// ----- TailReader ------------------------------------------------------------
+// _____________________________________________________________________________
+TailReader::TailReader(const std::string& path, uint64_t offset,
+                       uint64_t first_chunk_index, size_t min_size)
+    : _fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC)),
+      _offset(offset),
+      _chunk_index(first_chunk_index),
+      _min_size(std::max<size_t>(min_size, 1)) {
+  struct stat st {};
+  if (_fd < 0 || ::fstat(_fd, &st) != 0) {
+    int error = errno;
+    if (_fd >= 0) {
+      ::close(_fd);
+    }
+    throw std::system_error(error, std::generic_category(), path);
+  }
+  // search the last new line backwards
+  char buffer[1 << 16];
+  uint64_t end = static_cast<uint64_t>(st.st_size);
+  while (end > _offset && _end == 0) {
+    size_t n = std::min<uint64_t>(sizeof(buffer), end - _offset);
+    end -= n;
+    if (pread_all_(_fd, buffer, n, end) != n) {
+      int error = errno;
+      ::close(_fd);
+      throw std::system_error(error, std::generic_category(), path);
+    }
+    if (const void* nl = ::memrchr(buffer, '\n', n)) {
+      _end = end + (static_cast<const char*>(nl) - buffer) + 1;
+    }
+  }
+}
+
+// _____________________________________________________________________________
+TailReader::~TailReader() { ::close(_fd); }
+
+// _____________________________________________________________________________
+std::optional<std::pair<xs::DataChunk, xs::chunk_index>>
+TailReader::getNextData() {
+  std::unique_lock lock(_mutex);
+  if (_offset >= _end) {
+    return {};
+  }
+  std::string data(std::min<uint64_t>(_min_size, _end - _offset), '\0');
+  size_t size = pread_all_(_fd, data.data(), data.size(), _offset);
+  // extend the chunk to the end of its last line (_end follows a new line)
+  while (size == data.size() && data.back() != '\n') {
+    size_t n = std::min<uint64_t>(4096, _end - _offset - size);
+    data.resize(size + n);
+    size += pread_all_(_fd, data.data() + size, n, _offset + size);
+    if (const void* nl = std::memchr(data.data() + size - n, '\n', n)) {
+      data.resize(static_cast<const char*>(nl) - data.data() + 1);
+      size = data.size();
+    }
+  }
+  if (size < data.size()) {
+    throw std::runtime_error("file shrank while it was read.");
+  }
+  xs::DataChunk chunk(size);
+  std::memcpy(chunk.data(), data.data(), size);
+  chunk.getMetaData() = {_chunk_index++, _offset, _offset, size, size, {}};
+  _offset += size;
+  return {std::make_pair(std::move(chunk), _id++)};
+}
+
+// ----- NgramFilterTable ------------------------------------------------------
+// _____________________________________________________________________________
+void NgramFilterTable::insert(uint64_t chunk_index, NgramFilter filter) {
+  std::unique_lock lock(_mutex);
+  _filters.insert_or_assign(chunk_index, std::move(filter));
+}
+
+// _____________________________________________________________________________
+std::optional<NgramFilter> NgramFilterTable::extract(uint64_t chunk_index) {
+  std::unique_lock lock(_mutex);
+  auto search = _filters.find(chunk_index);
+  if (search == _filters.end()) {
+    return {};
+  }
+  NgramFilter filter = std::move(search->second);
+  _filters.erase(search);
+  return filter;
+}
+
+// ----- NgramIndexer ----------------------------------------------------------
+// _____________________________________________________________________________
+NgramIndexer::NgramIndexer(size_t num_bytes,
+                           std::shared_ptr<NgramFilterTable> filters)
+    : _num_bytes(num_bytes), _filters(std::move(filters)) {}
+
+// _____________________________________________________________________________
+void NgramIndexer::process(xs::DataChunk* data) const {
+  NgramFilter filter(_num_bytes);
+  filter.add(data->data(), data->size());
+  _filters->insert(data->getMetaData().chunk_index, std::move(filter));
+}
+
 // ----- DataWriter ------------------------------------------------------------
 // _____________________________________________________________________________
 DataWriter::DataWriter(const std::string& meta_file_path,
                        xs::CompressionType compressionType,
-                       std::unique_ptr<std::ostream> out_stream)
+                       const std::string& output_file_path,
+                       std::shared_ptr<NgramFilterTable> ngram_filters,
+                       std::unique_ptr<std::ostream> ngram_stream,
+                       const ProcessedPrefix& prefix)
     : _meta_file(meta_file_path, std::ios::out, compressionType),
-      _output_stream(std::move(out_stream)) {}
+      _compression_type(compressionType),
+      _prefix_original_size(prefix.original_size),
+      _prefix_actual_size(prefix.actual_size),
+      _output_size(prefix.actual_size),
+      _ngram_filters(std::move(ngram_filters)),
+      _ngram_stream(std::move(ngram_stream)),
+      _sequencer(max_pending, [this](uint64_t, xs::ChunkMetaData meta_data) {
+        _meta_file.write_chunk_meta_data(meta_data);
+      }) {
+  if (!output_file_path.empty()) {
+    // the data of the processed prefix are kept
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+    _output_fd = ::open(output_file_path.c_str(),
+                        prefix.actual_size == 0 ? flags | O_TRUNC : flags,
+                        0644);
+    if (_output_fd < 0) {
+      throw std::system_error(errno, std::generic_category(),
+                              output_file_path);
+    }
+  }
+  for (const auto& meta_data : prefix.chunks) {
+    _meta_file.write_chunk_meta_data(meta_data);
+  }
+}
+
+// _____________________________________________________________________________
+DataWriter::~DataWriter() {
+  if (_output_fd >= 0) {
+    ::close(_output_fd);
+  }
+}
 
 // _____________________________________________________________________________
 void DataWriter::add(preprocess_result data, uint64_t id) {
-  std::unique_lock lock(*this->_mutex);
-  if (_current_index == id) {
-    add(std::move(data));
-    _current_index++;
-    while (true) {
-      auto search = _buffer.find(_current_index);
-      if (search == _buffer.end()) {
-        break;
-      }
-      add(std::move(search->second));
-      _buffer.erase(_current_index);
-      _current_index++;
+  if (_output_fd >= 0) {
+    size_t size = data.second.size();
+    // uncompressed chunks are stored in order (the output is a copy of the
+    //  input), compressed ones where their space was reserved
+    uint64_t offset =
+        _compression_type == xs::CompressionType::NONE
+            ? _prefix_actual_size +
+                  (data.first.original_offset - _prefix_original_size)
+            : _output_size.fetch_add(size, std::memory_order_relaxed);
+    pwrite_all_(_output_fd, data.second.data(), size, offset);
+    data.first.actual_offset = offset;
+  }
+  if (_ngram_stream != nullptr) {
+    // filters are identified by the original offset of their chunk
+    auto filter = _ngram_filters->extract(data.first.chunk_index);
+    if (filter.has_value()) {
+      std::unique_lock lock(_ngram_mutex);
+      filter->write(*_ngram_stream, data.first.original_offset);
     }
-    // at least one partial_result was added -> notify
-    this->_cv->notify_all();
-  } else {
-    // buffer the partial result
-    _buffer.insert({id, std::move(data)});
   }
+  _sequencer.publish(id, std::move(data.first));
 }
 
 // _____________________________________________________________________________
-void DataWriter::add(preprocess_result data) {
-  if (_output_stream != nullptr) {
-    // write data to output file
-    _output_stream->write(data.second.data(),
-                          static_cast<int64_t>(data.second.size()));
+void DataWriter::finish() {
+  _sequencer.close();
+  if (_ngram_stream != nullptr) {
+    _ngram_stream->flush();
   }
-  _meta_file.write_chunk_meta_data(data.first);
+}
+
+// _____________________________________________________________________________
+void DataWriter::add(preprocess_result data) {
+  uint64_t id = data.first.chunk_index;
+  add(std::move(data), id);
 }
\ No newline at end of file
@@ -0,0 +1,169 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <gtest/gtest.h>
+#include <xsgrep/xspp/components.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+// _____________________________________________________________________________
+std::string read_file(const std::filesystem::path& path) {
+  std::ifstream stream(path, std::ios::binary);
+  std::stringstream content;
+  content << stream.rdbuf();
+  return content.str();
+}
+
+// _____________________________________________________________________________
+std::vector<xs::ChunkMetaData> read_meta_file(
+    const std::filesystem::path& path) {
+  std::vector<xs::ChunkMetaData> chunks;
+  xs::MetaFile meta_file(path.string(), std::ios::in);
+  while (auto meta_data = meta_file.next_chunk_meta_data()) {
+    chunks.push_back(std::move(*meta_data));
+  }
+  return chunks;
+}
+
+// _____________________________________________________________________________
+/// a chunk of data (written as is, whatever the compression type)
+preprocess_result make_chunk(uint64_t index, uint64_t offset,
+                             const std::string& data) {
+  xs::ChunkMetaData meta_data{index,       offset,      offset,
+                              data.size(), data.size(), {}};
+  return {meta_data, xs::DataChunk(data.data(), data.size(), meta_data)};
+}
+
+// _____________________________________________________________________________
+TEST(ComponentsTest, data_writer_out_of_order) {
+  auto dir = std::filesystem::temp_directory_path() / "xsgrep_writer_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  std::vector<std::string> lines = {"Sherlock\n", "Holmes and\n", "Watson\n"};
+  std::string input = lines[0] + lines[1] + lines[2];
+  {
+    // uncompressed: the output is a copy of the input
+    {
+      DataWriter writer((dir / "plain.meta").string(),
+                        xs::CompressionType::NONE, (dir / "plain").string());
+      writer.add(make_chunk(2, 20, lines[2]), 2);
+      writer.add(make_chunk(0, 0, lines[0]), 0);
+      writer.add(make_chunk(1, 9, lines[1]), 1);
+      writer.finish();
+    }
+    ASSERT_EQ(read_file(dir / "plain"), input);
+    auto chunks = read_meta_file(dir / "plain.meta");
+    ASSERT_EQ(chunks.size(), 3);
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      ASSERT_EQ(chunks[i].chunk_index, i);
+      ASSERT_EQ(chunks[i].actual_offset, chunks[i].original_offset);
+    }
+  }
+  {
+    // appended: the new chunks follow the data of the prefix
+    ProcessedPrefix prefix;
+    prefix.original_size = input.size();
+    prefix.actual_size = input.size();
+    prefix.next_chunk_index = 3;
+    prefix.chunks = read_meta_file(dir / "plain.meta");
+    {
+      DataWriter writer((dir / "plain.meta").string(),
+                        xs::CompressionType::NONE, (dir / "plain").string(),
+                        nullptr, nullptr, prefix);
+      writer.add(make_chunk(4, 36, lines[1]), 1);
+      writer.add(make_chunk(3, 27, lines[0]), 0);
+      writer.finish();
+    }
+    ASSERT_EQ(read_file(dir / "plain"), input + lines[0] + lines[1]);
+    auto chunks = read_meta_file(dir / "plain.meta");
+    ASSERT_EQ(chunks.size(), 5);
+    ASSERT_EQ(chunks[3].chunk_index, 3);
+    ASSERT_EQ(chunks[3].actual_offset, 27);
+    ASSERT_EQ(chunks[4].actual_offset, 36);
+  }
+  {
+    // compressed: chunks are stored where they were written, the metafile
+    //  records where
+    {
+      DataWriter writer((dir / "lz4.meta").string(), xs::CompressionType::LZ4,
+                        (dir / "lz4").string());
+      writer.add(make_chunk(1, 9, lines[1]), 1);
+      writer.add(make_chunk(2, 20, lines[2]), 2);
+      writer.add(make_chunk(0, 0, lines[0]), 0);
+      writer.finish();
+    }
+    std::string output = read_file(dir / "lz4");
+    ASSERT_EQ(output, lines[1] + lines[2] + lines[0]);
+    auto chunks = read_meta_file(dir / "lz4.meta");
+    ASSERT_EQ(chunks.size(), 3);
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      ASSERT_EQ(chunks[i].chunk_index, i);
+      ASSERT_EQ(output.substr(chunks[i].actual_offset, chunks[i].actual_size),
+                lines[i]);
+    }
+  }
+  std::filesystem::remove_all(dir);
+}
+
+// _____________________________________________________________________________
+TEST(ComponentsTest, processed_prefix) {
+  auto dir = std::filesystem::temp_directory_path() / "xsgrep_prefix_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  auto source = (dir / "source").string();
+  auto meta = (dir / "source.meta").string();
+  {
+    xs::MetaFile meta_file(meta, std::ios::out, xs::CompressionType::NONE);
+    meta_file.write_chunk_meta_data({0, 0, 0, 4, 4, {}});
+    meta_file.write_chunk_meta_data({1, 4, 4, 2, 2, {}});
+  }
+  {
+    // the prefix ends within a line: its last chunk is processed again
+    std::ofstream(source) << "aaa\nbbbb\ncc";
+    auto prefix = ProcessedPrefix::read(meta, source);
+    ASSERT_EQ(prefix.chunks.size(), 1);
+    ASSERT_EQ(prefix.original_size, 4);
+    ASSERT_EQ(prefix.actual_size, 6);
+    ASSERT_EQ(prefix.next_chunk_index, 1);
+  }
+  {
+    // the prefix ends at a new line: all chunks are kept
+    std::ofstream(source) << "aaa\nb\nccc\n";
+    auto prefix = ProcessedPrefix::read(meta, source);
+    ASSERT_EQ(prefix.chunks.size(), 2);
+    ASSERT_EQ(prefix.original_size, 6);
+    ASSERT_EQ(prefix.actual_size, 6);
+    ASSERT_EQ(prefix.next_chunk_index, 2);
+  }
+  // the source was truncated
+  std::ofstream(source) << "aaa\n";
+  ASSERT_THROW(ProcessedPrefix::read(meta, source), std::runtime_error);
+  std::filesystem::remove_all(dir);
+}
+
+// _____________________________________________________________________________
+TEST(ComponentsTest, tail_reader) {
+  auto path = std::filesystem::temp_directory_path() / "xsgrep_tail_test";
+  std::ofstream(path) << "aaa\nbbbbbb\ncc\ndd";
+  // the chunks continue the processed prefix "aaa\n"
+  TailReader reader(path.string(), 4, 5, 3);
+  auto chunk = reader.getNextData();
+  ASSERT_TRUE(chunk.has_value());
+  // extended to the end of its line
+  ASSERT_EQ(std::string(chunk->first.data(), chunk->first.size()),
+            "bbbbbb\n");
+  ASSERT_EQ(chunk->second, 0);
+  ASSERT_EQ(chunk->first.getMetaData().chunk_index, 5);
+  ASSERT_EQ(chunk->first.getMetaData().original_offset, 4);
+  chunk = reader.getNextData();
+  ASSERT_TRUE(chunk.has_value());
+  ASSERT_EQ(std::string(chunk->first.data(), chunk->first.size()), "cc\n");
+  ASSERT_EQ(chunk->second, 1);
+  ASSERT_EQ(chunk->first.getMetaData().chunk_index, 6);
+  ASSERT_EQ(chunk->first.getMetaData().original_offset, 11);
+  // the incomplete last line is left for the next run
+  ASSERT_FALSE(reader.getNextData().has_value());
+  std::filesystem::remove(path);
+}
@@ -2,4 +2,251 @@
 // Author: Leon Freist <freist@informatik.uni-freiburg.de>
 
 #include <gtest/gtest.h>
-#include <xsgrep/tasks/GrepReader.h>
\ No newline at end of file
+#include <unistd.h>
+#include <xsgrep/tasks/GrepReader.h>
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+// _____________________________________________________________________________
+/// read all chunks of reader and reassemble the files from them
+std::map<std::string, std::string> read_all(GrepReader* reader,
+                                            size_t* num_chunks) {
+  std::map<std::string, std::string> files;
+  std::vector<std::pair<DataChunk, chunk_index>> chunks;
+  while (true) {
+    auto chunk = reader->getNextData();
+    if (!chunk.has_value()) {
+      break;
+    }
+    chunks.push_back(std::move(*chunk));
+  }
+  *num_chunks = chunks.size();
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    EXPECT_EQ(chunks[i].second, i);
+    auto chunk_files = reader->chunk_files()->extract(chunks[i].second);
+    EXPECT_TRUE(chunk_files.has_value());
+    for (const auto& file : *chunk_files) {
+      auto& content = files[file.file_name];
+      EXPECT_EQ(content.size(), file.file_offset);
+      // chunks only contain complete lines
+      EXPECT_TRUE(content.empty() || content.back() == '\n');
+      content.append(chunks[i].first.data() + file.chunk_offset, file.size);
+    }
+  }
+  return files;
+}
+
+TEST(GrepReaderTest, pack_and_split) {
+  auto dir = std::filesystem::temp_directory_path() / "xsgrep_reader_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir / "sub");
+  std::map<std::string, std::string> expected;
+  for (int i = 0; i < 20; ++i) {
+    std::string path = (dir / ("small" + std::to_string(i))).string();
+    expected[path] = "small file " + std::to_string(i) + "\nwithout new line";
+  }
+  expected[(dir / "sub" / "empty").string()] = "";
+  std::string large;
+  for (int i = 0; i < 1000; ++i) {
+    large += "line " + std::to_string(i) + " of a large file\n";
+  }
+  expected[(dir / "sub" / "large").string()] = large;
+  for (const auto& [path, content] : expected) {
+    std::ofstream(path) << content;
+  }
+
+  GrepReader reader(dir.string(), -1, 2, 128, 1000);
+  size_t num_chunks = 0;
+  auto files = read_all(&reader, &num_chunks);
+  ASSERT_EQ(files, expected);
+  // 20 small files (< 128 bytes per pack), large file split into 1000 byte
+  //  stripes
+  ASSERT_LT(num_chunks, 20 + (large.size() + 999) / 1000 + 1);
+  ASSERT_GE(num_chunks, (large.size() + 999) / 1000);
+  std::filesystem::remove_all(dir);
+}
+
+// _____________________________________________________________________________
+TEST(GrepReaderTest, max_pack_files) {
+  auto dir = std::filesystem::temp_directory_path() / "xsgrep_pack_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  size_t num_files = 3 * GrepReader::max_pack_files;
+  for (size_t i = 0; i < num_files; ++i) {
+    // empty files: the pack size alone would not limit the number of files
+    std::ofstream((dir / std::to_string(i)).string());
+  }
+
+  GrepReader reader(dir.string());
+  size_t num_packed = 0;
+  while (auto chunk = reader.getNextData()) {
+    auto chunk_files = reader.chunk_files()->extract(chunk->second);
+    ASSERT_LE(chunk_files->size(), GrepReader::max_pack_files);
+    num_packed += chunk_files->size();
+  }
+  ASSERT_EQ(num_packed, num_files);
+  std::filesystem::remove_all(dir);
+}
+
+// _____________________________________________________________________________
+TEST(GrepReaderTest, errors) {
+  auto dir = std::filesystem::temp_directory_path() / "xsgrep_errors_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  std::ofstream((dir / "readable").string()) << "readable\n";
+  std::string unreadable = (dir / "unreadable").string();
+  std::ofstream(unreadable) << "unreadable\n";
+  std::filesystem::permissions(unreadable, std::filesystem::perms::none);
+  if (::access(unreadable.c_str(), R_OK) == 0) {
+    std::filesystem::remove_all(dir);
+    GTEST_SKIP() << "files without permissions can be read";
+  }
+  std::stringstream stream;
+  auto errors = std::make_shared<ErrorLog>(&stream);
+  GrepReader reader(dir.string(), -1, 1, GrepReader::default_pack_size,
+                    GrepReader::default_stripe_size, errors);
+  size_t num_chunks = 0;
+  auto files = read_all(&reader, &num_chunks);
+  // the search goes on, the error is reported to the stream of the log
+  ASSERT_EQ(files.size(), 1);
+  ASSERT_EQ(errors->count(), 1);
+  ASSERT_TRUE(stream.str().starts_with(unreadable + ": "));
+  std::filesystem::remove_all(dir);
+}
+
+// _____________________________________________________________________________
+TEST(GrepReaderTest, meta_files) {
+  auto dir = std::filesystem::temp_directory_path() / "xsgrep_meta_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  std::string content("first chunk\nsecond chunk\n");
+  std::ofstream((dir / "data").string()) << content;
+  std::ofstream((dir / "plain").string()) << "plain file\n";
+  // the suffix matches, but there is no file "orphan": it is a regular file
+  std::ofstream((dir / "orphan.meta").string()) << "orphan file\n";
+  {
+    MetaFile meta_file((dir / "data.meta").string(), std::ios::out,
+                       CompressionType::NONE);
+    meta_file.write_chunk_meta_data({0, 0, 0, 12, 12, {{0, 0}}});
+    meta_file.write_chunk_meta_data({1, 12, 12, 13, 13, {{12, 1}}});
+  }
+
+  GrepReader reader(dir.string());
+  reader.set_use_mmap(true).set_meta_file_suffix(".meta");
+  std::map<std::string, std::vector<ChunkFile>> files;
+  while (true) {
+    auto chunk = reader.getNextData();
+    if (!chunk.has_value()) {
+      break;
+    }
+    ASSERT_EQ(chunk->first.getMetaData().chunk_index, chunk->second);
+    auto chunk_files = reader.chunk_files()->extract(chunk->second);
+    for (auto& file : *chunk_files) {
+      files[file.file_name].push_back(file);
+    }
+  }
+  // the metafile is not read as a file
+  ASSERT_EQ(files.size(), 3);
+  const auto& data_chunks = files[(dir / "data").string()];
+  ASSERT_EQ(data_chunks.size(), 2);
+  ASSERT_TRUE(data_chunks[0].line_mapping);
+  ASSERT_EQ(data_chunks[1].file_offset, 12);
+  ASSERT_EQ(data_chunks[1].size, 13);
+  ASSERT_FALSE(files[(dir / "plain").string()].front().line_mapping);
+  ASSERT_FALSE(files[(dir / "orphan.meta").string()].front().line_mapping);
+
+  // the root is a file: the metafile is not taken from a directory listing
+  GrepReader file_reader((dir / "data").string());
+  file_reader.set_meta_file_suffix(".meta");
+  size_t num_chunks = 0;
+  while (auto chunk = file_reader.getNextData()) {
+    auto chunk_files = file_reader.chunk_files()->extract(chunk->second);
+    ASSERT_TRUE(chunk_files->front().line_mapping);
+    num_chunks++;
+  }
+  ASSERT_EQ(num_chunks, 2);
+  std::filesystem::remove_all(dir);
+}
+
+// _____________________________________________________________________________
+TEST(GrepReaderTest, ngram_filters) {
+  auto dir = std::filesystem::temp_directory_path() / "xsgrep_ngram_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  std::string content("first chunk\nsecond chunk\n");
+  std::ofstream((dir / "data").string()) << content;
+  {
+    MetaFile meta_file((dir / "data.meta").string(), std::ios::out,
+                       CompressionType::NONE);
+    meta_file.write_chunk_meta_data({0, 0, 0, 12, 12, {{0, 0}}});
+    meta_file.write_chunk_meta_data({1, 12, 12, 13, 13, {{12, 1}}});
+    std::ofstream filters((dir / "data.meta.ngrams").string(),
+                          std::ios::binary);
+    NgramFilter::write_header(filters, 64);
+    for (uint64_t offset : {0, 12}) {
+      NgramFilter filter(64);
+      filter.add(content.data() + offset, offset == 0 ? 12 : 13);
+      filter.write(filters, offset);
+    }
+  }
+
+  GrepReader reader(dir.string());
+  reader.set_meta_file_suffix(".meta").set_ngram_literals({"Second"});
+  std::vector<std::pair<size_t, ChunkFile>> chunks;
+  while (true) {
+    auto chunk = reader.getNextData();
+    if (!chunk.has_value()) {
+      break;
+    }
+    auto chunk_files = reader.chunk_files()->extract(chunk->second);
+    // neither the metafile nor the filter file is read as a file
+    ASSERT_EQ(chunk_files->size(), 1);
+    chunks.emplace_back(chunk->first.size(), chunk_files->front());
+  }
+  ASSERT_EQ(chunks.size(), 2);
+  // the first chunk cannot contain "second": it is returned empty
+  ASSERT_EQ(chunks[0].first, 0);
+  ASSERT_EQ(chunks[0].second.size, 0);
+  ASSERT_EQ(chunks[0].second.file_offset, 0);
+  ASSERT_EQ(chunks[1].first, 13);
+  ASSERT_EQ(chunks[1].second.size, 13);
+  std::filesystem::remove_all(dir);
+}
+
+// _____________________________________________________________________________
+TEST(GrepReaderTest, file_cache) {
+  auto dir = std::filesystem::temp_directory_path() / "xsgrep_cache_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  std::string large;
+  for (int i = 0; i < 100; ++i) {
+    large += "line " + std::to_string(i) + " of a large file\n";
+  }
+  std::string path = (dir / "large").string();
+  std::ofstream(path) << large;
+  std::ofstream((dir / "small").string()) << "small file\n";
+
+  auto cache = std::make_shared<FileCache>(4, 1000);
+  for (int i = 0; i < 2; ++i) {
+    GrepReader reader(dir.string(), -1, 1, 1000, 500);
+    reader.set_file_cache(cache);
+    size_t num_chunks = 0;
+    auto files = read_all(&reader, &num_chunks);
+    ASSERT_EQ(files[path], large);
+    ASSERT_EQ(files[(dir / "small").string()], "small file\n");
+    // only the large file is kept
+    ASSERT_EQ(cache->size(), 1);
+  }
+  // a changed file is opened again
+  large += "appended line\n";
+  std::ofstream(path, std::ios::app) << "appended line\n";
+  GrepReader reader(path);
+  reader.set_file_cache(cache);
+  size_t num_chunks = 0;
+  ASSERT_EQ(read_all(&reader, &num_chunks)[path], large);
+  ASSERT_EQ(cache->size(), 1);
+  std::filesystem::remove_all(dir);
+}
@@ -3,3 +3,317 @@
 
 #include <gtest/gtest.h>
 #include <xsgrep/tasks/GrepResult.h>
+
+#include <filesystem>
+#include <sstream>
+
+// _____________________________________________________________________________
+Grep::PartialResult create_result(const std::string& file,
+                                  const std::vector<std::string>& lines,
+                                  int64_t first_line) {
+  Grep::PartialResult res{file, {}, {}, {}};
+  for (const auto& line : lines) {
+    res.matches.push_back({-1, first_line++, res.buffer.size(), line.size()});
+    res.buffer.append(line);
+  }
+  return res;
+}
+
+TEST(GrepOutputTest, ordered_output) {
+  std::stringstream out;
+  Grep::Options options;
+  options.color = Grep::Color::OFF;
+  options.line_number = true;
+  {
+    GrepOutput output(options, out);
+    output.add(create_result("", {"c"}, 5), 2);
+    output.add(create_result("", {"b"}, 3), 1);
+    output.add(create_result("", {"a", "aa"}, 1), 0);
+    ASSERT_EQ(output.size(), 4);
+  }
+  ASSERT_EQ(out.str(), "1:a\n2:aa\n3:b\n5:c\n");
+}
+
+// _____________________________________________________________________________
+TEST(GrepOutputTest, max_count) {
+  std::stringstream out;
+  Grep::Options options;
+  options.color = Grep::Color::OFF;
+  options.print_file_path = true;
+  options.file = "test";
+  options.max_count = 2;
+  auto cancellation = std::make_shared<Cancellation>();
+  {
+    GrepOutput output(options, out, cancellation);
+    // file a is limited and cancelled within the first chunk
+    auto first = create_result("", {"a", "a", "a", "b"}, 1);
+    first.segments = {{"a", 3, 0}, {"b", 4, 0}};
+    output.add(std::move(first), 0);
+    // results are evaluated by the writer thread: size() waits for it
+    ASSERT_EQ(output.size(), 3);
+    ASSERT_TRUE(cancellation->file_cancelled("a"));
+    ASSERT_FALSE(cancellation->file_cancelled("b"));
+    auto second = create_result("", {"b", "b", "c"}, 1);
+    second.segments = {{"b", 2, 0}, {"c", 3, 0}};
+    output.add(std::move(second), 1);
+    ASSERT_EQ(output.size(), 5);
+    ASSERT_TRUE(cancellation->file_cancelled("b"));
+  }
+  ASSERT_EQ(out.str(), "a:a\na:a\nb:b\nb:b\nc:c\n");
+}
+
+// _____________________________________________________________________________
+TEST(GrepOutputTest, list_files) {
+  // count only results: the segments contain the number of matches
+  Grep::PartialResult first{"", {}, {}, {}, {{"a", 0, 0}, {"b", 2, 0}}};
+  Grep::PartialResult second{"", {}, {}, {}, {{"b", 0, 0}, {"c", 0, 0}}};
+  Grep::Options options;
+  options.color = Grep::Color::OFF;
+  // recursive search: the names of the segments are written
+  options.file = std::filesystem::temp_directory_path().string();
+  {
+    std::stringstream out;
+    options.files_with_matches = true;
+    auto cancellation = std::make_shared<Cancellation>();
+    {
+      GrepOutput output(options, out, cancellation);
+      output.add(first, 0);
+      output.add(second, 1);
+      output.finish();
+      ASSERT_EQ(output.size(), 1);
+    }
+    ASSERT_TRUE(cancellation->file_cancelled("b"));
+    ASSERT_EQ(out.str(), "b\n");
+  }
+  {
+    std::stringstream out;
+    options.files_with_matches = false;
+    options.files_without_match = true;
+    {
+      GrepOutput output(options, out, std::make_shared<Cancellation>());
+      output.add(second, 1);
+      output.add(first, 0);
+      output.finish();
+      ASSERT_EQ(output.size(), 2);
+    }
+    ASSERT_EQ(out.str(), "a\nc\n");
+  }
+  {
+    std::stringstream out;
+    options.files_without_match = false;
+    options.quiet = true;
+    auto cancellation = std::make_shared<Cancellation>();
+    {
+      GrepOutput output(options, out, cancellation);
+      output.add(first, 0);
+      ASSERT_GT(output.size(), 0);
+    }
+    ASSERT_TRUE(cancellation->cancelled());
+    ASSERT_TRUE(out.str().empty());
+  }
+}
+
+// _____________________________________________________________________________
+TEST(GrepOutputTest, relative_name) {
+  ASSERT_EQ(GrepOutput::relative_name("/home/a/b.txt", "/home"), "a/b.txt");
+  ASSERT_EQ(GrepOutput::relative_name("/home/a/b.txt", "/home/"), "a/b.txt");
+  ASSERT_EQ(GrepOutput::relative_name("/b.txt", "/"), "b.txt");
+  ASSERT_EQ(GrepOutput::relative_name("/home/./b.txt", "/home"), "./b.txt");
+  // not located in root
+  ASSERT_EQ(GrepOutput::relative_name("/homes/b.txt", "/home"), "/homes/b.txt");
+  ASSERT_EQ(GrepOutput::relative_name("/home/b.txt", ""), "/home/b.txt");
+
+  // the names of the segments are written relative to display_root
+  Grep::PartialResult result{"", {}, {}, {}, {{"/home/a", 1, 0}}};
+  Grep::Options options;
+  options.color = Grep::Color::OFF;
+  options.file = std::filesystem::temp_directory_path().string();
+  options.files_with_matches = true;
+  options.display_root = "/home";
+  std::stringstream out;
+  {
+    GrepOutput output(options, out);
+    output.add(result, 0);
+    output.finish();
+  }
+  ASSERT_EQ(out.str(), "a\n");
+}
+
+// _____________________________________________________________________________
+TEST(GrepOutputTest, relative_line_numbers) {
+  std::stringstream out;
+  Grep::Options options;
+  options.color = Grep::Color::OFF;
+  options.line_number = true;
+  auto chunk = [](const std::vector<std::string>& lines, int64_t first_line,
+                  uint64_t num_lines) {
+    auto res = create_result("", lines, first_line);
+    res.relative_line_numbers = true;
+    res.segments = {{"", lines.size(), num_lines}};
+    return res;
+  };
+  {
+    GrepOutput output(options, out);
+    // resolved once it is their turn
+    output.add(chunk({"c"}, 2, 4), 2);
+    output.add(chunk({}, 1, 7), 1);
+    // all previous chunks were counted: resolved right away
+    output.add(chunk({"a", "b"}, 1, 10), 0);
+    output.add(chunk({"d"}, 1, 3), 3);
+    ASSERT_EQ(output.size(), 4);
+  }
+  ASSERT_EQ(out.str(), "1:a\n2:b\n19:c\n22:d\n");
+}
+
+// _____________________________________________________________________________
+TEST(LineNumberResolverTest, resolve) {
+  LineNumberResolver resolver;
+  // first chunk: end of file a (2 lines), start of file b (10 lines)
+  auto first = create_result("", {"a", "b"}, 1);
+  first.relative_line_numbers = true;
+  first.segments = {{"a", 1, 2}, {"b", 2, 10}};
+  resolver.resolve(&first);
+  ASSERT_FALSE(first.relative_line_numbers);
+  ASSERT_EQ(first.matches[0].line_number, 1);
+  ASSERT_EQ(first.matches[1].line_number, 2);
+  // second chunk: continuation of file b
+  auto second = create_result("", {"b", "b"}, 1);
+  second.relative_line_numbers = true;
+  second.segments = {{"b", 2, 5}};
+  second.matches[1].line_number = 4;
+  resolver.resolve(&second);
+  ASSERT_EQ(second.matches[0].line_number, 11);
+  ASSERT_EQ(second.matches[1].line_number, 14);
+}
+
+// _____________________________________________________________________________
+TEST(LineNumberResolverTest, skip) {
+  LineNumberResolver resolver;
+  resolver.skip({{"a", 0, 3}, {"b", 0, 5}});
+  resolver.skip({{"b", 0, 2}});
+  auto res = create_result("", {"b"}, 1);
+  res.relative_line_numbers = true;
+  res.segments = {{"b", 1, 1}};
+  resolver.resolve(&res);
+  ASSERT_EQ(res.matches[0].line_number, 8);
+}
+// _____________________________________________________________________________
+TEST(GrepOutputTest, context) {
+  // lines of chunk at byte position position with the given context flags
+  auto chunk = [](const std::vector<std::string>& lines,
+                  const std::vector<uint8_t>& flags, int64_t position) {
+    auto res = create_result("", lines, -1);
+    for (size_t i = 0; i < lines.size(); ++i) {
+      res.matches[i].byte_position = position;
+      res.matches[i].context = flags[i];
+      position += static_cast<int64_t>(lines[i].size()) + 1;
+    }
+    return res;
+  };
+  Grep::Options options;
+  options.color = Grep::Color::OFF;
+  options.byte_offset = true;
+  options.before_context = 1;
+  options.after_context = 1;
+  std::stringstream out;
+  {
+    GrepOutput output(options, out);
+    // the context of both selected lines is located in the chunk in between
+    auto first = chunk({"Sherlock"}, {0}, 0);
+    first.after_missing = 1;
+    auto second = chunk({"a", "d"}, {Grep::HEAD_LINE, Grep::TAIL_LINE}, 9);
+    // lines b and c are neither context nor located at the borders
+    second.matches[1].byte_position = 15;
+    auto third = chunk({"Sherlock", "x"}, {0, Grep::HEAD_LINE}, 17);
+    third.before_missing = 1;
+    output.add(std::move(third), 2);
+    output.add(std::move(second), 1);
+    output.add(std::move(first), 0);
+    ASSERT_EQ(output.size(), 2);
+  }
+  ASSERT_EQ(out.str(), "0:Sherlock\n9-a\n--\n15-d\n17:Sherlock\n");
+  // groups are separated even without context lines
+  options.before_context = 0;
+  options.after_context = -1;
+  out.str("");
+  {
+    GrepOutput output(options, out);
+    output.add(chunk({"Sherlock", "Sherlock"}, {0, 0}, 0), 0);
+    output.add(chunk({"Sherlock"}, {0}, 30), 1);
+    ASSERT_EQ(output.size(), 3);
+  }
+  ASSERT_EQ(out.str(), "0:Sherlock\n9:Sherlock\n--\n30:Sherlock\n");
+}
+
+// _____________________________________________________________________________
+TEST(GrepVisitorTest, ordered_visit) {
+  std::vector<std::string> visited;
+  size_t calls = 0;
+  GrepVisitor visitor([&](const std::vector<Grep::MatchView>& matches) {
+    calls++;
+    for (const auto& match : matches) {
+      visited.push_back(std::to_string(match.line_number) + ":" +
+                        std::string(match.match));
+    }
+    return true;
+  });
+  visitor.add(create_result("", {"c"}, 5), 2);
+  visitor.add(create_result("", {}, 4), 1);
+  visitor.add(create_result("", {"a", "aa"}, 1), 0);
+  visitor.finish();
+  ASSERT_EQ(visitor.size(), 3);
+  // chunks without matches are not visited
+  ASSERT_EQ(calls, 2);
+  ASSERT_EQ(visited, std::vector<std::string>({"1:a", "2:aa", "5:c"}));
+}
+
+// _____________________________________________________________________________
+TEST(GrepVisitorTest, max_count) {
+  std::vector<std::string> visited;
+  auto cancellation = std::make_shared<Cancellation>();
+  GrepVisitor visitor(
+      [&](const std::vector<Grep::MatchView>& matches) {
+        for (const auto& match : matches) {
+          visited.push_back(std::string(match.file_name) + ":" +
+                            std::string(match.match));
+        }
+        return true;
+      },
+      2, 0, cancellation);
+  auto first = create_result("", {"a", "a", "a", "b"}, 1);
+  first.segments = {{"a", 3, 0}, {"b", 4, 0}};
+  visitor.add(std::move(first), 0);
+  auto second = create_result("", {"b", "b"}, 1);
+  second.segments = {{"b", 2, 0}};
+  visitor.add(std::move(second), 1);
+  visitor.finish();
+  ASSERT_EQ(visitor.size(), 4);
+  ASSERT_TRUE(cancellation->file_cancelled("a"));
+  ASSERT_TRUE(cancellation->file_cancelled("b"));
+  ASSERT_FALSE(cancellation->cancelled());
+  ASSERT_EQ(visited, std::vector<std::string>({"a:a", "a:a", "b:b", "b:b"}));
+}
+
+// _____________________________________________________________________________
+TEST(GrepVisitorTest, stop) {
+  auto cancellation = std::make_shared<Cancellation>();
+  size_t calls = 0;
+  GrepVisitor visitor(
+      [&](const std::vector<Grep::MatchView>&) { return ++calls < 2; }, -1, 0,
+      cancellation);
+  for (uint64_t id = 0; id < 4; ++id) {
+    visitor.add(create_result("", {"a"}, static_cast<int64_t>(id + 1)), id);
+  }
+  visitor.finish();
+  ASSERT_EQ(calls, 2);
+  ASSERT_TRUE(cancellation->cancelled());
+}
+
+// _____________________________________________________________________________
+TEST(GrepVisitorTest, exception) {
+  GrepVisitor visitor([](const std::vector<Grep::MatchView>&) -> bool {
+    throw std::runtime_error("visitor");
+  });
+  visitor.add(create_result("", {"a"}, 1), 0);
+  ASSERT_THROW(visitor.finish(), std::runtime_error);
+}
@@ -14,41 +14,41 @@ TEST(GrepSearcherTest, process_literal) {
     GrepSearcher searcher(pattern, false, false, false, false, false,
                           Grep::Locale::ASCII);
     auto res = searcher.process(&data);
-    ASSERT_TRUE(res.first.empty());
-    ASSERT_EQ(res.second.size(), 1);
-    ASSERT_EQ(res.second.front().line_number, -1);
-    ASSERT_EQ(res.second.front().byte_position, -1);
-    ASSERT_EQ(res.second.front().match, "with Sherlock");
+    ASSERT_TRUE(res.file_name.empty());
+    ASSERT_EQ(res.matches.size(), 1);
+    ASSERT_EQ(res.matches.front().line_number, -1);
+    ASSERT_EQ(res.matches.front().byte_position, -1);
+    ASSERT_EQ(res.str(res.matches.front()), "with Sherlock");
   }
   {
     GrepSearcher searcher(pattern, true, false, false, false, false,
                           Grep::Locale::ASCII);
     auto res = searcher.process(&data);
-    ASSERT_TRUE(res.first.empty());
-    ASSERT_EQ(res.second.size(), 1);
-    ASSERT_EQ(res.second.front().line_number, -1);
-    ASSERT_EQ(res.second.front().byte_position, 34);
-    ASSERT_EQ(res.second.front().match, "with Sherlock");
+    ASSERT_TRUE(res.file_name.empty());
+    ASSERT_EQ(res.matches.size(), 1);
+    ASSERT_EQ(res.matches.front().line_number, -1);
+    ASSERT_EQ(res.matches.front().byte_position, 34);
+    ASSERT_EQ(res.str(res.matches.front()), "with Sherlock");
   }
   {
     GrepSearcher searcher(pattern, false, true, false, false, false,
                           Grep::Locale::ASCII);
     auto res = searcher.process(&data);
-    ASSERT_TRUE(res.first.empty());
-    ASSERT_EQ(res.second.size(), 1);
-    ASSERT_EQ(res.second.front().line_number, 2);
-    ASSERT_EQ(res.second.front().byte_position, -1);
-    ASSERT_EQ(res.second.front().match, "with Sherlock");
+    ASSERT_TRUE(res.file_name.empty());
+    ASSERT_EQ(res.matches.size(), 1);
+    ASSERT_EQ(res.matches.front().line_number, 2);
+    ASSERT_EQ(res.matches.front().byte_position, -1);
+    ASSERT_EQ(res.str(res.matches.front()), "with Sherlock");
   }
   {
     GrepSearcher searcher(pattern, true, true, false, false, false,
                           Grep::Locale::ASCII);
     auto res = searcher.process(&data);
-    ASSERT_TRUE(res.first.empty());
-    ASSERT_EQ(res.second.size(), 1);
-    ASSERT_EQ(res.second.front().line_number, 2);
-    ASSERT_EQ(res.second.front().byte_position, 34);
-    ASSERT_EQ(res.second.front().match, "with Sherlock");
+    ASSERT_TRUE(res.file_name.empty());
+    ASSERT_EQ(res.matches.size(), 1);
+    ASSERT_EQ(res.matches.front().line_number, 2);
+    ASSERT_EQ(res.matches.front().byte_position, 34);
+    ASSERT_EQ(res.str(res.matches.front()), "with Sherlock");
   }
 }
 
@@ -58,52 +58,422 @@ TEST(GrepSearcherTest, process_regex) {
     GrepSearcher searcher(pattern, false, false, false, true, false,
                           Grep::Locale::ASCII);
     auto res = searcher.process(&data);
-    ASSERT_TRUE(res.first.empty());
-    ASSERT_EQ(res.second.size(), 2);
-    ASSERT_EQ(res.second.front().line_number, -1);
-    ASSERT_EQ(res.second.front().byte_position, 34);
-    ASSERT_EQ(res.second.front().match, "with Sherlock");
-    ASSERT_EQ(res.second.back().line_number, -1);
-    ASSERT_EQ(res.second.back().byte_position, 48);
-    ASSERT_EQ(res.second.back().match, "and She lock.");
+    ASSERT_TRUE(res.file_name.empty());
+    ASSERT_EQ(res.matches.size(), 2);
+    ASSERT_EQ(res.matches.front().line_number, -1);
+    ASSERT_EQ(res.matches.front().byte_position, 34);
+    ASSERT_EQ(res.str(res.matches.front()), "with Sherlock");
+    ASSERT_EQ(res.matches.back().line_number, -1);
+    ASSERT_EQ(res.matches.back().byte_position, 48);
+    ASSERT_EQ(res.str(res.matches.back()), "and She lock.");
   }
   {
     GrepSearcher searcher(pattern, true, false, false, true, false,
                           Grep::Locale::ASCII);
     auto res = searcher.process(&data);
-    ASSERT_TRUE(res.first.empty());
-    ASSERT_EQ(res.second.size(), 2);
-    ASSERT_EQ(res.second.front().line_number, -1);
-    ASSERT_EQ(res.second.front().byte_position, 34);
-    ASSERT_EQ(res.second.front().match, "with Sherlock");
-    ASSERT_EQ(res.second.back().line_number, -1);
-    ASSERT_EQ(res.second.back().byte_position, 48);
-    ASSERT_EQ(res.second.back().match, "and She lock.");
+    ASSERT_TRUE(res.file_name.empty());
+    ASSERT_EQ(res.matches.size(), 2);
+    ASSERT_EQ(res.matches.front().line_number, -1);
+    ASSERT_EQ(res.matches.front().byte_position, 34);
+    ASSERT_EQ(res.str(res.matches.front()), "with Sherlock");
+    ASSERT_EQ(res.matches.back().line_number, -1);
+    ASSERT_EQ(res.matches.back().byte_position, 48);
+    ASSERT_EQ(res.str(res.matches.back()), "and She lock.");
   }
   {
     GrepSearcher searcher(pattern, false, true, false, true, false,
                           Grep::Locale::ASCII);
     auto res = searcher.process(&data);
-    ASSERT_TRUE(res.first.empty());
-    ASSERT_EQ(res.second.size(), 2);
-    ASSERT_EQ(res.second.front().line_number, 2);
-    ASSERT_EQ(res.second.front().byte_position, 34);
-    ASSERT_EQ(res.second.front().match, "with Sherlock");
-    ASSERT_EQ(res.second.back().line_number, 3);
-    ASSERT_EQ(res.second.back().byte_position, 48);
-    ASSERT_EQ(res.second.back().match, "and She lock.");
+    ASSERT_TRUE(res.file_name.empty());
+    ASSERT_EQ(res.matches.size(), 2);
+    ASSERT_EQ(res.matches.front().line_number, 2);
+    ASSERT_EQ(res.matches.front().byte_position, 34);
+    ASSERT_EQ(res.str(res.matches.front()), "with Sherlock");
+    ASSERT_EQ(res.matches.back().line_number, 3);
+    ASSERT_EQ(res.matches.back().byte_position, 48);
+    ASSERT_EQ(res.str(res.matches.back()), "and She lock.");
   }
   {
     GrepSearcher searcher(pattern, true, true, false, true, false,
                           Grep::Locale::ASCII);
     auto res = searcher.process(&data);
-    ASSERT_TRUE(res.first.empty());
-    ASSERT_EQ(res.second.size(), 2);
-    ASSERT_EQ(res.second.front().line_number, 2);
-    ASSERT_EQ(res.second.front().byte_position, 34);
-    ASSERT_EQ(res.second.front().match, "with Sherlock");
-    ASSERT_EQ(res.second.back().line_number, 3);
-    ASSERT_EQ(res.second.back().byte_position, 48);
-    ASSERT_EQ(res.second.back().match, "and She lock.");
-  }
-}
\ No newline at end of file
+    ASSERT_TRUE(res.file_name.empty());
+    ASSERT_EQ(res.matches.size(), 2);
+    ASSERT_EQ(res.matches.front().line_number, 2);
+    ASSERT_EQ(res.matches.front().byte_position, 34);
+    ASSERT_EQ(res.str(res.matches.front()), "with Sherlock");
+    ASSERT_EQ(res.matches.back().line_number, 3);
+    ASSERT_EQ(res.matches.back().byte_position, 48);
+    ASSERT_EQ(res.str(res.matches.back()), "and She lock.");
+  }
+}
+
+// _____________________________________________________________________________
+TEST(GrepSearcherTest, to_match) {
+  GrepSearcher searcher("She[r ]lock", true, true, true, true, false,
+                        Grep::Locale::ASCII);
+  auto res = searcher.process(&data);
+  ASSERT_EQ(res.matches.size(), 2);
+  ASSERT_EQ(res.buffer, "SherlockShe lock");
+  auto match = res.to_match(res.matches.back());
+  ASSERT_EQ(match.line_number, 3);
+  ASSERT_EQ(match.byte_position, 52);
+  ASSERT_EQ(match.match, "She lock");
+}
+
+TEST(GrepSearcherTest, highlights) {
+  {
+    GrepSearcher searcher("lock", false, false, false, false, false,
+                          Grep::Locale::ASCII);
+    searcher.set_highlight(true);
+    auto res = searcher.process(&data);
+    ASSERT_EQ(res.matches.size(), 2);
+    ASSERT_EQ(res.str(res.matches.back()), "and She lock.");
+    ASSERT_EQ(res.matches.front().highlight_begin, 0);
+    ASSERT_EQ(res.matches.front().highlight_end, 1);
+    ASSERT_EQ(res.matches.back().highlight_begin, 1);
+    ASSERT_EQ(res.matches.back().highlight_end, 2);
+    ASSERT_EQ(res.highlights[0].offset, 9);
+    ASSERT_EQ(res.highlights[1].offset, 8);
+    ASSERT_EQ(res.highlights[1].size, 4);
+  }
+  {
+    GrepSearcher searcher("[ts]h", false, false, false, true, true,
+                          Grep::Locale::ASCII);
+    searcher.set_highlight(true);
+    auto res = searcher.process(&data);
+    ASSERT_EQ(res.matches.size(), 3);
+    ASSERT_EQ(res.highlights.size(), 4);
+    ASSERT_EQ(res.highlights[0].offset, 0);
+    ASSERT_EQ(res.highlights[0].size, 2);
+    ASSERT_EQ(res.matches[1].highlight_begin, 1);
+    ASSERT_EQ(res.matches[1].highlight_end, 3);
+    ASSERT_EQ(res.highlights[1].offset, 2);
+    ASSERT_EQ(res.highlights[2].offset, 5);
+    ASSERT_EQ(res.highlights[3].offset, 4);
+  }
+}
+
+TEST(GrepSearcherTest, file_segments) {
+  // two packed files (each followed by a new line separator) and a third one
+  //  that is continued in the next chunk
+  std::string content("Sherlock\nx\n\nx\n\nx\nSherlock\nSherlock\n");
+  xs::DataChunk chunk(content.data(), content.size(),
+                      {7, 0, 0, content.size(), content.size(), {{0, 0}}});
+  auto files = std::make_shared<ChunkFileTable>();
+  files->insert(7, {{"a", 0, 0, 11}, {"b", 12, 0, 2}, {"c", 15, 100, 20}});
+  GrepSearcher searcher("Sherlock", true, true, false, false, false,
+                        Grep::Locale::ASCII);
+  searcher.set_chunk_files(files);
+  auto res = searcher.process(&chunk);
+  ASSERT_TRUE(res.relative_line_numbers);
+  ASSERT_EQ(res.matches.size(), 3);
+  // b has no matches and is not the last file: no segment
+  ASSERT_EQ(res.segments.size(), 2);
+  ASSERT_EQ(res.segments[0].file_name, "a");
+  ASSERT_EQ(res.segments[0].matches_end, 1);
+  ASSERT_EQ(res.segments[0].num_lines, 2);
+  ASSERT_EQ(res.segments[1].file_name, "c");
+  ASSERT_EQ(res.segments[1].matches_end, 3);
+  ASSERT_EQ(res.segments[1].num_lines, 3);
+  ASSERT_EQ(res.matches[0].line_number, 1);
+  ASSERT_EQ(res.matches[0].byte_position, 0);
+  ASSERT_EQ(res.matches[1].line_number, 2);
+  ASSERT_EQ(res.matches[1].byte_position, 102);
+  ASSERT_EQ(res.matches[2].line_number, 3);
+  ASSERT_EQ(res.matches[2].byte_position, 111);
+  // the chunk was removed from the table
+  ASSERT_FALSE(files->extract(7).has_value());
+}
+
+TEST(GrepSearcherTest, count_only) {
+  std::string content("Sherlock\nSherlock\n\nx\n\nSherlock\n");
+  xs::DataChunk chunk(content.data(), content.size(),
+                      {3, 0, 0, content.size(), content.size(), {{0, 0}}});
+  auto files = std::make_shared<ChunkFileTable>();
+  files->insert(3, {{"a", 0, 0, 18}, {"b", 19, 0, 2}, {"c", 22, 0, 9}});
+  GrepSearcher searcher("Sherlock", false, false, false, false, false,
+                        Grep::Locale::ASCII);
+  searcher.set_chunk_files(files).set_count_only(true);
+  auto res = searcher.process(&chunk);
+  ASSERT_TRUE(res.matches.empty());
+  ASSERT_EQ(res.segments.size(), 3);
+  ASSERT_EQ(res.segments[0].matches_end, 2);
+  ASSERT_EQ(res.segments[1].matches_end, 2);
+  ASSERT_EQ(res.segments[2].matches_end, 3);
+}
+
+// _____________________________________________________________________________
+TEST(GrepSearcherTest, cancellation) {
+  std::string content("Sherlock\n\nSherlock\n");
+  xs::DataChunk chunk(content.data(), content.size(),
+                      {0, 0, 0, content.size(), content.size(), {{0, 0}}});
+  auto files = std::make_shared<ChunkFileTable>();
+  auto cancellation = std::make_shared<Cancellation>();
+  GrepSearcher searcher("Sherlock", false, false, false, false, false,
+                        Grep::Locale::ASCII);
+  searcher.set_chunk_files(files).set_cancellation(cancellation);
+  // one of the files was cancelled: the chunk is searched
+  cancellation->cancel_file("a");
+  files->insert(0, {{"a", 0, 0, 9}, {"b", 10, 0, 9}});
+  ASSERT_EQ(searcher.process(&chunk).matches.size(), 2);
+  // all files were cancelled: the chunk is skipped
+  cancellation->cancel_file("b");
+  files->insert(0, {{"a", 0, 0, 9}, {"b", 10, 0, 9}});
+  auto res = searcher.process(&chunk);
+  ASSERT_TRUE(res.matches.empty());
+  ASSERT_TRUE(res.segments.empty());
+  // the search was cancelled
+  cancellation->cancel();
+  ASSERT_TRUE(searcher.process(&chunk).matches.empty());
+}
+
+// _____________________________________________________________________________
+TEST(GrepSearcherTest, multiple_patterns) {
+  std::string content("Sherlock Holmes\nDr. Watson\nMrs. Hudson\nMoriarty\n");
+  xs::DataChunk chunk(content.data(), content.size(),
+                      {0, 0, 0, content.size(), content.size(), {{0, 0}}});
+  {
+    GrepSearcher searcher(std::vector<std::string>{"Watson", "Moriarty"},
+                          true, false, false, false, false,
+                          Grep::Locale::ASCII);
+    auto res = searcher.process(&chunk);
+    ASSERT_EQ(res.matches.size(), 2);
+    ASSERT_EQ(res.str(res.matches[0]), "Dr. Watson");
+    ASSERT_EQ(res.matches[0].byte_position, 16);
+    ASSERT_EQ(res.str(res.matches[1]), "Moriarty");
+  }
+  {
+    // only matching, case-insensitive
+    GrepSearcher searcher(std::vector<std::string>{"son", "holmes", "mrs"},
+                          true, false, true, false, true,
+                          Grep::Locale::ASCII);
+    auto res = searcher.process(&chunk);
+    ASSERT_EQ(res.matches.size(), 4);
+    ASSERT_EQ(res.str(res.matches[0]), "Holmes");
+    ASSERT_EQ(res.matches[0].byte_position, 9);
+    ASSERT_EQ(res.str(res.matches[1]), "son");
+    ASSERT_EQ(res.str(res.matches[2]), "Mrs");
+    ASSERT_EQ(res.str(res.matches[3]), "son");
+  }
+  {
+    // regular expressions are combined
+    GrepSearcher searcher(std::vector<std::string>{"^Dr", "ty$"}, false,
+                          false, false, true, false, Grep::Locale::ASCII);
+    auto res = searcher.process(&chunk);
+    ASSERT_EQ(res.matches.size(), 2);
+    ASSERT_EQ(res.str(res.matches[1]), "Moriarty");
+  }
+}
+
+// _____________________________________________________________________________
+TEST(GrepSearcherTest, relative_line_numbers) {
+  // a chunk read without line mapping: lines are counted by the searcher
+  std::string content("x\nSherlock\nx\n\nSherlock and Sherlock\nx\n");
+  xs::DataChunk chunk(content.data(), content.size(),
+                      {1, 100, 100, content.size(), content.size(), {}});
+  GrepSearcher searcher("Sherlock", true, true, false, false, false,
+                        Grep::Locale::ASCII);
+  auto res = searcher.process(&chunk);
+  ASSERT_TRUE(res.relative_line_numbers);
+  ASSERT_EQ(res.matches.size(), 2);
+  ASSERT_EQ(res.matches[0].line_number, 2);
+  ASSERT_EQ(res.matches[0].byte_position, 102);
+  ASSERT_EQ(res.matches[1].line_number, 5);
+  ASSERT_EQ(res.matches[1].byte_position, 114);
+  ASSERT_EQ(res.segments.size(), 1);
+  ASSERT_EQ(res.segments[0].file_name, res.file_name);
+  ASSERT_EQ(res.segments[0].matches_end, 2);
+  ASSERT_EQ(res.segments[0].num_lines, 6);
+  // chunks without matches only count their lines
+  GrepSearcher other("Watson", false, true, false, false, false,
+                     Grep::Locale::ASCII);
+  res = other.process(&chunk);
+  ASSERT_TRUE(res.matches.empty());
+  ASSERT_EQ(res.segments.size(), 1);
+  ASSERT_EQ(res.segments[0].num_lines, 6);
+}
+
+// _____________________________________________________________________________
+TEST(GrepSearcherTest, context) {
+  std::string content("a\nb\nSherlock\nc\nd\ne\nSherlock\nf\n");
+  xs::DataChunk chunk(content.data(), content.size(),
+                      {1, 100, 100, content.size(), content.size(), {}});
+  GrepSearcher searcher("Sherlock", false, false, false, false, false,
+                        Grep::Locale::ASCII);
+  searcher.set_context(1, 1);
+  auto res = searcher.process(&chunk);
+  std::vector<std::pair<std::string, uint8_t>> expected = {
+      {"a", Grep::HEAD_LINE},
+      {"b", Grep::CONTEXT_LINE},
+      {"Sherlock", 0},
+      {"c", Grep::CONTEXT_LINE},
+      {"e", Grep::CONTEXT_LINE},
+      {"Sherlock", 0},
+      {"f", Grep::CONTEXT_LINE | Grep::TAIL_LINE}};
+  ASSERT_EQ(res.matches.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_EQ(res.str(res.matches[i]), expected[i].first);
+    ASSERT_EQ(res.matches[i].context, expected[i].second);
+  }
+  // context lines are joined by their byte positions
+  ASSERT_EQ(res.matches[2].byte_position, 104);
+  ASSERT_EQ(res.before_missing, 0);
+  ASSERT_EQ(res.after_missing, 0);
+  // the context of the first and last selected lines is incomplete
+  searcher.set_context(2, 3);
+  res = searcher.process(&chunk);
+  ASSERT_EQ(res.before_missing, 0);
+  ASSERT_EQ(res.after_missing, 2);
+  std::string edges("Sherlock\nx\nSherlock\n");
+  xs::DataChunk edge_chunk(edges.data(), edges.size(),
+                           {2, 200, 200, edges.size(), edges.size(), {}});
+  res = searcher.process(&edge_chunk);
+  ASSERT_EQ(res.before_missing, 2);
+  ASSERT_EQ(res.after_missing, 3);
+  ASSERT_EQ(res.matches.size(), 3);
+  ASSERT_EQ(res.matches[1].context, Grep::CONTEXT_LINE | Grep::HEAD_LINE |
+                                        Grep::TAIL_LINE);
+}
+
+// _____________________________________________________________________________
+TEST(GrepSearcherTest, invert_match) {
+  std::string content("a\n\nSherlock\nb\nc\nSherlock\n");
+  xs::DataChunk chunk(content.data(), content.size(),
+                      {0, 0, 0, content.size(), content.size(), {{0, 0}}});
+  {
+    GrepSearcher searcher("Sherlock", false, true, false, false, false,
+                          Grep::Locale::ASCII);
+    searcher.set_invert_match(true, true);
+    auto res = searcher.process(&chunk);
+    // line numbers are needed: one match per line
+    ASSERT_EQ(res.matches.size(), 4);
+    ASSERT_EQ(res.str(res.matches[1]), "");
+    ASSERT_EQ(res.matches[1].line_number, 2);
+    ASSERT_EQ(res.str(res.matches[2]), "b");
+    ASSERT_EQ(res.matches[2].line_number, 4);
+  }
+  {
+    GrepSearcher searcher("She[r ]lock", false, false, false, true, false,
+                          Grep::Locale::ASCII);
+    searcher.set_invert_match(true, true);
+    auto res = searcher.process(&chunk);
+    // runs of selected lines are joined
+    ASSERT_EQ(res.matches.size(), 2);
+    ASSERT_EQ(res.str(res.matches[0]), "a\n");
+    ASSERT_EQ(res.str(res.matches[1]), "b\nc");
+  }
+  {
+    std::string packed("Sherlock\nSherlock\n\nx\n\nSherlock\n");
+    xs::DataChunk packed_chunk(
+        packed.data(), packed.size(),
+        {3, 0, 0, packed.size(), packed.size(), {{0, 0}}});
+    auto files = std::make_shared<ChunkFileTable>();
+    files->insert(3, {{"a", 0, 0, 18}, {"b", 19, 0, 2}, {"c", 22, 0, 9}});
+    GrepSearcher searcher("Sherlock", false, false, false, false, false,
+                          Grep::Locale::ASCII);
+    searcher.set_chunk_files(files).set_count_only(true).set_invert_match(
+        true);
+    auto res = searcher.process(&packed_chunk);
+    ASSERT_EQ(res.segments.size(), 3);
+    ASSERT_EQ(res.segments[0].matches_end, 0);
+    ASSERT_EQ(res.segments[1].matches_end, 1);
+    ASSERT_EQ(res.segments[2].matches_end, 1);
+  }
+  for (bool regex : {false, true}) {
+    // no pattern (e.g. an empty pattern file): every line is selected
+    GrepSearcher searcher(std::vector<std::string>{}, false, true, false,
+                          regex, false, Grep::Locale::ASCII);
+    ASSERT_TRUE(searcher.process(&chunk).matches.empty());
+    searcher.set_invert_match(true, true);
+    auto res = searcher.process(&chunk);
+    ASSERT_EQ(res.matches.size(), 6);
+    ASSERT_EQ(res.str(res.matches[2]), "Sherlock");
+    ASSERT_EQ(res.matches[5].line_number, 6);
+  }
+}
+
+// _____________________________________________________________________________
+TEST(GrepSearcherTest, boundary) {
+  std::string content("foobar foo\nxfoo\nfoo_x foo-y\nfoo\n");
+  xs::DataChunk chunk(content.data(), content.size(),
+                      {0, 0, 0, content.size(), content.size(), {{0, 0}}});
+  for (bool regex : {false, true}) {
+    {
+      GrepSearcher searcher("foo", true, false, true, regex, false,
+                            Grep::Locale::ASCII, Grep::Boundary::WORD);
+      auto res = searcher.process(&chunk);
+      // foobar, xfoo and foo_x are not whole words
+      ASSERT_EQ(res.matches.size(), 3);
+      ASSERT_EQ(res.str(res.matches[0]), "foo");
+      ASSERT_EQ(res.matches[0].byte_position, 7);
+      ASSERT_EQ(res.matches[1].byte_position, 22);
+      ASSERT_EQ(res.matches[2].byte_position, 28);
+    }
+    {
+      GrepSearcher searcher("FOO", false, true, false, regex, true,
+                            Grep::Locale::ASCII, Grep::Boundary::LINE);
+      searcher.set_highlight(true);
+      auto res = searcher.process(&chunk);
+      ASSERT_EQ(res.matches.size(), 1);
+      ASSERT_EQ(res.matches[0].line_number, 4);
+      ASSERT_EQ(res.highlights.size(), 1);
+      ASSERT_EQ(res.highlights[0].size, 3);
+    }
+  }
+  GrepSearcher searcher(std::vector<std::string>{"foo", "bar"}, false, false,
+                        false, false, false, Grep::Locale::ASCII,
+                        Grep::Boundary::WORD);
+  searcher.set_highlight(true);
+  auto res = searcher.process(&chunk);
+  ASSERT_EQ(res.matches.size(), 3);
+  ASSERT_EQ(res.str(res.matches[0]), "foobar foo");
+  // only the whole word is highlighted
+  ASSERT_EQ(res.matches[0].highlight_end - res.matches[0].highlight_begin, 1);
+  ASSERT_EQ(res.highlights[res.matches[0].highlight_begin].offset, 7);
+  {
+    // the longest pattern at an offset is no word, a shorter one is
+    std::string words("foo-barx\nfoo-bar\n");
+    xs::DataChunk words_chunk(words.data(), words.size(),
+                              {0, 0, 0, words.size(), words.size(), {{0, 0}}});
+    GrepSearcher only_matching(std::vector<std::string>{"foo", "foo-bar"},
+                               true, false, true, false, false,
+                               Grep::Locale::ASCII, Grep::Boundary::WORD);
+    auto words_res = only_matching.process(&words_chunk);
+    ASSERT_EQ(words_res.matches.size(), 2);
+    ASSERT_EQ(words_res.str(words_res.matches[0]), "foo");
+    ASSERT_EQ(words_res.matches[0].byte_position, 0);
+    ASSERT_EQ(words_res.str(words_res.matches[1]), "foo-bar");
+    GrepSearcher lines(std::vector<std::string>{"foo", "foo-bar"}, false,
+                       false, false, false, false, Grep::Locale::ASCII,
+                       Grep::Boundary::WORD);
+    lines.set_highlight(true);
+    words_res = lines.process(&words_chunk);
+    ASSERT_EQ(words_res.matches.size(), 2);
+    ASSERT_EQ(words_res.str(words_res.matches[0]), "foo-barx");
+    ASSERT_EQ(words_res.highlights[words_res.matches[0].highlight_begin].size,
+              3);
+  }
+}
+
+TEST(GrepSearcherTest, searcher_cache) {
+  SearcherCache cache(2);
+  auto first = cache.get({"She[r ]lock"}, true, true, false, true, false,
+                         Grep::Locale::ASCII);
+  ASSERT_EQ(cache.size(), 1);
+  // a copy of the cached searcher
+  auto second = cache.get({"She[r ]lock"}, true, true, false, true, false,
+                          Grep::Locale::ASCII);
+  ASSERT_EQ(cache.size(), 1);
+  auto res = second->process(&data);
+  ASSERT_EQ(res.matches.size(), 2);
+  ASSERT_EQ(res.str(res.matches[1]), "and She lock.");
+  ASSERT_EQ(res.matches[1].line_number, 3);
+  // the least recently used searcher is dropped
+  cache.get({"sample"}, false, false, false, false, false,
+            Grep::Locale::ASCII);
+  cache.get({"lock"}, false, false, true, false, false, Grep::Locale::ASCII);
+  ASSERT_EQ(cache.size(), 2);
+  res = first->process(&data);
+  ASSERT_EQ(res.matches.size(), 2);
+}
@@ -0,0 +1,102 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <xsgrep/tasks/StreamReader.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+// _____________________________________________________________________________
+/// content of chunk as string
+std::string str(const xs::DataChunk& chunk) {
+  return {chunk.data(), chunk.size()};
+}
+
+// _____________________________________________________________________________
+TEST(StreamReaderTest, available_lines) {
+  int fds[2];
+  ASSERT_EQ(::pipe(fds), 0);
+  StreamReader reader(fds[0], 16, 64);
+  // complete lines are returned without waiting for a full block, the
+  //  incomplete last line is kept
+  ASSERT_EQ(::write(fds[1], "first\nsec", 9), 9);
+  auto chunk = reader.getNextData();
+  ASSERT_TRUE(chunk.has_value());
+  ASSERT_EQ(chunk->second, 0);
+  ASSERT_EQ(str(chunk->first), "first\n");
+  ASSERT_EQ(chunk->first.getMetaData().original_offset, 0);
+  // waits until the line is complete
+  std::thread writer([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_EQ(::write(fds[1], "ond\nthird", 9), 9);
+  });
+  chunk = reader.getNextData();
+  writer.join();
+  ASSERT_EQ(chunk->second, 1);
+  ASSERT_EQ(str(chunk->first), "second\n");
+  ASSERT_EQ(chunk->first.getMetaData().original_offset, 6);
+  // the stream ended: the last line is returned without new line
+  ::close(fds[1]);
+  chunk = reader.getNextData();
+  ASSERT_EQ(str(chunk->first), "third");
+  ASSERT_FALSE(reader.getNextData().has_value());
+  ::close(fds[0]);
+}
+
+// _____________________________________________________________________________
+TEST(StreamReaderTest, adaptive_block_size) {
+  int fds[2];
+  ASSERT_EQ(::pipe(fds), 0);
+  StreamReader reader(fds[0], 16, 64);
+  ASSERT_EQ(reader.block_size(), 16);
+  std::string lines;
+  for (int i = 0; i < 20; ++i) {
+    lines.append("line ").append(std::to_string(i)).push_back('\n');
+  }
+  ASSERT_EQ(::write(fds[1], lines.data(), lines.size()),
+            static_cast<ssize_t>(lines.size()));
+  // full blocks: the block size grows up to max_size
+  std::string read;
+  size_t max_block_size = 0;
+  while (read.size() < lines.size()) {
+    auto chunk = reader.getNextData();
+    ASSERT_TRUE(chunk.has_value());
+    ASSERT_EQ(str(chunk->first).back(), '\n');
+    read.append(str(chunk->first));
+    max_block_size = std::max(max_block_size, reader.block_size());
+  }
+  ASSERT_EQ(read, lines);
+  ASSERT_EQ(max_block_size, 64);
+  // the last block was not filled
+  ASSERT_EQ(reader.block_size(), 32);
+  // lines longer than the block are not split
+  std::string long_line(100, 'x');
+  long_line.push_back('\n');
+  ASSERT_EQ(::write(fds[1], long_line.data(), long_line.size()), 101);
+  ::close(fds[1]);
+  auto chunk = reader.getNextData();
+  ASSERT_EQ(str(chunk->first), long_line);
+  ASSERT_FALSE(reader.getNextData().has_value());
+  ::close(fds[0]);
+}
+
+// _____________________________________________________________________________
+TEST(StreamReaderTest, cancellation) {
+  int fds[2];
+  ASSERT_EQ(::pipe(fds), 0);
+  auto cancellation = std::make_shared<Cancellation>();
+  StreamReader reader(fds[0]);
+  reader.set_cancellation(cancellation);
+  std::thread canceller([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    cancellation->cancel();
+  });
+  // no data arrive, waiting ends once the search is cancelled
+  ASSERT_FALSE(reader.getNextData().has_value());
+  canceller.join();
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <gtest/gtest.h>
+#include <xsgrep/tasks/UringReader.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+// _____________________________________________________________________________
+/// read all chunks of reader and concatenate them
+std::string read_all(UringReader* reader, size_t* num_chunks) {
+  std::string content;
+  *num_chunks = 0;
+  while (true) {
+    auto chunk = reader->getNextData();
+    if (!chunk.has_value()) {
+      break;
+    }
+    EXPECT_EQ(chunk->second, *num_chunks);
+    EXPECT_EQ(chunk->first.getMetaData().chunk_index, chunk->second);
+    EXPECT_EQ(chunk->first.getMetaData().original_offset, content.size());
+    // chunks only contain complete lines
+    EXPECT_TRUE(content.empty() || content.back() == '\n');
+    content.append(chunk->first.data(), chunk->first.size());
+    (*num_chunks)++;
+  }
+  return content;
+}
+
+// _____________________________________________________________________________
+TEST(UringReaderTest, blocks) {
+  if (!UringReader::available()) {
+    GTEST_SKIP() << "io_uring is not available";
+  }
+  auto path = std::filesystem::temp_directory_path() / "xsgrep_uring_test";
+  std::string content;
+  for (int i = 0; i < 100; ++i) {
+    content.append("line ").append(std::to_string(i)).push_back('\n');
+  }
+  // a line longer than a block and no new line at the end
+  content.append(100, 'x').append("\nlast");
+  std::ofstream(path.string()) << content;
+
+  // more blocks than reads in flight
+  UringReader reader(path.string(), "", 4, 64);
+  size_t num_chunks = 0;
+  ASSERT_EQ(read_all(&reader, &num_chunks), content);
+  ASSERT_GT(num_chunks, 8);
+  ASSERT_FALSE(reader.getNextData().has_value());
+
+  // the whole file in one block
+  UringReader single(path.string(), "", 1, 1 << 20);
+  ASSERT_EQ(read_all(&single, &num_chunks), content);
+  ASSERT_EQ(num_chunks, 1);
+  std::filesystem::remove(path);
+}
+
+// _____________________________________________________________________________
+TEST(UringReaderTest, meta_file) {
+  if (!UringReader::available()) {
+    GTEST_SKIP() << "io_uring is not available";
+  }
+  auto dir = std::filesystem::temp_directory_path() / "xsgrep_uring_meta";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  std::ofstream((dir / "data").string()) << "first chunk\nsecond chunk\n";
+  {
+    xs::MetaFile meta_file((dir / "data.meta").string(), std::ios::out,
+                           xs::CompressionType::NONE);
+    meta_file.write_chunk_meta_data({0, 0, 0, 12, 12, {{0, 0}}});
+    meta_file.write_chunk_meta_data({1, 12, 12, 13, 13, {{12, 1}}});
+  }
+
+  UringReader reader((dir / "data").string(), (dir / "data.meta").string(),
+                     1);
+  auto chunk = reader.getNextData();
+  ASSERT_TRUE(chunk.has_value());
+  ASSERT_EQ(std::string(chunk->first.data(), chunk->first.size()),
+            "first chunk\n");
+  chunk = reader.getNextData();
+  ASSERT_TRUE(chunk.has_value());
+  ASSERT_EQ(chunk->second, 1);
+  ASSERT_EQ(chunk->first.getMetaData().original_offset, 12);
+  ASSERT_EQ(chunk->first.getMetaData().line_mapping_data.front()
+                .global_line_index,
+            1);
+  ASSERT_EQ(std::string(chunk->first.data(), chunk->first.size()),
+            "second chunk\n");
+  ASSERT_FALSE(reader.getNextData().has_value());
+  std::filesystem::remove_all(dir);
+}
+
+// _____________________________________________________________________________
+TEST(UringReaderTest, errors) {
+  if (!UringReader::available()) {
+    GTEST_SKIP() << "io_uring is not available";
+  }
+  ASSERT_THROW(UringReader("/no/such/file"), std::system_error);
+}
\ No newline at end of file
@@ -0,0 +1,138 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <xsgrep/utils/DirectoryWalker.h>
+
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+
+// _____________________________________________________________________________
+/// all files returned by walker (fails on duplicates)
+std::set<std::string> walk(DirectoryWalker* walker) {
+  std::set<std::string> files;
+  while (auto file = walker->next()) {
+    EXPECT_TRUE(files.insert(*file).second) << *file;
+  }
+  return files;
+}
+
+// _____________________________________________________________________________
+TEST(DirectoryWalkerTest, nested) {
+  auto dir = std::filesystem::temp_directory_path() / "xsgrep_walker_nested";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir / "a" / "b" / "c");
+  std::set<std::string> expected;
+  for (auto sub : {dir, dir / "a", dir / "a" / "b", dir / "a" / "b" / "c"}) {
+    for (auto name : {"x", "y"}) {
+      std::ofstream((sub / name).string()) << name;
+      expected.insert((sub / name).string());
+    }
+  }
+  {
+    DirectoryWalker walker(dir.string());
+    ASSERT_EQ(walk(&walker), expected);
+  }
+  {
+    // root and a (depth 1) are read
+    DirectoryWalker walker(dir.string(), 2);
+    ASSERT_EQ(walk(&walker).size(), 4);
+  }
+  {
+    // the listing of the directory comes with every file
+    DirectoryWalker walker((dir / "a" / "b" / "c").string());
+    auto file = walker.next_file();
+    ASSERT_TRUE(file.has_value());
+    ASSERT_EQ(file->has_sibling("x"), true);
+    ASSERT_EQ(file->has_sibling("z"), false);
+    ASSERT_TRUE(walker.next_file().has_value());
+    ASSERT_FALSE(walker.next_file().has_value());
+  }
+  {
+    // a file as root is the only file, its directory is not listed
+    DirectoryWalker walker((dir / "x").string());
+    auto file = walker.next_file();
+    ASSERT_EQ(file->path, (dir / "x").string());
+    ASSERT_FALSE(file->has_sibling("y").has_value());
+    ASSERT_FALSE(walker.next_file().has_value());
+  }
+  std::filesystem::remove_all(dir);
+}
+
+// _____________________________________________________________________________
+TEST(DirectoryWalkerTest, symlinks) {
+  auto dir = std::filesystem::temp_directory_path() / "xsgrep_walker_links";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir / "target");
+  std::ofstream((dir / "target" / "file").string()) << "file";
+  // links are typed by stat (as are all entries if the file system does not
+  //  provide d_type)
+  std::filesystem::create_symlink(dir / "target" / "file", dir / "file_link");
+  std::filesystem::create_directory_symlink(dir / "target", dir / "dir_link");
+  std::filesystem::create_symlink(dir / "missing", dir / "dangling");
+  DirectoryWalker walker(dir.string());
+  std::set<std::string> expected = {(dir / "target" / "file").string(),
+                                    (dir / "file_link").string(),
+                                    (dir / "dir_link" / "file").string()};
+  ASSERT_EQ(walk(&walker), expected);
+  std::filesystem::remove_all(dir);
+}
+
+// _____________________________________________________________________________
+TEST(DirectoryWalkerTest, threads) {
+  auto dir = std::filesystem::temp_directory_path() / "xsgrep_walker_threads";
+  std::filesystem::remove_all(dir);
+  std::set<std::string> expected;
+  for (int i = 0; i < 50; ++i) {
+    auto sub = dir / std::to_string(i % 5) / std::to_string(i);
+    std::filesystem::create_directories(sub);
+    for (int j = 0; j < 4; ++j) {
+      std::ofstream((sub / std::to_string(j)).string()) << j;
+      expected.insert((sub / std::to_string(j)).string());
+    }
+  }
+  for (int num_threads : {1, 2, 8}) {
+    // the traversal pauses while the queue of files is full
+    DirectoryWalker walker(dir.string(), -1, num_threads, 3);
+    ASSERT_EQ(walk(&walker), expected);
+  }
+  {
+    // threads blocked by the full queue stop if the walker is destroyed
+    DirectoryWalker walker(dir.string(), -1, 8, 3);
+    ASSERT_TRUE(walker.next().has_value());
+  }
+  std::filesystem::remove_all(dir);
+}
+
+// _____________________________________________________________________________
+TEST(DirectoryWalkerTest, errors) {
+  auto dir = std::filesystem::temp_directory_path() / "xsgrep_walker_errors";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir / "locked");
+  std::filesystem::create_directories(dir / "open");
+  std::ofstream((dir / "locked" / "file").string()) << "file";
+  std::ofstream((dir / "open" / "file").string()) << "file";
+  std::filesystem::permissions(dir / "locked", std::filesystem::perms::none);
+  if (::access((dir / "locked").c_str(), R_OK) == 0) {
+    std::filesystem::permissions(dir / "locked",
+                                 std::filesystem::perms::owner_all);
+    std::filesystem::remove_all(dir);
+    GTEST_SKIP() << "directories without permissions can be read";
+  }
+  std::stringstream stream;
+  auto errors = std::make_shared<ErrorLog>(&stream);
+  {
+    DirectoryWalker walker(dir.string(), -1, 2, 4096, errors);
+    // the traversal goes on, the directory is reported and counted
+    ASSERT_EQ(walk(&walker).size(), 1);
+  }
+  ASSERT_EQ(errors->count(), 1);
+  ASSERT_TRUE(stream.str().starts_with((dir / "locked").string() + ": "));
+  std::filesystem::permissions(dir / "locked",
+                               std::filesystem::perms::owner_all);
+  std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,134 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <gtest/gtest.h>
+#include <xsgrep/utils/MultiLiteral.h>
+#include <xsgrep/utils/search.h>
+
+#include <algorithm>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+// _____________________________________________________________________________
+/// leftmost-longest match of patterns in data by comparing every position
+std::optional<MultiLiteral::Match> naive_find(
+    const std::string& data, const std::vector<std::string>& patterns,
+    bool ignore_case) {
+  auto equal = [&](char a, char b) {
+    return ignore_case ? to_lower_ascii(a) == to_lower_ascii(b) : a == b;
+  };
+  for (size_t i = 0; i <= data.size(); ++i) {
+    std::optional<MultiLiteral::Match> longest;
+    for (size_t p = 0; p < patterns.size(); ++p) {
+      const auto& pattern = patterns[p];
+      if (i + pattern.size() > data.size() ||
+          (longest.has_value() && longest->size >= pattern.size())) {
+        continue;
+      }
+      if (std::equal(pattern.begin(), pattern.end(), data.begin() + i,
+                     equal)) {
+        longest = MultiLiteral::Match{i, pattern.size(), p};
+      }
+    }
+    if (longest.has_value()) {
+      return longest;
+    }
+  }
+  return {};
+}
+
+// _____________________________________________________________________________
+TEST(MultiLiteralTest, find) {
+  std::string data("This is a sample text\nwith Sherlock and Watson.");
+  {
+    MultiLiteral multi({"Watson", "Sherlock", "sample"});
+    ASSERT_FALSE(multi.uses_automaton());
+    auto match = multi.find(data.data(), data.size());
+    ASSERT_TRUE(match.has_value());
+    ASSERT_EQ(match->offset, 10);
+    ASSERT_EQ(match->size, 6);
+    ASSERT_EQ(match->pattern, 2);
+    match = multi.find(data.data() + 16, data.size() - 16);
+    ASSERT_EQ(match->offset, 27 - 16);
+    ASSERT_EQ(match->pattern, 1);
+    ASSERT_FALSE(multi.find(data.data(), 10).has_value());
+  }
+  {
+    // leftmost first, longest among the patterns starting there
+    MultiLiteral multi({"is a", "his", "This is"});
+    auto match = multi.find(data.data(), data.size());
+    ASSERT_EQ(match->offset, 0);
+    ASSERT_EQ(match->size, 7);
+    ASSERT_EQ(match->pattern, 2);
+  }
+  {
+    MultiLiteral multi({"SHERLOCK", "watson"}, true);
+    auto match = multi.find(data.data(), data.size());
+    ASSERT_EQ(match->offset, 27);
+    ASSERT_EQ(match->pattern, 0);
+  }
+  {
+    // the empty pattern matches at the beginning
+    MultiLiteral multi({"x", ""});
+    auto match = multi.find(data.data(), data.size());
+    ASSERT_EQ(match->offset, 0);
+    ASSERT_EQ(match->size, 0);
+    ASSERT_EQ(match->pattern, 1);
+  }
+  {
+    // all patterns starting at a position, longest first
+    MultiLiteral multi({"Th", "This is", "his", "This"});
+    auto matches = multi.matches_at(data.data(), data.size(), 0);
+    ASSERT_EQ(matches.size(), 3);
+    ASSERT_EQ(matches[0].pattern, 1);
+    ASSERT_EQ(matches[1].size, 4);
+    ASSERT_EQ(matches[2].pattern, 0);
+    ASSERT_TRUE(multi.matches_at(data.data(), data.size(), 2).empty());
+  }
+}
+
+// _____________________________________________________________________________
+TEST(MultiLiteralTest, compare_naive) {
+  // compare prefilter and automaton with a naive search on random data
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> byte('a', 'h');
+  auto random_string = [&](size_t size) {
+    std::string str(size, ' ');
+    for (auto& c : str) {
+      c = static_cast<char>(byte(gen));
+      if (gen() % 7 == 0) {
+        c = static_cast<char>(c & ~0x20);
+      }
+    }
+    return str;
+  };
+  std::string data = random_string(5000);
+  for (size_t num_patterns : {2, 5, 50, 500}) {
+    std::vector<std::string> patterns;
+    for (size_t i = 0; i < num_patterns; ++i) {
+      patterns.push_back(random_string(1 + gen() % 6));
+    }
+    for (bool ignore_case : {false, true}) {
+      MultiLiteral multi(patterns, ignore_case);
+      if (ignore_case) {
+        for (auto& pattern : patterns) {
+          std::transform(pattern.begin(), pattern.end(), pattern.begin(),
+                         to_lower_ascii);
+        }
+      }
+      for (size_t shift = 0; shift < data.size(); shift += 97) {
+        auto expected =
+            naive_find(data.substr(shift), patterns, ignore_case);
+        auto match = multi.find(data.data() + shift, data.size() - shift);
+        ASSERT_EQ(match.has_value(), expected.has_value());
+        if (expected.has_value()) {
+          ASSERT_EQ(match->offset, expected->offset);
+          ASSERT_EQ(match->size, expected->size);
+          ASSERT_EQ(patterns[match->pattern], patterns[expected->pattern]);
+        }
+      }
+    }
+  }
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <gtest/gtest.h>
+#include <xsgrep/utils/NgramFilter.h>
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+// _____________________________________________________________________________
+TEST(NgramFilterTest, may_contain) {
+  std::string data("This is a sample text\nwith Sherlock and Watson.");
+  NgramFilter filter(4096);
+  ASSERT_EQ(filter.num_bytes(), 4096);
+  filter.add(data.data(), data.size());
+  ASSERT_TRUE(filter.may_contain("Sherlock"));
+  ASSERT_TRUE(filter.may_contain("sample text"));
+  // the case of ASCII characters is folded
+  ASSERT_TRUE(filter.may_contain("SHERLOCK"));
+  // too short to be rejected
+  ASSERT_TRUE(filter.may_contain("xy"));
+  ASSERT_FALSE(filter.may_contain("Moriarty"));
+  ASSERT_TRUE(filter.may_contain_any({"Moriarty", "Watson"}));
+  ASSERT_FALSE(filter.may_contain_any({"Moriarty", "Lestrade"}));
+  ASSERT_FALSE(filter.may_contain_any({}));
+  // sizes are rounded up to a power of two
+  ASSERT_EQ(NgramFilter(1000).num_bytes(), 1024);
+  ASSERT_EQ(NgramFilter(0).num_bytes(), 8);
+}
+
+// _____________________________________________________________________________
+TEST(NgramFilterTest, read_file) {
+  auto path =
+      (std::filesystem::temp_directory_path() / "xsgrep_ngram_filters")
+          .string();
+  {
+    std::ofstream out(path, std::ios::binary);
+    NgramFilter::write_header(out, 100);
+    NgramFilter first(100);
+    first.add("Sherlock", 8);
+    first.write(out, 0);
+    NgramFilter second(100);
+    second.add("Watson", 6);
+    second.write(out, 42);
+  }
+  auto filters = NgramFilter::read_file(path);
+  ASSERT_EQ(filters.size(), 2);
+  ASSERT_EQ(filters.at(0).num_bytes(), 128);
+  ASSERT_TRUE(filters.at(0).may_contain("Sherlock"));
+  ASSERT_FALSE(filters.at(0).may_contain("Watson"));
+  ASSERT_TRUE(filters.at(42).may_contain("Watson"));
+  {
+    std::ofstream out(path, std::ios::binary);
+    out << "no filter file";
+  }
+  ASSERT_THROW(NgramFilter::read_file(path), std::runtime_error);
+  std::filesystem::remove(path);
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <xsgrep/utils/page_cache.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+// _____________________________________________________________________________
+TEST(PageCacheTest, residency) {
+  auto path =
+      (std::filesystem::temp_directory_path() / "xsgrep_page_cache").string();
+  // data that were just written are in the page cache (sampled: 8 MiB are
+  //  more than the default 64 samples of 16 pages)
+  std::ofstream(path) << std::string(8 << 20, 'x');
+  int fd = ::open(path.c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+  ASSERT_GT(page_cache_residency(fd, 8 << 20), 0.9);
+  ASSERT_GT(page_cache_residency(fd, 8 << 20, 1000000), 0.9);
+  ASSERT_TRUE(prefer_mmap(fd, 8 << 20));
+  ASSERT_TRUE(prefer_mmap(path));
+  // small files are read
+  ASSERT_FALSE(prefer_mmap(fd, 4096));
+  ASSERT_EQ(page_cache_residency(fd, 0), 0);
+  ::close(fd);
+  // unknown residency
+  ASSERT_EQ(page_cache_residency(-1, 4096), 0);
+  ASSERT_FALSE(prefer_mmap("/no/such/file"));
+  std::filesystem::remove(path);
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <gtest/gtest.h>
+#include <xsgrep/utils/regex_literals.h>
+
+#include <string>
+#include <vector>
+
+typedef std::vector<std::string> literals_;
+
+// _____________________________________________________________________________
+TEST(RegexLiteralsTest, required_literals) {
+  ASSERT_EQ(required_literals("Sherlock", false), literals_({"Sherlock"}));
+  ASSERT_EQ(required_literals("She[r_]lock", false),
+            literals_({"She_lock", "Sherlock"}));
+  ASSERT_EQ(required_literals("colou?r", false),
+            literals_({"color", "colour"}));
+  ASSERT_EQ(required_literals("^Sher.*ck$", false), literals_({"Sher"}));
+  ASSERT_EQ(required_literals("(Sherlock|Watson) Holmes", false),
+            literals_({"Sherlock Holmes", "Watson Holmes"}));
+  ASSERT_EQ(required_literals("[0-9]+ Baker Street", false),
+            literals_({" Baker Street"}));
+  ASSERT_EQ(required_literals("_[sS][A-Za-z]*k_", false), literals_({"k_"}));
+  ASSERT_EQ(required_literals("(ab)+c", false), literals_({"ab"}));
+  // case-insensitive: lower case literals
+  ASSERT_EQ(required_literals("SHER[Ll]ock", true), literals_({"sherlock"}));
+  // no required literal (of at least two bytes)
+  ASSERT_TRUE(required_literals("a|b.*", false).empty());
+  ASSERT_TRUE(required_literals("(Sherlock)?", false).empty());
+  ASSERT_TRUE(required_literals("x[^a]", false).empty());
+  ASSERT_TRUE(required_literals("Sher|k", false).empty());
+  // unsupported constructs
+  ASSERT_TRUE(required_literals("(?i)Sherlock", false).empty());
+  ASSERT_TRUE(required_literals("\\x41Sherlock", false).empty());
+  ASSERT_TRUE(required_literals("Sherlock(", false).empty());
+}
+
+// _____________________________________________________________________________
+TEST(RegexLiteralsTest, exact) {
+  bool exact = false;
+  ASSERT_EQ(required_literals("She[r ]lock", false, &exact),
+            literals_({"She lock", "Sherlock"}));
+  ASSERT_TRUE(exact);
+  required_literals("(Sherlock|Watson)", true, &exact);
+  ASSERT_TRUE(exact);
+  // anchors and other parts of the pattern must be checked by the regex
+  required_literals("^Sherlock", false, &exact);
+  ASSERT_FALSE(exact);
+  required_literals("Sherlock\\b", false, &exact);
+  ASSERT_FALSE(exact);
+  required_literals("Sher.*lock", false, &exact);
+  ASSERT_FALSE(exact);
+}
\ No newline at end of file
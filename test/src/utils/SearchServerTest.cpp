@@ -0,0 +1,53 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <gtest/gtest.h>
+#include <xsgrep/utils/SearchServer.h>
+
+#include <filesystem>
+#include <sstream>
+#include <thread>
+
+TEST(SearchServerTest, query) {
+  std::string socket_path =
+      (std::filesystem::temp_directory_path() / "xsgrep_server_test").string();
+  SearchServer server(
+      socket_path, [](const SearchServer::Query& query, std::ostream& out,
+                      std::ostream& err) {
+        out << query.cwd << (query.tty ? " tty" : "");
+        for (const auto& arg : query.args) {
+          out << ' ' << arg;
+        }
+        // more than fits into one message
+        out << '\n' << std::string(100000, 'x') << '\n';
+        err << "error output\n";
+        return static_cast<int>(query.args.size());
+      });
+  std::thread thread([&server] { server.run(); });
+
+  for (int i = 0; i < 3; ++i) {
+    std::ostringstream out;
+    std::ostringstream err;
+    int status = SearchServer::query(socket_path, {{"-n", "Sherlock"}, "/x"},
+                                     out, err);
+    ASSERT_EQ(status, 2);
+    ASSERT_EQ(out.str(),
+              "/x -n Sherlock\n" + std::string(100000, 'x') + '\n');
+    ASSERT_EQ(err.str(), "error output\n");
+  }
+  // only the owner of the server may connect
+  ASSERT_EQ(std::filesystem::status(socket_path).permissions(),
+            std::filesystem::perms::owner_read |
+                std::filesystem::perms::owner_write);
+  // a second server cannot listen on the socket
+  ASSERT_THROW(SearchServer(socket_path, {}), std::system_error);
+
+  server.stop();
+  thread.join();
+}
+
+TEST(SearchServerTest, no_server) {
+  std::ostringstream out;
+  ASSERT_THROW(SearchServer::query("/nonexistent/socket", {}, out, out),
+               std::system_error);
+}
\ No newline at end of file
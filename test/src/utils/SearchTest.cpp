@@ -0,0 +1,69 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <gtest/gtest.h>
+#include <xsgrep/utils/search.h>
+
+#include <string>
+
+TEST(SearchTest, find_icase) {
+  std::string data("This is a sample text\nwith ShErLoCk\nand SHERLOCK.");
+  {
+    auto* res = find_icase(data.data(), data.size(), "sherlock", 8);
+    ASSERT_EQ(res, data.data() + 27);
+    res = find_icase(res + 1, data.size() - 28, "sherlock", 8);
+    ASSERT_EQ(res, data.data() + 40);
+    res = find_icase(res + 1, data.size() - 41, "sherlock", 8);
+    ASSERT_EQ(res, nullptr);
+  }
+  {
+    auto* res = find_icase(data.data(), data.size(), "this", 4);
+    ASSERT_EQ(res, data.data());
+    res = find_icase(data.data(), data.size(), "k.", 2);
+    ASSERT_EQ(res, data.data() + data.size() - 2);
+    res = find_icase(data.data(), data.size(), "x", 1);
+    ASSERT_EQ(res, data.data() + 19);
+    res = find_icase(data.data(), data.size(), "sherlocks", 9);
+    ASSERT_EQ(res, nullptr);
+  }
+  {
+    // non letters must not be case folded: '@' (0x40) vs '`' (0x60)
+    std::string other("a`b@c[d{");
+    ASSERT_EQ(find_icase(other.data(), other.size(), "@c", 2),
+              other.data() + 3);
+    ASSERT_EQ(find_icase(other.data(), other.size(), "[", 1), other.data() + 5);
+    ASSERT_EQ(find_icase(other.data(), other.size(), "`c", 2), nullptr);
+  }
+  {
+    // compare with a naive search on long data (SIMD blocks + remainder)
+    std::string text;
+    for (int i = 0; i < 1000; ++i) {
+      text += (i % 7 == 0) ? "xSheRLocKx" : "she lock ";
+    }
+    size_t count = 0;
+    const char* shift = text.data();
+    const char* end = text.data() + text.size();
+    while (true) {
+      auto* res = find_icase(shift, end - shift, "sherlock", 8);
+      if (res == nullptr) {
+        break;
+      }
+      ASSERT_EQ(std::string(res, 8), "SheRLocK");
+      count++;
+      shift = res + 1;
+    }
+    ASSERT_EQ(count, 143);
+  }
+}
+
+TEST(SearchTest, count_new_lines) {
+  ASSERT_EQ(count_new_lines("", 0), 0);
+  ASSERT_EQ(count_new_lines("a\nb\n\nc", 7), 3);
+  // more than 255 SIMD blocks (per byte counters) and a remainder
+  std::string text;
+  for (int i = 0; i < 10000; ++i) {
+    text += (i % 3 == 0) ? "\n" : "line";
+  }
+  ASSERT_EQ(count_new_lines(text.data(), text.size()), 3334);
+  ASSERT_EQ(count_new_lines(text.data() + 1, text.size() - 1), 3333);
+}
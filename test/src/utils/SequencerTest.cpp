@@ -0,0 +1,112 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <gtest/gtest.h>
+#include <xsgrep/utils/Sequencer.h>
+
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST(SequencerTest, ordered) {
+  std::vector<uint64_t> consumed;
+  {
+    Sequencer<uint64_t> sequencer(8, [&](uint64_t id, uint64_t value) {
+      ASSERT_EQ(id, value);
+      consumed.push_back(value);
+    });
+    // ids are published by several threads in (almost) any order
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t < 4; ++t) {
+      threads.emplace_back([&sequencer, t] {
+        for (uint64_t id = t; id < 1000; id += 4) {
+          sequencer.publish(id, id);
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    sequencer.flush();
+    ASSERT_EQ(consumed.size(), 1000);
+    ASSERT_EQ(sequencer.stats().depth, 0);
+    ASSERT_LE(sequencer.stats().max_depth, 8);
+  }
+  for (uint64_t id = 0; id < consumed.size(); ++id) {
+    ASSERT_EQ(consumed[id], id);
+  }
+}
+
+TEST(SequencerTest, backpressure) {
+  std::vector<int> consumed;
+  Sequencer<int> sequencer(1, [&](uint64_t, int value) {
+    consumed.push_back(value);
+  });
+  // id 1 must wait until id 0 was published and consumed
+  std::thread waiting([&sequencer] { sequencer.publish(1, 1); });
+  while (sequencer.stats().producer_waits == 0) {
+    std::this_thread::yield();
+  }
+  sequencer.publish(0, 0);
+  waiting.join();
+  sequencer.close();
+  ASSERT_EQ(consumed, std::vector<int>({0, 1}));
+  ASSERT_EQ(sequencer.stats().producer_waits, 1);
+  ASSERT_EQ(sequencer.stats().max_depth, 1);
+}
+
+TEST(SequencerTest, error) {
+  int consumed = 0;
+  Sequencer<int> sequencer(4, [&](uint64_t id, int) {
+    if (id == 1) {
+      throw std::runtime_error("write failed");
+    }
+    consumed++;
+  });
+  for (int id = 0; id < 10; ++id) {
+    // producers are not blocked by a failed consumer
+    sequencer.publish(id, id);
+  }
+  ASSERT_THROW(sequencer.close(), std::runtime_error);
+  ASSERT_EQ(consumed, 1);
+}
+
+TEST(SequencerTest, max_bytes) {
+  std::vector<int> consumed;
+  Sequencer<int> sequencer(
+      8, [&](uint64_t, int value) { consumed.push_back(value); }, 10);
+  // 2 and 1 do not fit into the limit while 0 is missing: 1 waits
+  sequencer.publish(2, 2, 6);
+  std::thread waiting([&sequencer] { sequencer.publish(1, 1, 6); });
+  while (sequencer.stats().producer_waits == 0) {
+    std::this_thread::yield();
+  }
+  ASSERT_EQ(sequencer.stats().bytes, 6);
+  // the value the writer waits for is never blocked by the limit
+  sequencer.publish(0, 0, 20);
+  waiting.join();
+  sequencer.close();
+  ASSERT_EQ(consumed, std::vector<int>({0, 1, 2}));
+  ASSERT_EQ(sequencer.stats().bytes, 0);
+  ASSERT_LE(sequencer.stats().max_bytes, 26);
+}
+
+TEST(SequencerTest, abort) {
+  std::vector<int> consumed;
+  Sequencer<int> sequencer(1, [&](uint64_t, int value) {
+    consumed.push_back(value);
+  });
+  sequencer.publish(0, 0);
+  // the producer of id 1 failed: id 2 waits for a slot that never gets free
+  std::thread waiting([&sequencer] { sequencer.publish(2, 2); });
+  while (sequencer.stats().producer_waits == 0) {
+    std::this_thread::yield();
+  }
+  sequencer.abort();
+  waiting.join();
+  sequencer.flush();
+  // dropped once the sequencer was aborted
+  sequencer.publish(1, 1);
+  sequencer.close();
+  ASSERT_EQ(consumed, std::vector<int>({0}));
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+// Copyright 2023, Leon Freist
+// Author: Leon Freist <freist@informatik.uni-freiburg.de>
+
+#include <gtest/gtest.h>
+#include <xsgrep/utils/WorkerPool.h>
+
+#include <atomic>
+#include <set>
+
+TEST(WorkerPoolTest, run_tasks) {
+  std::atomic<int> sum{0};
+  std::mutex mutex;
+  std::set<std::thread::id> thread_ids;
+  {
+    WorkerPool pool(4);
+    ASSERT_EQ(pool.size(), 4);
+    for (int i = 1; i <= 1000; ++i) {
+      pool.submit([&, i] {
+        sum += i;
+        std::unique_lock lock(mutex);
+        thread_ids.insert(std::this_thread::get_id());
+      });
+    }
+    // all submitted tasks are run before the pool is destroyed
+  }
+  ASSERT_EQ(sum, 500500);
+  ASSERT_LE(thread_ids.size(), 4);
+}
+
+TEST(WorkerPoolTest, global) {
+  ASSERT_EQ(&WorkerPool::global(), &WorkerPool::global());
+  ASSERT_GT(WorkerPool::global().size(), 0);
+}
\ No newline at end of file
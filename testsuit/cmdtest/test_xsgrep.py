@@ -187,6 +187,94 @@ def test_literal_ascii_fixed_string() -> base.TestSuit:
     )
 
 
+def test_literal_ascii_max_count() -> base.TestSuit:
+    ref_command = base.ReferenceCommand("grep", ["grep", ASCII_PATTERN, INPUT_FILE, "-n", "-m", "3"])
+    commands = [
+        base.Command("xs", ["xs", ASCII_PATTERN, INPUT_FILE, "-n", "--max-count", "3"]),
+        base.Command("xs -j 1", ["xs", ASCII_PATTERN, INPUT_FILE, "-j", "1", "-n", "--max-count", "3"]),
+        base.Command("xs --no-mmap", ["xs", ASCII_PATTERN, INPUT_FILE, "-n", "--max-count", "3", "--no-mmap"]),
+    ]
+    return base.TestSuit(
+        "ASCII search (--max-count)",
+        commands=commands,
+        reference_command=ref_command,
+        exit_on_fail=EXIT_ON_FAIL
+    )
+
+
+def test_literal_ascii_files_with_matches() -> base.TestSuit:
+    ref_command = base.ReferenceCommand("grep", ["grep", ASCII_PATTERN, INPUT_FILE, "-l"])
+    commands = [
+        base.Command("xs", ["xs", ASCII_PATTERN, INPUT_FILE, "-l"]),
+        base.Command("xs -j 1", ["xs", ASCII_PATTERN, INPUT_FILE, "-j", "1", "-l"]),
+        base.Command("xs --no-mmap", ["xs", ASCII_PATTERN, INPUT_FILE, "-l", "--no-mmap"]),
+    ]
+    return base.TestSuit(
+        "ASCII search (-l)",
+        commands=commands,
+        reference_command=ref_command,
+        exit_on_fail=EXIT_ON_FAIL
+    )
+
+
+def test_literal_ascii_multiple_patterns() -> base.TestSuit:
+    ref_command = base.ReferenceCommand("grep", ["grep", "-e", ASCII_PATTERN, "-e", "Watson", INPUT_FILE, "-n"])
+    commands = [
+        base.Command("xs", ["xs", "-e", ASCII_PATTERN, "-e", "Watson", INPUT_FILE, "-n"]),
+        base.Command("xs -j 1", ["xs", "-e", ASCII_PATTERN, "-e", "Watson", INPUT_FILE, "-j", "1", "-n"]),
+        base.Command("xs --no-mmap", ["xs", "-e", ASCII_PATTERN, "-e", "Watson", INPUT_FILE, "-n", "--no-mmap"]),
+    ]
+    return base.TestSuit(
+        "ASCII search (-e)",
+        commands=commands,
+        reference_command=ref_command,
+        exit_on_fail=EXIT_ON_FAIL
+    )
+
+
+def test_literal_ascii_count_pattern_option() -> base.TestSuit:
+    ref_command = base.ReferenceCommand("grep", ["grep", "-c", "-e", ASCII_PATTERN, INPUT_FILE])
+    commands = [
+        base.Command("xs", ["xs", "-c", "-e", ASCII_PATTERN, INPUT_FILE]),
+        base.Command("xs -j 1", ["xs", "-c", "-e", ASCII_PATTERN, INPUT_FILE, "-j", "1"]),
+        base.Command("xs --no-mmap", ["xs", "-c", "-e", ASCII_PATTERN, INPUT_FILE, "--no-mmap"]),
+    ]
+    return base.TestSuit(
+        "ASCII search (-c -e)",
+        commands=commands,
+        reference_command=ref_command,
+        exit_on_fail=EXIT_ON_FAIL
+    )
+
+
+def test_empty_pattern_file_files_without_match() -> base.TestSuit:
+    ref_command = base.ReferenceCommand("grep", ["grep", "-L", "-f", "/dev/null", INPUT_FILE])
+    commands = [
+        base.Command("xs", ["xs", "-L", "-f", "/dev/null", INPUT_FILE]),
+        base.Command("xs -j 1", ["xs", "-L", "-f", "/dev/null", INPUT_FILE, "-j", "1"]),
+    ]
+    return base.TestSuit(
+        "empty pattern file (-L -f)",
+        commands=commands,
+        reference_command=ref_command,
+        exit_on_fail=EXIT_ON_FAIL
+    )
+
+
+def test_empty_pattern_file_invert_match() -> base.TestSuit:
+    ref_command = base.ReferenceCommand("grep", ["grep", "-v", "-f", "/dev/null", INPUT_FILE])
+    commands = [
+        base.Command("xs", ["xs", "-v", "-f", "/dev/null", INPUT_FILE]),
+        base.Command("xs -j 1", ["xs", "-v", "-f", "/dev/null", INPUT_FILE, "-j", "1"]),
+    ]
+    return base.TestSuit(
+        "empty pattern file (-v -f)",
+        commands=commands,
+        reference_command=ref_command,
+        exit_on_fail=EXIT_ON_FAIL
+    )
+
+
 def test_preprocessed_regex() -> base.TestSuit:
     ref_command = base.ReferenceCommand("grep", ["grep", ASCII_RE, INPUT_FILE, "-n"])
     meta = "tmp.meta"
@@ -286,6 +374,12 @@ if __name__ == "__main__":
         "xsgrep regex ASCII (-i)": test_regex_ascii_ignore_case,
         "xsgrep literal ASCII (-o)": test_literal_ascii_match_only,
         "xsgrep regex ASCII (-o)": test_regex_ascii_match_only,
+        "xsgrep literal ASCII (--max-count)": test_literal_ascii_max_count,
+        "xsgrep literal ASCII (-l)": test_literal_ascii_files_with_matches,
+        "xsgrep literal ASCII (-e)": test_literal_ascii_multiple_patterns,
+        "xsgrep literal ASCII (-c -e)": test_literal_ascii_count_pattern_option,
+        "xsgrep empty pattern file (-L -f)": test_empty_pattern_file_files_without_match,
+        "xsgrep empty pattern file (-v -f)": test_empty_pattern_file_invert_match,
         "xsgrep preprocessed literal": test_preprocessed_literal,
         "xsgrep preprocessed regex": test_preprocessed_regex,
     }
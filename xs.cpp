@@ -1,34 +1,96 @@
 // Copyright 2023, Leon Freist
 // Author: Leon Freist <freist@informatik.uni-freiburg.de>
 
+#include <pthread.h>
+#include <unistd.h>
 #include <xsearch/xsearch.h>
 #include <xsgrep/grep.h>
+#include <xsgrep/tasks/GrepReader.h>
+#include <xsgrep/tasks/GrepSearcher.h>
+#include <xsgrep/utils/SearchServer.h>
 
 #include <boost/program_options.hpp>
+#include <cctype>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <thread>
 
 namespace po = boost::program_options;
 
-void print_version() {
-  std::cout << "xs (xs grep) 1.0\n";
-  std::cout << "Copyright (C) 2023 Leon Freist\n";
-  std::cout << "Written in the scope of the Undergraduate Thesis of Leon "
-               "Freist at the chair of Algorithms and Datastructures "
-               "(University of Freiburg).\n";
-  std::cout << "Examiner:   Prof. Dr. Hannah Bast\n";
-  std::cout << "Supervisor: Johannes Kalmbach\n";
-  std::cout << '\n';
-  std::cout << "Written by Leon Freist; see\n";
-  std::cout << "<https://github.com/lfreist/xsgrep>\n";
+void print_version(std::ostream& out) {
+  out << "xs (xs grep) 1.0\n";
+  out << "Copyright (C) 2023 Leon Freist\n";
+  out << "Written in the scope of the Undergraduate Thesis of Leon "
+         "Freist at the chair of Algorithms and Datastructures "
+         "(University of Freiburg).\n";
+  out << "Examiner:   Prof. Dr. Hannah Bast\n";
+  out << "Supervisor: Johannes Kalmbach\n";
+  out << '\n';
+  out << "Written by Leon Freist; see\n";
+  out << "<https://github.com/lfreist/xsgrep>\n";
 }
 
-int main(int argc, char** argv) {
-  INLINE_BENCHMARK_WALL_START(_, "total");
+/**
+ * Parse a number of bytes with an optional suffix K, M or G (KiB, MiB, GiB).
+ */
+size_t parse_size(const std::string& size) {
+  size_t end = 0;
+  size_t value = std::stoull(size, &end);
+  std::string suffix = size.substr(end);
+  if (suffix.empty()) {
+    return value;
+  }
+  if (suffix.size() == 1) {
+    switch (std::toupper(static_cast<unsigned char>(suffix[0]))) {
+      case 'K':
+        return value << 10;
+      case 'M':
+        return value << 20;
+      case 'G':
+        return value << 30;
+      default:
+        break;
+    }
+  }
+  throw std::invalid_argument("invalid size: " + size);
+}
+
+/**
+ * Arguments: The parsed command line arguments of xs.
+ */
+struct Arguments {
+  Grep::Options grep_options;
+  std::vector<std::string> pattern_files;
+  /// socket of the server (--serve)
+  std::string serve;
 #ifdef BENCHMARK
   std::string benchmark_file;
   std::string benchmark_format;
 #endif
-  Grep::Options grep_options;
+};
+
+/**
+ * Parse the command line arguments argv (without the program name) into
+ *  args. Relative paths are resolved against cwd (unless it is empty).
+ * @return the exit status if xs is done (help, version or invalid arguments)
+ */
+std::optional<int> parse_args(const std::vector<std::string>& argv,
+                              const std::filesystem::path& cwd,
+                              Arguments* args, std::ostream& out,
+                              std::ostream& err) {
+  Grep::Options& grep_options = args->grep_options;
+  std::string color;
+  std::string io;
+  bool no_mmap = false;
+  std::string max_memory;
+  int64_t context = -1;
 
   po::options_description options("Options for xsgrep");
   po::positional_options_description positional_options;
@@ -47,8 +109,15 @@ int main(int argc, char** argv) {
   // ----------------------------------
   add_positional("PATTERN", 1);
   add_positional("PATH", 1);
-  add("PATTERN", po::value<std::string>(&grep_options.pattern)->required(),
+  add("PATTERN", po::value<std::string>(&grep_options.pattern),
       "search pattern");
+  add("regexp,e",
+      po::value<std::vector<std::string>>(&grep_options.patterns)
+          ->composing(),
+      "use PATTERN for matching (may be given several times)");
+  add("file,f",
+      po::value<std::vector<std::string>>(&args->pattern_files)->composing(),
+      "take PATTERNs from FILE (one per line)");
   add("PATH", po::value<std::string>(&grep_options.file)->default_value(""),
       "input file, stdin if '-' or empty");
   add("metafile,m",
@@ -66,25 +135,75 @@ int main(int argc, char** argv) {
       "number of concurrently reading tasks (default is number of threads");
   add("count,c", po::bool_switch(&grep_options.count),
       "print only a count of selected lines");
+  add("max-count",
+      po::value<int64_t>(&grep_options.max_count)->default_value(-1),
+      "stop after NUM selected lines per file (-1: unlimited)");
+  add("quiet,q", po::bool_switch(&grep_options.quiet),
+      "suppress all normal output, exit with 0 on the first match");
+  add("files-with-matches,l", po::bool_switch(&grep_options.files_with_matches),
+      "print only names of FILEs with selected lines");
+  add("files-without-match,L",
+      po::bool_switch(&grep_options.files_without_match),
+      "print only names of FILEs with no selected lines");
   add("byte-offset,b", po::bool_switch(&grep_options.byte_offset),
       "print the byte offset with output lines");
   add("line-number,n", po::bool_switch(&grep_options.line_number),
       "print line number with output lines");
   add("only-matching,o", po::bool_switch(&grep_options.only_matching),
       "show only nonempty parts of lines that match");
+  add("invert-match,v", po::bool_switch(&grep_options.invert_match),
+      "select non-matching lines");
+  add("word-regexp,w", po::bool_switch(&grep_options.word_regexp),
+      "match only whole words");
+  add("line-regexp,x", po::bool_switch(&grep_options.line_regexp),
+      "match only whole lines");
+  add("after-context,A", po::value<int64_t>(&grep_options.after_context),
+      "print NUM lines of trailing context");
+  add("before-context,B", po::value<int64_t>(&grep_options.before_context),
+      "print NUM lines of leading context");
+  add("context,C", po::value<int64_t>(&context),
+      "print NUM lines of output context");
   add("ignore-case,i",
       po::bool_switch(&grep_options.ignore_case)->default_value(false),
       "ignore case distinctions in patterns and data");
   add("fixed-strings,F",
       po::bool_switch(&grep_options.fixed_string)->default_value(false),
       "PATTERN is string (force no regex)");
-  add("no-mmap", po::bool_switch(&grep_options.no_mmap)->default_value(false),
-      "do not use mmap but read data instead");
+  add("io", po::value<std::string>(&io)->default_value("auto"),
+      "read FILEs using mmap, read or decide per file by whether it is cached "
+      "(mmap, read, auto)");
+  add("no-mmap", po::bool_switch(&no_mmap)->default_value(false),
+      "do not use mmap but read data instead (same as --io=read)");
+  add("meta-suffix",
+      po::value<std::string>(&grep_options.meta_file_suffix)
+          ->default_value(".meta"),
+      "recursive search: read FILE using the metafile FILE<suffix> if it "
+      "exists (disabled if empty)");
+  add("color", po::value<std::string>(&color)->default_value("auto"),
+      "use markers to highlight the matching strings (always, never, auto)");
+  add("max-memory", po::value<std::string>(&max_memory)->default_value("256M"),
+      "maximum SIZE of the results buffered for ordered output (K, M or G "
+      "suffix), searching threads wait once it is reached (0: unlimited)");
+  add("line-buffered", po::bool_switch(&grep_options.line_buffered),
+      "flush output as soon as lines were found");
+  add("io-uring",
+      po::value<int>(&grep_options.io_uring_depth)
+          ->default_value(0)
+          ->implicit_value(16),
+      "read FILE with io_uring, keeping NUM reads in flight (falls back to "
+      "blocking reads if io_uring is not available)");
+  add("serve", po::value<std::string>(&args->serve),
+      "keep running and answer the queries of clients (--connect) on the Unix "
+      "socket SOCKET: files stay mapped, metafiles parsed and patterns "
+      "compiled across queries");
+  add("connect", po::value<std::string>(),
+      "send the query to the server listening on SOCKET (see --serve), the "
+      "server resolves relative paths against the working directory");
 #ifdef BENCHMARK
-  add("benchmark-file", po::value<std::string>(&benchmark_file),
+  add("benchmark-file", po::value<std::string>(&args->benchmark_file),
       "set output file of benchmark measurements.");
   add("benchmark-format",
-      po::value<std::string>(&benchmark_format)->default_value("json"),
+      po::value<std::string>(&args->benchmark_format)->default_value("json"),
       "specify the output format of benchmark measurements (plain, json, "
       "csv");
 #endif
@@ -93,37 +212,226 @@ int main(int argc, char** argv) {
   // ------------------------------------------------
   po::variables_map optionsMap;
   try {
-    po::store(po::command_line_parser(argc, argv)
+    po::store(po::command_line_parser(argv)
                   .options(options)
                   .positional(positional_options)
                   .run(),
               optionsMap);
     if (optionsMap.count("help")) {
-      std::cout << options << std::endl;
+      out << options << std::endl;
       return 0;
     }
     if (optionsMap.count("version")) {
-      print_version();
+      print_version(out);
       return 0;
     }
     po::notify(optionsMap);
+    if (color == "always") {
+      grep_options.color = Grep::Color::ON;
+    } else if (color == "never") {
+      grep_options.color = Grep::Color::OFF;
+    } else if (color == "auto") {
+      grep_options.color = Grep::Color::AUTO;
+    } else {
+      throw std::invalid_argument("invalid argument for --color: " + color);
+    }
+    if (no_mmap || io == "read") {
+      grep_options.io = Grep::IO::READ;
+    } else if (io == "mmap") {
+      grep_options.io = Grep::IO::MMAP;
+    } else if (io == "auto") {
+      grep_options.io = Grep::IO::AUTO;
+    } else {
+      throw std::invalid_argument("invalid argument for --io: " + io);
+    }
+    grep_options.max_memory = parse_size(max_memory);
+    // -A and -B take precedence over -C
+    if (optionsMap.count("after-context") == 0) {
+      grep_options.after_context = context;
+    }
+    if (optionsMap.count("before-context") == 0) {
+      grep_options.before_context = context;
+    }
+    if (grep_options.patterns.empty() && args->pattern_files.empty()) {
+      // a server gets the patterns with the queries
+      if (optionsMap.count("PATTERN") == 0 && args->serve.empty()) {
+        throw std::invalid_argument("no PATTERN provided");
+      }
+    } else {
+      // patterns are given by -e/-f: the first positional argument is PATH
+      grep_options.use_patterns = true;
+      if (optionsMap.count("PATTERN") > 0) {
+        if (!optionsMap["PATH"].defaulted()) {
+          throw std::invalid_argument("only one PATH can be searched");
+        }
+        grep_options.file = grep_options.pattern;
+        grep_options.pattern.clear();
+      }
+      for (const auto& pattern_file : args->pattern_files) {
+        std::ifstream stream(cwd / pattern_file);
+        if (!stream) {
+          throw std::invalid_argument(pattern_file +
+                                      ": No such file or directory");
+        }
+        std::string line;
+        while (std::getline(stream, line)) {
+          grep_options.patterns.push_back(line);
+        }
+      }
+    }
+    if (!cwd.empty()) {
+      if (!(grep_options.file.empty() || grep_options.file == "-")) {
+        if (std::filesystem::path(grep_options.file).is_relative()) {
+          // the names are written as the client gave them
+          grep_options.display_root = cwd.string();
+        }
+        grep_options.file = cwd / grep_options.file;
+      }
+      if (!grep_options.meta_file_path.empty()) {
+        grep_options.meta_file_path = cwd / grep_options.meta_file_path;
+      }
+    }
   } catch (const std::exception& e) {
-    std::cerr << "Error in command line argument: " << e.what() << std::endl;
-    std::cerr << options << std::endl;
+    err << "Error in command line argument: " << e.what() << std::endl;
+    err << options << std::endl;
     return 1;
   }
+  return {};
+}
+
+/**
+ * Search as described by args, write the results to out and the errors of
+ *  files that cannot be read to err.
+ * @return exit status (0: selected lines, 1: none, 2: errors)
+ */
+int run_search(const Arguments& args, std::ostream* out, std::ostream* err,
+               std::shared_ptr<FileCache> file_cache = nullptr,
+               std::shared_ptr<SearcherCache> searcher_cache = nullptr) {
+  Grep grep(args.grep_options);
+  grep.set_caches(std::move(file_cache), std::move(searcher_cache));
+  grep.set_error_stream(err);
+  bool selected = grep.write(out);
+  if (grep.errors() > 0 && !(selected && grep.quiet())) {
+    // like grep: a file could not be read (unless -q already found a match)
+    return 2;
+  }
+  return selected ? 0 : 1;
+}
+
+/**
+ * Answer the queries of clients on socket_path until SIGINT or SIGTERM is
+ *  received. The files, metafiles and compiled patterns of the queries are
+ *  cached, the threads searching are shared by all queries.
+ * @return exit status
+ */
+int serve(const std::string& socket_path) {
+  // the signals are only received by the thread waiting for them
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+  auto file_cache = std::make_shared<FileCache>();
+  auto searcher_cache = std::make_shared<SearcherCache>();
+  auto handler = [&](const SearchServer::Query& query, std::ostream& out,
+                     std::ostream& err) {
+    Arguments args;
+    auto status = parse_args(query.args, query.cwd, &args, out, err);
+    if (status.has_value()) {
+      return *status;
+    }
+    if (!args.serve.empty()) {
+      err << "xs: --serve is not a query." << std::endl;
+      return 1;
+    }
+    const auto& file = args.grep_options.file;
+    if (file.empty() || file == "-") {
+      err << "xs: standard input cannot be searched by a server." << std::endl;
+      return 1;
+    }
+    if (!std::filesystem::exists(file)) {
+      err << file << ": No such file or directory" << std::endl;
+      return 1;
+    }
+    if (args.grep_options.color == Grep::Color::AUTO) {
+      // the output of the client matters
+      args.grep_options.color =
+          query.tty ? Grep::Color::ON : Grep::Color::OFF;
+    }
+    return run_search(args, &out, &err, file_cache, searcher_cache);
+  };
+  std::unique_ptr<SearchServer> server;
+  try {
+    server = std::make_unique<SearchServer>(socket_path, handler);
+  } catch (const std::system_error& e) {
+    std::cerr << "xs: " << e.what() << std::endl;
+    return 2;
+  }
+  std::thread signal_thread([&] {
+    int signal = 0;
+    sigwait(&signals, &signal);
+    server->stop();
+  });
+  int status = 0;
+  try {
+    server->run();
+  } catch (const std::system_error& e) {
+    std::cerr << "xs: " << e.what() << std::endl;
+    status = 2;
+    // wake up the signal thread
+    ::kill(::getpid(), SIGTERM);
+  }
+  signal_thread.join();
+  return status;
+}
+
+int main(int argc, char** argv) {
+  INLINE_BENCHMARK_WALL_START(_, "total");
+  // thin client: the query is parsed and answered by the server
+  std::string socket_path;
+  std::vector<std::string> query_args;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg == "--connect" && i + 1 < argc) {
+      socket_path = argv[++i];
+    } else if (arg.starts_with("--connect=")) {
+      socket_path = arg.substr(std::strlen("--connect="));
+    } else {
+      query_args.emplace_back(arg);
+    }
+  }
+  if (!socket_path.empty()) {
+    try {
+      return SearchServer::query(
+          socket_path,
+          {query_args, std::filesystem::current_path(),
+           isatty(STDOUT_FILENO) != 0},
+          std::cout, std::cerr);
+    } catch (const std::system_error& e) {
+      std::cerr << "xs: " << e.what() << std::endl;
+      return 2;
+    }
+  }
 
-  Grep grep(grep_options);
-  grep.write();
+  Arguments args;
+  auto status = parse_args(std::vector<std::string>(argv + 1, argv + argc),
+                           {}, &args, std::cout, std::cerr);
+  if (status.has_value()) {
+    return *status;
+  }
+  if (!args.serve.empty()) {
+    return serve(args.serve);
+  }
+  int exit_status = run_search(args, &std::cout, &std::cerr);
 
   INLINE_BENCHMARK_WALL_STOP("total");
 #ifdef BENCHMARK
-  if (optionsMap.count("benchmark-file")) {
-    std::ofstream out_stream(benchmark_file);
-    out_stream << INLINE_BENCHMARK_REPORT(benchmark_format);
+  if (!args.benchmark_file.empty()) {
+    std::ofstream out_stream(args.benchmark_file);
+    out_stream << INLINE_BENCHMARK_REPORT(args.benchmark_format);
   } else {
-    std::cerr << INLINE_BENCHMARK_REPORT(benchmark_format) << std::endl;
+    std::cerr << INLINE_BENCHMARK_REPORT(args.benchmark_format) << std::endl;
   }
 #endif
-  return 0;
+  return exit_status;
 }
\ No newline at end of file
@@ -4,7 +4,10 @@
 #include <xsearch/xsearch.h>
 #include <xsgrep/xspp/components.h>
 
+#include <algorithm>
 #include <boost/program_options.hpp>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 
 namespace po = boost::program_options;
@@ -19,6 +22,8 @@ struct ProcArgs {
   bool hc = false;
   size_t min_chunk_size = 16777216;
   uint64_t mapping_data_distance = 500;
+  size_t ngram_filter_size = 0;
+  bool append = false;
 };
 
 int main(int argc, char** argv) {
@@ -65,6 +70,15 @@ int main(int argc, char** argv) {
   add("bytes-nl-distance,d",
       po::value<uint64_t>(&args.mapping_data_distance)->default_value(16000),
       "number of bytes between new lines that are stored in meta file");
+  add("ngram-filter,n",
+      po::value<size_t>(&args.ngram_filter_size)
+          ->default_value(0)
+          ->implicit_value(65536),
+      "size in bytes of the trigram filter stored per chunk in "
+      "<meta-file>.ngrams (0: none). xs skips chunks that cannot match");
+  add("append", po::bool_switch(&args.append),
+      "only process the data appended to input-file since meta-file was "
+      "written, extend output-file and meta-file (and its n-gram filters)");
 
   po::variables_map optionsMap;
 
@@ -78,16 +92,24 @@ int main(int argc, char** argv) {
       std::cout << options << std::endl;
       return 0;
     }
+    po::notify(optionsMap);
     if (!optionsMap.count("input-file")) {
       std::cerr << "Error: You must provide an input-file." << std::endl;
       return 1;
     }
+    if (args.ngram_filter_size > 0 && args.meta_file.empty()) {
+      std::cerr << "Error: --ngram-filter requires a meta-file." << std::endl;
+      return 1;
+    }
+    if (args.append && args.meta_file.empty()) {
+      std::cerr << "Error: --append requires a meta-file." << std::endl;
+      return 1;
+    }
     if (optionsMap.count("compression-alg")) {
       if (args.compression_level == 0) {
         args.compression_level = args.compression_alg == "lz4" ? 1 : 3;
       }
     }
-    po::notify(optionsMap);
   } catch (const std::exception& e) {
     std::cerr << "Error in command line argument: " << e.what() << std::endl;
     std::cerr << options << std::endl;
@@ -98,16 +120,66 @@ int main(int argc, char** argv) {
   //  a) 0 -> 1
   //  b) < 0 -> number of threads available
   //  c) > number of threads available -> number of threads available
-  int max_threads = static_cast<int>(std::thread::hardware_concurrency()) / 2;
+  int max_threads =
+      std::max(static_cast<int>(std::thread::hardware_concurrency()) / 2, 1);
   args.num_threads = args.num_threads <= 0 ? max_threads : args.num_threads;
   args.num_threads =
       args.num_threads > max_threads ? max_threads : args.num_threads;
 
+  // read what was processed before (append mode) ------------------------------
+  xs::CompressionType compression_type = xs::from_string(args.compression_alg);
+  ProcessedPrefix prefix;
+  // the metafile and the filters are replaced once the new data are written
+  std::string meta_file = args.meta_file;
+  std::string ngram_file = args.meta_file + NgramFilter::file_suffix;
+  bool appending = args.append && std::filesystem::exists(args.meta_file);
+  if (appending) {
+    try {
+      prefix = ProcessedPrefix::read(args.meta_file, args.source_file);
+      if (std::filesystem::exists(ngram_file)) {
+        size_t size = NgramFilter::read_filter_size(ngram_file);
+        if (args.ngram_filter_size > 0 &&
+            NgramFilter(args.ngram_filter_size).num_bytes() != size) {
+          throw std::runtime_error(
+              "--ngram-filter does not match the existing filters.");
+        }
+        args.ngram_filter_size = size;
+        std::filesystem::copy_file(
+            ngram_file, ngram_file + ".tmp",
+            std::filesystem::copy_options::overwrite_existing);
+      }
+    } catch (const std::exception& e) {
+      std::cerr << "Error: " << e.what() << std::endl;
+      return 1;
+    }
+    if (!optionsMap["compression-alg"].defaulted() &&
+        compression_type != prefix.compression_type) {
+      std::cerr << "Error: --compression-alg does not match meta-file."
+                << std::endl;
+      return 1;
+    }
+    compression_type = prefix.compression_type;
+    if (args.compression_level == 0) {
+      args.compression_level =
+          compression_type == xs::CompressionType::LZ4 ? 1 : 3;
+    }
+    meta_file += ".tmp";
+  }
+
   // ===== Setup xs::Executor for preprocessing ================================
 
   // set reader ----------------------------------------------------------------
-  auto reader = std::make_unique<xs::task::reader::FileBlockReader>(
-      args.source_file, args.min_chunk_size);
+  std::unique_ptr<xs::task::base::DataProvider<xs::DataChunk>> reader;
+  if (args.append) {
+    // an incomplete last line is left for the next run
+    reader = std::make_unique<TailReader>(args.source_file,
+                                          prefix.original_size,
+                                          prefix.next_chunk_index,
+                                          args.min_chunk_size);
+  } else {
+    reader = std::make_unique<xs::task::reader::FileBlockReader>(
+        args.source_file, args.min_chunk_size);
+  }
 
   // set inplace processors ----------------------------------------------------
   std::vector<std::unique_ptr<xs::task::base::InplaceProcessor<xs::DataChunk>>>
@@ -117,7 +189,23 @@ int main(int argc, char** argv) {
       std::make_unique<xs::task::processor::NewLineSearcher>(
           args.mapping_data_distance));
 
-  xs::CompressionType compression_type = xs::from_string(args.compression_alg);
+  // the filters are computed from the uncompressed data
+  std::shared_ptr<NgramFilterTable> ngram_filters;
+  std::unique_ptr<std::ostream> ngram_stream;
+  if (args.ngram_filter_size > 0) {
+    ngram_filters = std::make_shared<NgramFilterTable>();
+    if (appending && std::filesystem::exists(ngram_file + ".tmp")) {
+      ngram_stream = std::make_unique<std::ofstream>(
+          ngram_file + ".tmp", std::ios::binary | std::ios::app);
+    } else {
+      ngram_stream = std::make_unique<std::ofstream>(
+          appending ? ngram_file + ".tmp" : ngram_file, std::ios::binary);
+      NgramFilter::write_header(*ngram_stream, args.ngram_filter_size);
+    }
+    inplace_processors.push_back(
+        std::make_unique<NgramIndexer>(args.ngram_filter_size, ngram_filters));
+  }
+
   switch (compression_type) {
     case xs::CompressionType::LZ4:
       inplace_processors.push_back(
@@ -135,16 +223,26 @@ int main(int argc, char** argv) {
 
   // set return processor ------------------------------------------------------
   auto output_creator = std::make_unique<MetaDataCreator>();
-  auto out_stream = args.output_file.empty()
-                        ? nullptr
-                        : std::make_unique<std::ofstream>(args.output_file);
-  auto result = std::make_unique<DataWriter>(
-      std::string(args.meta_file), xs::CompressionType(compression_type),
-      std::move(out_stream));
-  auto processor = xs::Executor<xs::DataChunk, DataWriter, preprocess_result>(
-      args.num_threads, std::move(reader), std::move(inplace_processors),
-      std::move(output_creator), std::move(result));
-  processor.join();
+  {
+    auto result = std::make_unique<DataWriter>(
+        meta_file, xs::CompressionType(compression_type), args.output_file,
+        std::move(ngram_filters), std::move(ngram_stream), prefix);
+    auto processor =
+        xs::Executor<xs::DataChunk, DataWriter, preprocess_result>(
+            args.num_threads, std::move(reader), std::move(inplace_processors),
+            std::move(output_creator), std::move(result));
+    processor.join();
+    processor.getResult()->finish();
+  }
+
+  if (appending) {
+    // readers see either the old or the extended files: the new chunks were
+    //  written behind the old ones, the filters file is replaced first
+    if (std::filesystem::exists(ngram_file + ".tmp")) {
+      std::filesystem::rename(ngram_file + ".tmp", ngram_file);
+    }
+    std::filesystem::rename(meta_file, args.meta_file);
+  }
 
   return 0;
 }
\ No newline at end of file